@@ -25,8 +25,9 @@
    along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-/* This file downloads the TAI-UTC bulletins from the from IETF and parses them
- * so that correct time can be communicated in EDI timestamps.
+/* This file loads the TAI-UTC bulletins from the system, the kernel, or downloads
+ * them from the IETF and parses them so that correct time can be communicated
+ * in EDI timestamps.
  *
  * This file contains self-test code that can be executed by running
  *  g++ -g -Wall -DTAI_TEST -DHAVE_CURL -std=c++11 -lcurl -pthread \
@@ -45,13 +46,14 @@
 #include <cstdio>
 #include <cstring>
 #include <cerrno>
-#if SUPPORT_SETTING_CLOCK_TAI
+#if defined(__linux__)
 #  include <sys/timex.h>
 #endif
 #ifdef HAVE_CURL
 #  include <curl/curl.h>
 #endif
 #include <array>
+#include <fstream>
 #include <string>
 #include <iostream>
 #include <algorithm>
@@ -288,6 +290,9 @@ Bulletin Bulletin::download_from_url(const char* url)
         curl_easy_setopt(curl, CURLOPT_URL, url);
         /* Tell libcurl to follow redirection */
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        // Do not let a stuck server delay the next attempt indefinitely
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 60L);
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, fill_bulletin);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, &bulletin_data);
 
@@ -370,9 +375,57 @@ Bulletin Bulletin::load_from_file(const char* cache_filename)
     return bulletin;
 }
 
+Bulletin Bulletin::load_from_leap_seconds_file(const char* filename)
+{
+    Bulletin bulletin;
+    bulletin.source = filename;
+
+    ifstream fd(filename);
+    if (not fd) {
+        etiLog.level(debug) << "TAI-UTC leap seconds file " << filename <<
+            " cannot be read: " << strerror(errno);
+        return bulletin;
+    }
+
+    stringstream ss;
+    ss << fd.rdbuf();
+    bulletin.bulletin_or_override = ss.str();
+    return bulletin;
+}
+
+Bulletin Bulletin::read_from_kernel()
+{
+    Bulletin bulletin;
+    bulletin.source = "kernel";
+    bulletin.bulletin_or_override = string{};
+
+#if defined(__linux__)
+    struct timex timex_request = {};
+    timex_request.modes = 0; // Do not set anything
+
+    // The kernel only knows the offset if the NTP daemon set it
+    if (adjtimex(&timex_request) != -1 and
+            timex_request.tai > 0 and timex_request.tai <= 500) {
+        OverrideData od;
+        od.offset = timex_request.tai;
+        // The NTP daemon keeps it up to date, we read it again before then
+        od.expires_at = time(nullptr) + 24 * 3600;
+        od.manual = false;
+        bulletin.bulletin_or_override = od;
+    }
+#endif
+    return bulletin;
+}
+
+bool Bulletin::is_override() const
+{
+    return std::holds_alternative<Bulletin::OverrideData>(bulletin_or_override) and
+        std::get<Bulletin::OverrideData>(bulletin_or_override).manual;
+}
+
 void Bulletin::clear_expiry_if_overridden()
 {
-    if (std::holds_alternative<Bulletin::OverrideData>(bulletin_or_override)) {
+    if (is_override()) {
         auto& od = std::get<Bulletin::OverrideData>(bulletin_or_override);
         time_t now = time(nullptr);
         od.expires_at = now;
@@ -387,23 +440,38 @@ ClockTAI::ClockTAI()
     RC_ADD_PARAMETER(expiry, "Number of seconds until TAI Bulletin expires");
     RC_ADD_PARAMETER(expires_at, "UNIX timestamp when TAI Bulletin expires");
     RC_ADD_PARAMETER(url, "URLs used to fetch the bulletin, separated by pipes");
+    RC_ADD_PARAMETER(source, "Where the TAI-UTC offset comes from [read-only]");
 #else
 {
 #endif // ENABLE_REMOTECONTROL
 }
 
+ClockTAI::~ClockTAI()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_data_mutex);
+        m_running = false;
+    }
+    m_refresh_cv.notify_all();
+
+    if (m_refresh_thread.joinable()) {
+        m_refresh_thread.join();
+    }
+}
+
 void ClockTAI::init(int fixed_tai_utc_offset)
 {
     std::unique_lock<std::mutex> lock(m_data_mutex);
     m_bulletin = Bulletin::create_with_fixed_offset(fixed_tai_utc_offset);
-    m_state = m_bulletin.state();
-    m_state_last_updated = chrono::steady_clock::now();
+    publish_offset();
 
     etiLog.level(debug) << "ClockTAI with fixed offset: '" << fixed_tai_utc_offset << "'";
 }
 
-void ClockTAI::init(const std::vector<std::string>& bulletin_urls)
+void ClockTAI::init(const std::vector<std::string>& bulletin_urls,
+        const std::string& leap_seconds_file)
 {
+    std::unique_lock<std::mutex> lock(m_data_mutex);
     if (bulletin_urls.empty()) {
         etiLog.level(debug) << "Initialising default TAI Bulletin URLs";
         for (const auto url : default_tai_urls) {
@@ -414,176 +482,196 @@ void ClockTAI::init(const std::vector<std::string>& bulletin_urls)
         etiLog.level(debug) << "Initialising user-configured TAI Bulletin URLs";
         m_bulletin_urls = bulletin_urls;
     }
+    m_leap_seconds_file = leap_seconds_file;
 
     etiLog.level(debug) << "ClockTAI uses bulletin URL: '" << join_string_with_pipe(m_bulletin_urls) << "'";
 }
 
-void ClockTAI::init(const std::string& bulletin_urls_pipe_separated)
+void ClockTAI::init(const std::string& bulletin_urls_pipe_separated,
+        const std::string& leap_seconds_file)
 {
-    init(split_pipe_separated_string(bulletin_urls_pipe_separated));
+    init(split_pipe_separated_string(bulletin_urls_pipe_separated), leap_seconds_file);
 }
 
-
-BulletinState ClockTAI::get_valid_offset()
+void ClockTAI::publish_offset()
 {
-    std::unique_lock<std::mutex> lock(m_data_mutex);
-
     const auto state = m_bulletin.state();
-#if TAI_TEST
-    etiLog.level(info) << "TAI get_valid_offset STEP 1 ";
-    etiLog.level(info) << " " << m_bulletin.get_source() << " " <<
-        state.valid << " " << state.usable() << " " << state.expires_in();
-#endif
-    if (state.usable()) {
-        return state;
+    if (state.valid) {
+        const int previous = m_offset.exchange(state.offset);
+        if (previous != state.offset) {
+            if (previous == -1) {
+                etiLog.level(info) << "Initialised TAI-UTC offset to " <<
+                    state.offset << "s from " << m_bulletin.get_source();
+            }
+            else {
+                etiLog.level(info) << "Updated TAI-UTC offset to " <<
+                    state.offset << "s from " << m_bulletin.get_source();
+            }
+        }
     }
+}
 
-#if TAI_TEST
-    etiLog.level(info) << "TAI get_valid_offset STEP 2";
-#endif
-    const auto cache_bulletin = Bulletin::load_from_file(tai_cache_location);
-    const auto cache_state = cache_bulletin.state();
-    if (cache_state.usable()) {
-        m_bulletin = cache_bulletin;
-#if TAI_TEST
-        etiLog.level(info) << "TAI get_valid_offset STEP 2 take cache";
-#endif
-        return cache_state;
+void ClockTAI::refresh(bool allow_download)
+{
+    vector<string> urls;
+    string leap_seconds_file;
+    vector<Bulletin> bulletins;
+    {
+        std::unique_lock<std::mutex> lock(m_data_mutex);
+        if (m_bulletin.is_override() and m_bulletin.state().usable()) {
+            return;
+        }
+        urls = m_bulletin_urls;
+        leap_seconds_file = m_leap_seconds_file;
+        bulletins.push_back(m_bulletin);
     }
 
-#if TAI_TEST
-    etiLog.level(info) << "TAI get_valid_offset STEP 3";
-#endif
+    // Place bulletins with largest expiry first
+    const auto best_first = [](const Bulletin& a, const Bulletin& b) {
+            return a.state().expires_at > b.state().expires_at; };
 
-    vector<Bulletin> bulletins({m_bulletin, cache_bulletin});
+    if (not leap_seconds_file.empty()) {
+        bulletins.push_back(Bulletin::load_from_leap_seconds_file(leap_seconds_file.c_str()));
+    }
 
-    for (const auto& url : m_bulletin_urls) {
-        try {
-#if TAI_TEST
-            etiLog.level(info) << "Load bulletin from " << url;
-#endif
-            const auto new_bulletin = Bulletin::download_from_url(url.c_str());
-            bulletins.push_back(new_bulletin);
+    if (access(tai_cache_location, F_OK) == 0) {
+        bulletins.push_back(Bulletin::load_from_file(tai_cache_location));
+    }
+
+    std::sort(bulletins.begin(), bulletins.end(), best_first);
 
-            const auto new_state = new_bulletin.state();
-            if (new_state.usable()) {
-                m_bulletin = new_bulletin;
-                new_bulletin.store_to_cache(tai_cache_location);
+    if (not bulletins[0].state().usable()) {
+        const auto kernel_bulletin = Bulletin::read_from_kernel();
+        if (kernel_bulletin.state().usable()) {
+            bulletins.insert(bulletins.begin(), kernel_bulletin);
+        }
+    }
 
-                etiLog.level(debug) << "Loaded valid TAI Bulletin from " <<
-                    url << " giving offset=" << new_state.offset;
-                return new_state;
+    if (allow_download and
+            (not bulletins[0].state().usable() or bulletins[0].state().expires_soon())) {
+        for (const auto& url : urls) {
+            try {
+                const auto new_bulletin = Bulletin::download_from_url(url.c_str());
+                const auto new_state = new_bulletin.state();
+                if (new_state.usable()) {
+                    new_bulletin.store_to_cache(tai_cache_location);
+
+                    etiLog.level(debug) << "Loaded valid TAI Bulletin from " <<
+                        url << " giving offset=" << new_state.offset;
+                    bulletins.push_back(new_bulletin);
+                    break;
+                }
+                else {
+                    etiLog.level(debug) << "Skipping invalid TAI bulletin from "
+                        << url;
+                }
             }
-            else {
-                etiLog.level(debug) << "Skipping invalid TAI bulletin from "
-                    << url;
+            catch (const runtime_error& e) {
+                etiLog.level(warn) <<
+                    "TAI-UTC offset could not be retrieved from " <<
+                    url << " : " << e.what();
             }
         }
-        catch (const runtime_error& e) {
-            etiLog.level(warn) <<
-                "TAI-UTC offset could not be retrieved from " <<
-                url << " : " << e.what();
-        }
+        std::sort(bulletins.begin(), bulletins.end(), best_first);
     }
 
-#if TAI_TEST
-    etiLog.level(info) << "TAI get_valid_offset STEP 4";
-#endif
-
-    // Maybe we have a valid but expired bulletin available.
-    // Place bulletins with largest expiry first
-    std::sort(bulletins.begin(), bulletins.end(),
-            [](const Bulletin& a, const Bulletin& b) {
-            return a.state().expires_at > b.state().expires_at; });
-
+    // Maybe we only have a valid but expired bulletin available.
     for (const auto& bulletin : bulletins) {
-        const auto& state = bulletin.state();
+        const auto state = bulletin.state();
         if (state.valid) {
-            etiLog.level(warn) << "Taking TAI-UTC offset from expired bulletin from " <<
-                bulletin.get_source() << " : " << state.offset << "s expired " <<
-                state.expires_in() << "s ago";
-            m_bulletin = bulletin;
-            return state;
+            if (not state.usable()) {
+                etiLog.level(warn) << "Taking TAI-UTC offset from expired bulletin from " <<
+                    bulletin.get_source() << " : " << state.offset << "s expired " <<
+                    -state.expires_in() << "s ago";
+            }
+
+            std::unique_lock<std::mutex> lock(m_data_mutex);
+            // Unless the RC changed it in the meantime
+            if (not (m_bulletin.is_override() and m_bulletin.state().usable())) {
+                m_bulletin = bulletin;
+                publish_offset();
+            }
+            return;
         }
     }
-
-    throw download_failed();
 }
 
-
-int ClockTAI::get_offset()
+void ClockTAI::refresh_thread()
 {
     using namespace std::chrono;
-    const auto time_now = steady_clock::now();
 
-    std::unique_lock<std::mutex> lock(m_data_mutex);
-
-    if (not m_state.has_value()) {
-        // First time we run we must block until we know
-        // the offset
-        lock.unlock();
-        try {
-            m_state = get_valid_offset();
-        }
-        catch (const download_failed&) {
-            throw runtime_error("Unable to download TAI bulletin");
-        }
-        lock.lock();
-        m_state_last_updated = time_now;
-        etiLog.level(info) << "Initialised TAI-UTC offset to " << m_state->offset << "s.";
-    }
-
-    if (m_state_last_updated + hours(1) < time_now) {
-        // Once per hour, parse the bulletin again, and
-        // if necessary trigger a download.
-        // Leap seconds are announced several months in advance
-        etiLog.level(debug) << "Trying to refresh TAI bulletin";
-
-        if (m_offset_future.valid()) {
-            auto state = m_offset_future.wait_for(seconds(0));
-            switch (state) {
-                case future_status::ready:
-                    try {
-                        m_state = m_offset_future.get();
-                        m_state_last_updated = time_now;
-
-                        etiLog.level(info) <<
-                            "Updated TAI-UTC offset to " << m_state->offset << "s.";
-                    }
-                    catch (const download_failed&) {
-                        etiLog.level(warn) <<
-                            "TAI-UTC download failed, will retry in " <<
-                            refresh_retry_interval_hours << " hour(s)";
+    // Download right away if the local sources were not good enough
+    auto next_download = steady_clock::now();
 
+    std::unique_lock<std::mutex> lock(m_data_mutex);
+    while (m_running) {
+        const auto state = m_bulletin.state();
+        const auto now = steady_clock::now();
+        if (m_refresh_requested or
+                ((not state.usable() or state.expires_soon()) and next_download <= now)) {
+            m_refresh_requested = false;
+            lock.unlock();
+            refresh(true);
+            lock.lock();
+
+            const auto new_state = m_bulletin.state();
+            if (not new_state.usable() or new_state.expires_soon()) {
+                etiLog.level(warn) <<
+                    "TAI-UTC bulletin not up to date, will retry in " <<
+                    refresh_retry_interval_hours << " hour(s)";
+            }
 #if TAI_TEST
-                        m_state_last_updated += seconds(11);
+            next_download = now + seconds(11);
 #else
-                        m_state_last_updated += hours(refresh_retry_interval_hours);
+            next_download = now + hours(refresh_retry_interval_hours);
 #endif
-                    }
-                    break;
 
-                case future_status::deferred:
-                case future_status::timeout:
-                    // Not ready yet
-#ifdef TAI_TEST
-                    etiLog.level(debug) << "  async not ready yet";
-#endif
-                    break;
-            }
+            m_first_refresh_done = true;
+            m_refresh_cv.notify_all();
         }
         else {
-#ifdef TAI_TEST
-            etiLog.level(debug) << " Launch async";
-#endif
-            m_offset_future = async(launch::async, &ClockTAI::get_valid_offset, this);
+            // The offset changes when a leap second announced in the
+            // bulletin takes effect
+            publish_offset();
+        }
+
+        m_refresh_cv.wait_for(lock, minutes(1),
+                [&]() { return m_refresh_requested or not m_running; });
+    }
+}
+
+void ClockTAI::start()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_data_mutex);
+        if (m_refresh_thread.joinable()) {
+            return;
+        }
+    }
+
+    refresh(false);
+
+    std::unique_lock<std::mutex> lock(m_data_mutex);
+    m_running = true;
+    m_refresh_thread = std::thread(&ClockTAI::refresh_thread, this);
+
+    if (m_offset.load() == -1) {
+        etiLog.level(info) << "No local TAI-UTC offset, waiting for the bulletin download";
+        m_refresh_cv.wait(lock, [&]() { return m_first_refresh_done; });
+
+        if (m_offset.load() == -1) {
+            throw runtime_error("Unable to download TAI bulletin");
         }
     }
+}
 
-    if (m_state) {
-        return m_state->offset;
+int ClockTAI::get_offset()
+{
+    const int offset = m_offset.load(std::memory_order_relaxed);
+    if (offset == -1) {
+        throw runtime_error("TAI-UTC offset is not known");
     }
-    throw std::logic_error("ClockTAI: No valid m_state at end of get_offset()");
+    return offset;
 }
 
 std::optional<time_t> ClockTAI::expires_at() const
@@ -673,27 +761,34 @@ void ClockTAI::set_parameter(const string& parameter, const string& value)
     }
     else if (parameter == "tai_utc_offset") {
         const auto offset = std::stoi(value);
+        if (offset < 0 or offset > 500) {
+            throw ParameterError("Unreasonable TAI-UTC offset " + value);
+        }
         auto b = Bulletin::create_with_fixed_offset(offset);
 
         etiLog.level(warn) << "ClockTAI: manually overriding UTC-TAI offset to " << offset;
 
         std::unique_lock<std::mutex> lock(m_data_mutex);
         m_bulletin = b;
-        m_state = b.state();
-        m_state_last_updated = chrono::steady_clock::now();
+        publish_offset();
     }
     else if (parameter == "url") {
         {
             std::unique_lock<std::mutex> lock(m_data_mutex);
             m_bulletin_urls = split_pipe_separated_string(value);
-            m_state_last_updated = chrono::steady_clock::time_point::min();
+            m_refresh_requested = true;
 
             // Setting URL expires the bulletin, if it was manually overridden,
             // so that the selection logic doesn't prefer it
             m_bulletin.clear_expiry_if_overridden();
         }
+        m_refresh_cv.notify_all();
         etiLog.level(info) << "ClockTAI: triggering a reload from URLs...";
     }
+    else if (parameter == "source") {
+        throw ParameterError("Parameter '" + parameter +
+            "' is read-only in controllable " + get_rc_name());
+    }
     else {
         throw ParameterError("Parameter '" + parameter +
             "' is not exported by controllable " + get_rc_name());
@@ -711,15 +806,20 @@ const string ClockTAI::get_parameter(const string& parameter) const
         return to_string(m_bulletin.state().expires_at);
     }
     else if (parameter == "tai_utc_offset") {
-        std::unique_lock<std::mutex> lock(m_data_mutex);
-        if (m_state) {
-            return to_string(m_state->offset);
+        const int offset = m_offset.load();
+        if (offset != -1) {
+            return to_string(offset);
         }
         throw ParameterError("Parameter '" + parameter +
                 "' has no current value" + get_rc_name());
     }
     else if (parameter == "url") {
-        return join_string_with_pipe(m_bulletin_urls);;
+        std::unique_lock<std::mutex> lock(m_data_mutex);
+        return join_string_with_pipe(m_bulletin_urls);
+    }
+    else if (parameter == "source") {
+        std::unique_lock<std::mutex> lock(m_data_mutex);
+        return m_bulletin.get_source();
     }
     else {
         throw ParameterError("Parameter '" + parameter +
@@ -737,8 +837,7 @@ const json::map_t ClockTAI::get_all_values() const
 #if TAI_TEST
     etiLog.level(debug) << "CALC FROM m_bulletin: " << state.valid << " " <<
         state.offset << " " << state.expires_at << " -> " << state.expires_in();
-    etiLog.level(debug) << "CACHED IN m_state:    " << m_state->valid << " " <<
-        m_state->offset << " " << m_state->expires_at << " -> " << m_state->expires_in();
+    etiLog.level(debug) << "PUBLISHED OFFSET:     " << m_offset.load();
 #endif
 
     stat["tai_utc_offset"] = state.offset;
@@ -752,6 +851,7 @@ const json::map_t ClockTAI::get_all_values() const
     }
 
     stat["url"] = join_string_with_pipe(m_bulletin_urls);
+    stat["source"] = m_bulletin.get_source();
 
     return stat;
 }
@@ -34,11 +34,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <chrono>
-#include <future>
+#include <condition_variable>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <optional>
 #include <variant>
@@ -65,6 +67,16 @@ class Bulletin {
         static Bulletin create_with_fixed_offset(int offset);
         static Bulletin load_from_file(const char *cache_filename);
 
+        // Read a leap-seconds.list file that other programs maintain,
+        // without locking it
+        static Bulletin load_from_leap_seconds_file(const char *filename);
+
+        // The offset the NTP daemon has set in the kernel, see adjtimex(2).
+        // Gives an invalid bulletin if it is not set.
+        static Bulletin read_from_kernel();
+
+        bool is_override() const;
+
         void clear_expiry_if_overridden();
 
         void store_to_cache(const char* cache_filename) const;
@@ -78,13 +90,23 @@ class Bulletin {
         struct OverrideData {
             int offset = 0;
             int expires_at = 0;
+            // false if the offset was read from the kernel
+            bool manual = true;
         };
         // string: A cache of the bulletin, or empty string if not loaded
         // int: A manually overridden offset
         std::variant<std::string, OverrideData> bulletin_or_override;
 };
 
-/* Loads, parses and represents TAI-UTC offset information from the IETF bulletin */
+/* Loads, parses and represents TAI-UTC offset information from the IETF bulletin
+ *
+ * The offset is kept in an atomic, so that the multiplexer can read it every
+ * frame without locking. It is taken from, in order of preference: a manual
+ * override, the local leap-seconds.list file (e.g. from tzdata) or the cache
+ * file, whichever expires last, the offset the NTP daemon gave to the kernel,
+ * and the bulletin URLs. Only
+ * the local sources are read on startup; the bulletin gets downloaded by a
+ * background thread, which also refreshes the offset. */
 class ClockTAI
 #if ENABLE_REMOTECONTROL
 : public RemoteControllable
@@ -92,14 +114,24 @@ class ClockTAI
 {
     public:
         ClockTAI();
+        ClockTAI(const ClockTAI& other) = delete;
+        ClockTAI& operator=(const ClockTAI& other) = delete;
+        ~ClockTAI();
 
         void init(int fixed_tai_utc_offset);
-        void init(const std::string& bulletin_urls_pipe_separated);
-        void init(const std::vector<std::string>& bulletin_urls);
-
-        // Fetch the bulletin from the IETF website and return the current
-        // TAI-UTC offset.
+        void init(const std::string& bulletin_urls_pipe_separated,
+                const std::string& leap_seconds_file);
+        void init(const std::vector<std::string>& bulletin_urls,
+                const std::string& leap_seconds_file);
+
+        // Load the offset from the local sources and start the background
+        // refresh. Only waits for the download of the bulletin if no local
+        // source knows the offset, even an expired one.
         // Throws runtime_error on failure.
+        void start();
+
+        // Return the current TAI-UTC offset, without blocking.
+        // Throws runtime_error if it is not known.
         int get_offset();
 
         std::optional<time_t> expires_at() const;
@@ -112,28 +144,34 @@ class ClockTAI
 #endif
 
     private:
-        class download_failed {};
+        // Read the local sources and, if allowed, download the bulletin.
+        // Replaces m_bulletin by the best one found.
+        void refresh(bool allow_download);
+
+        // Set m_offset from m_bulletin. Called with m_data_mutex held.
+        void publish_offset();
 
-        // Either retrieve the bulletin from the cache or if necessarly
-        // download it, and calculate the TAI-UTC offset.
-        // Returns the offset or throws download_failed or a range_error
-        // if the offset is out of bounds.
-        BulletinState get_valid_offset(void);
+        void refresh_thread();
 
-        // Download of new bulletin is done asynchronously
-        std::future<BulletinState> m_offset_future;
+        // The current offset, or -1 if it is not known yet
+        std::atomic<int> m_offset = -1;
 
-        // Protect all data members, as RC functions are in another thread
+        // Protect all data members below, as RC functions and the refresh
+        // are in other threads. Never held during a download.
         mutable std::mutex m_data_mutex;
+        std::condition_variable m_refresh_cv;
 
         std::vector<std::string> m_bulletin_urls;
+        std::string m_leap_seconds_file;
 
         Bulletin m_bulletin;
 
-        // The currently used TAI-UTC offset, extracted the bulletin and cached
-        // here to avoid having to parse the bulletin all the time
-        std::optional<BulletinState> m_state;
-        std::chrono::steady_clock::time_point m_state_last_updated;
+        // Set by the RC to make the thread refresh immediately
+        bool m_refresh_requested = false;
+        // Set once the thread has tried all sources, for start()
+        bool m_first_refresh_done = false;
+        bool m_running = false;
+        std::thread m_refresh_thread;
 
 #if ENABLE_REMOTECONTROL
     public:
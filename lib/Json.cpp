@@ -28,6 +28,7 @@
 #include <iomanip>
 #include <string>
 #include <stdexcept>
+#include <type_traits>
 
 #include "Json.h"
 
@@ -125,4 +126,84 @@ namespace json {
 
         return ss.str();
     }
+
+    static bool equal(const map_t& a, const map_t& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+
+        for (const auto& element : a) {
+            const auto it = b.find(element.first);
+            if (it == b.end() or not equal(element.second, it->second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool equal(const value_t& a, const value_t& b)
+    {
+        if (a.v.index() != b.v.index()) {
+            return false;
+        }
+
+        return std::visit([&](const auto& value_a) -> bool {
+                using T = std::decay_t<decltype(value_a)>;
+                const auto& value_b = std::get<T>(b.v);
+
+                if constexpr (std::is_same_v<T, std::shared_ptr<json::map_t> >) {
+                    return equal(*value_a, *value_b);
+                }
+                else if constexpr (std::is_same_v<T, std::vector<json::value_t> >) {
+                    if (value_a.size() != value_b.size()) {
+                        return false;
+                    }
+                    for (size_t i = 0; i < value_a.size(); i++) {
+                        if (not equal(value_a[i], value_b[i])) {
+                            return false;
+                        }
+                    }
+                    return true;
+                }
+                else if constexpr (std::is_same_v<T, std::nullopt_t>) {
+                    return true;
+                }
+                else {
+                    return value_a == value_b;
+                }
+            }, a.v);
+    }
+
+    map_t diff(const map_t& previous, const map_t& current)
+    {
+        map_t changes;
+
+        for (const auto& element : current) {
+            const auto it = previous.find(element.first);
+            if (it == previous.end()) {
+                changes[element.first] = element.second;
+            }
+            else if (std::holds_alternative<std::shared_ptr<json::map_t> >(element.second.v) and
+                    std::holds_alternative<std::shared_ptr<json::map_t> >(it->second.v)) {
+                auto object_changes = diff(
+                        *std::get<std::shared_ptr<json::map_t> >(it->second.v),
+                        *std::get<std::shared_ptr<json::map_t> >(element.second.v));
+                if (not object_changes.empty()) {
+                    changes[element.first] = std::move(object_changes);
+                }
+            }
+            else if (not equal(element.second, it->second)) {
+                changes[element.first] = element.second;
+            }
+        }
+
+        for (const auto& element : previous) {
+            if (current.count(element.first) == 0) {
+                changes[element.first] = std::nullopt;
+            }
+        }
+
+        return changes;
+    }
 }
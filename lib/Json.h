@@ -111,4 +111,12 @@ namespace json {
 
     std::string map_to_json(const map_t& values);
     std::string value_to_json(const value_t& value);
+
+    // Compare two values, recursing into objects and arrays
+    bool equal(const value_t& a, const value_t& b);
+
+    /* Return the entries of current that previous does not have or that
+     * changed, recursing into objects. The entries of previous that are
+     * not in current are null. */
+    map_t diff(const map_t& previous, const map_t& current);
 }
@@ -29,6 +29,7 @@
 #include <list>
 #include <cstdarg>
 #include <cinttypes>
+#include <algorithm>
 #include <chrono>
 
 #include "Log.h"
@@ -36,13 +37,22 @@
 using namespace std;
 
 
-Logger::Logger()
+Logger::Logger() :
+    m_slots(make_unique<slot_t[]>(NUM_SLOTS)),
+    m_rate_limit_sites(make_unique<rate_limit_site_t[]>(NUM_RATE_LIMIT_SITES))
 {
+    for (size_t i = 0; i < NUM_SLOTS; i++) {
+        m_slots[i].seq.store(i, memory_order_relaxed);
+    }
+
     m_io_thread = std::thread(&Logger::io_process, this);
 }
 
 Logger::~Logger() {
-    m_message_queue.trigger_wakeup();
+    // The IO thread writes all messages that are still in the ring
+    m_running.store(false);
+    m_published.fetch_add(1, memory_order_release);
+    m_published.notify_one();
     m_io_thread.join();
 
     std::lock_guard<std::mutex> guard(m_backend_mutex);
@@ -55,83 +65,245 @@ void Logger::register_backend(std::shared_ptr<LogBackend> backend)
     backends.push_back(backend);
 }
 
+void Logger::set_rate_limit(size_t max_messages, std::chrono::milliseconds interval)
+{
+    m_rate_limit_max_messages.store(max_messages);
+    m_rate_limit_interval_ms.store(interval.count());
+}
+
+Logger::stats_t Logger::get_stats() const
+{
+    stats_t stats;
+    stats.num_dropped = m_num_dropped.load(memory_order_relaxed);
+    stats.num_suppressed = m_num_suppressed.load(memory_order_relaxed);
+    return stats;
+}
+
+bool Logger::rate_limit(log_level_t level, uint64_t site, uint32_t& num_suppressed)
+{
+    num_suppressed = 0;
+
+    const size_t max_messages = m_rate_limit_max_messages.load(memory_order_relaxed);
+    if (max_messages == 0 or level == trace or site == 0) {
+        return true;
+    }
+
+    // Find the slot of the call site, or claim a free one
+    rate_limit_site_t *entry = nullptr;
+    constexpr size_t MAX_PROBES = 16;
+    const uint64_t hash = site * 0x9E3779B97F4A7C15ull;
+    for (size_t i = 0; i < MAX_PROBES; i++) {
+        auto& candidate = m_rate_limit_sites[((hash >> 32) + i) % NUM_RATE_LIMIT_SITES];
+        uint64_t expected = 0;
+        if (candidate.site.compare_exchange_strong(expected, site) or expected == site) {
+            entry = &candidate;
+            break;
+        }
+    }
+
+    if (entry == nullptr) {
+        return true;
+    }
+
+    using namespace std::chrono;
+    const int64_t now_ms = duration_cast<milliseconds>(
+            steady_clock::now().time_since_epoch()).count();
+    int64_t window_start_ms = entry->window_start_ms.load(memory_order_relaxed);
+    const int64_t interval_ms = m_rate_limit_interval_ms.load(memory_order_relaxed);
+
+    if ((window_start_ms == 0 or now_ms - window_start_ms >= interval_ms) and
+            entry->window_start_ms.compare_exchange_strong(window_start_ms, now_ms)) {
+        entry->count.store(1, memory_order_relaxed);
+        num_suppressed = entry->num_suppressed.exchange(0, memory_order_relaxed);
+        return true;
+    }
+
+    if (entry->count.fetch_add(1, memory_order_relaxed) < max_messages) {
+        return true;
+    }
 
-void Logger::log(log_level_t level, const char* fmt, ...)
+    entry->num_suppressed.fetch_add(1, memory_order_relaxed);
+    m_num_suppressed.fetch_add(1, memory_order_relaxed);
+    return false;
+}
+
+void Logger::push(log_level_t level, const char* text, size_t len,
+        std::string&& long_text, uint32_t num_suppressed)
 {
     if (level == discard) {
         return;
     }
 
-    int size = 100;
-    std::string str;
-    va_list ap;
-    while (1) {
-        str.resize(size);
-        va_start(ap, fmt);
-        int n = vsnprintf((char *)str.c_str(), size, fmt, ap);
-        va_end(ap);
-        if (n > -1 && n < size) {
-            str.resize(n);
-            break;
+    uint64_t pos = m_enqueue_pos.load(memory_order_relaxed);
+    slot_t *slot = nullptr;
+    while (true) {
+        slot = &m_slots[pos % NUM_SLOTS];
+        const uint64_t seq = slot->seq.load(memory_order_acquire);
+        const int64_t diff = (int64_t)seq - (int64_t)pos;
+        if (diff == 0) {
+            if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
         }
-        if (n > -1)
-            size = n + 1;
-        else
-            size *= 2;
+        else if (diff < 0) {
+            // The IO thread has not yet written the message that was in this slot
+            m_num_dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        else {
+            pos = m_enqueue_pos.load(memory_order_relaxed);
+        }
+    }
+
+    slot->level = level;
+    slot->num_suppressed = num_suppressed;
+    slot->time = chrono::system_clock::now();
+    if (long_text.empty()) {
+        slot->len = std::min<size_t>(len, LOG_TEXT_SIZE);
+        memcpy(slot->text, text, slot->len);
+    }
+    else {
+        slot->len = 0;
+        slot->long_text = std::move(long_text);
     }
+    slot->seq.store(pos + 1, memory_order_release);
 
-    logstr(level, move(str));
+    m_published.fetch_add(1, memory_order_release);
+    m_published.notify_one();
 }
 
-void Logger::logstr(log_level_t level, std::string&& message)
+// Call sites are identified by file and line
+static uint64_t call_site(const std::source_location& location)
+{
+    return ((uint64_t)(uintptr_t)location.file_name() << 16) ^ location.line();
+}
+
+void Logger::log_at(log_level_t level, const std::source_location& location,
+        const char* fmt, ...)
 {
     if (level == discard) {
         return;
     }
 
-    log_message_t m(level, move(message));
-    m_message_queue.push(move(m));
+    uint32_t num_suppressed = 0;
+    if (not rate_limit(level, call_site(location), num_suppressed)) {
+        return;
+    }
+
+    char buf[LOG_TEXT_SIZE];
+    va_list ap;
+    va_start(ap, fmt);
+    const int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    if (n < 0) {
+        return;
+    }
+    else if ((size_t)n < sizeof(buf)) {
+        push(level, buf, n, {}, num_suppressed);
+    }
+    else {
+        std::string str(n + 1, '\0');
+        va_start(ap, fmt);
+        vsnprintf(str.data(), str.size(), fmt, ap);
+        va_end(ap);
+        str.resize(n);
+        push(level, nullptr, 0, move(str), num_suppressed);
+    }
+}
+
+void Logger::logstr(log_level_t level, std::string&& message)
+{
+    if (message.size() <= LOG_TEXT_SIZE) {
+        push(level, message.data(), message.size(), {}, 0);
+    }
+    else {
+        push(level, nullptr, 0, move(message), 0);
+    }
+}
+
+void Logger::write_to_backends(log_level_t level,
+        std::chrono::system_clock::time_point time,
+        const std::string& message)
+{
+    std::lock_guard<std::mutex> guard(m_backend_mutex);
+    for (auto &backend : backends) {
+        backend->log(level, message);
+    }
+
+    if (level != log_level_t::trace) {
+        time_t t = std::chrono::system_clock::to_time_t(time);
+        cerr << put_time(std::gmtime(&t), "%Y-%m-%dZ%H:%M:%S") << " " << levels_as_str[level] << " " << message << endl;
+    }
 }
 
 void Logger::io_process()
 {
+    uint64_t num_dropped_reported = 0;
+
     while (1) {
-        log_message_t m;
-        try {
-            m_message_queue.wait_and_pop(m);
-        }
-        catch (const ThreadsafeQueueWakeup&) {
-            break;
+        // Read the counter before looking at the slot, so that a message
+        // published in between wakes us up
+        const uint32_t published = m_published.load(memory_order_acquire);
+
+        auto& slot = m_slots[m_dequeue_pos % NUM_SLOTS];
+        if (slot.seq.load(memory_order_acquire) != m_dequeue_pos + 1) {
+            const uint64_t num_dropped = m_num_dropped.load(memory_order_relaxed);
+            if (num_dropped != num_dropped_reported) {
+                stringstream ss;
+                ss << "Logging too slow, dropped " <<
+                    num_dropped - num_dropped_reported << " messages";
+                write_to_backends(warn, chrono::system_clock::now(), ss.str());
+                num_dropped_reported = num_dropped;
+            }
+
+            if (not m_running.load()) {
+                break;
+            }
+
+            m_published.wait(published, memory_order_acquire);
+            continue;
         }
 
-        auto message = m.message;
+        std::string message = slot.long_text.empty() ?
+            std::string(slot.text, slot.len) : std::move(slot.long_text);
+        slot.long_text.clear();
+        const auto level = slot.level;
+        const auto time = slot.time;
+        const auto num_suppressed = slot.num_suppressed;
+
+        // Give the slot back to the producers
+        slot.seq.store(m_dequeue_pos + NUM_SLOTS, memory_order_release);
+        m_dequeue_pos++;
 
         /* Remove a potential trailing newline.
          * It doesn't look good in syslog
          */
-        if (message[message.length()-1] == '\n') {
+        if (not message.empty() and message[message.length()-1] == '\n') {
             message.resize(message.length()-1);
         }
 
-        {
-            std::lock_guard<std::mutex> guard(m_backend_mutex);
-            for (auto &backend : backends) {
-                backend->log(m.level, message);
-            }
-
-            if (m.level != log_level_t::trace) {
-                using namespace std::chrono;
-                time_t t = system_clock::to_time_t(system_clock::now());
-                cerr << put_time(std::gmtime(&t), "%Y-%m-%dZ%H:%M:%S") << " " << levels_as_str[m.level] << " " << message << endl;
-            }
+        if (num_suppressed > 0) {
+            message += " (" + to_string(num_suppressed) +
+                " similar messages suppressed)";
         }
+
+        write_to_backends(level, time, message);
     }
 }
 
 
-LogLine Logger::level(log_level_t level)
+LogLine Logger::level(log_level_t level, const std::source_location location)
 {
-    return LogLine(this, level);
+    if (level == discard) {
+        return LogLine(this, discard);
+    }
+
+    uint32_t num_suppressed = 0;
+    if (not rate_limit(level, call_site(location), num_suppressed)) {
+        return LogLine(this, discard);
+    }
+    return LogLine(this, level, num_suppressed);
 }
 
 LogToFile::LogToFile(const std::string& filename) : name("FILE")
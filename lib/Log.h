@@ -32,8 +32,12 @@
 #endif
 
 #include <syslog.h>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <cstdarg>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -43,7 +47,10 @@
 #include <map>
 #include <mutex>
 #include <memory>
+#include <source_location>
+#include <string_view>
 #include <thread>
+#include <type_traits>
 #include "ThreadsafeQueue.h"
 
 #define SYSLOG_IDENT PACKAGE_NAME
@@ -118,18 +125,8 @@ class LogTracer : public LogBackend {
 
 class LogLine;
 
-struct log_message_t {
-    log_message_t(log_level_t _level, std::string&& _message) :
-        level(_level),
-        message(move(_message)) {}
-
-    log_message_t() :
-        level(debug),
-        message("") {}
-
-    log_level_t level;
-    std::string message;
-};
+// Messages up to this length are stored without allocation
+#define LOG_TEXT_SIZE 256
 
 class Logger {
     public:
@@ -140,9 +137,24 @@ class Logger {
 
         void register_backend(std::shared_ptr<LogBackend> backend);
 
+        /* The printf format string given to log(), and the place of the
+         * call, which identifies the call site for the rate limit */
+        struct format_t {
+            format_t(const char* fmt,
+                    const std::source_location location = std::source_location::current()) :
+                fmt(fmt), location(location) {}
+
+            const char* fmt;
+            std::source_location location;
+        };
+
         /* Log the message to all backends */
-        void log(log_level_t level, const char* fmt, ...);
+        template<typename... Args>
+        void log(log_level_t level, format_t format, Args... args) {
+            log_at(level, format.location, format.fmt, args...);
+        }
 
+        // Log the message, without rate limit
         void logstr(log_level_t level, std::string&& message);
 
         /* All logging IO is done in another thread */
@@ -150,12 +162,82 @@ class Logger {
 
         /* Return a LogLine for the given level
          * so that you can write etiLog.level(info) << "stuff = " << 21 */
-        LogLine level(log_level_t level);
+        LogLine level(log_level_t level,
+                const std::source_location location = std::source_location::current());
+
+        /* Every call site may log max_messages per interval, the following
+         * messages are discarded before they are formatted, and their
+         * number is added to the next message of the call site that gets
+         * logged. 0 disables the limit. */
+        void set_rate_limit(size_t max_messages, std::chrono::milliseconds interval);
+
+        struct stats_t {
+            // Messages lost because the IO thread could not keep up
+            uint64_t num_dropped = 0;
+            // Messages discarded by the rate limit
+            uint64_t num_suppressed = 0;
+        };
+        stats_t get_stats() const;
+
+        /* Called by LogLine. The text is copied, unless it is longer than
+         * LOG_TEXT_SIZE and given in long_text. */
+        void push(log_level_t level, const char* text, size_t len,
+                std::string&& long_text, uint32_t num_suppressed);
 
     private:
-        std::list<std::shared_ptr<LogBackend> > backends;
+        /* Returns false if the message must be discarded, otherwise sets
+         * num_suppressed to the number of messages of the call site that
+         * were discarded since the last one that was logged. */
+        bool rate_limit(log_level_t level, uint64_t site, uint32_t& num_suppressed);
+
+        void log_at(log_level_t level, const std::source_location& location,
+                const char* fmt, ...);
+
+        void write_to_backends(log_level_t level,
+                std::chrono::system_clock::time_point time,
+                const std::string& message);
+
+        /* Messages are passed to the IO thread through a ring of
+         * preallocated slots. Any thread claims the next slot with a
+         * compare-and-swap of m_enqueue_pos, and publishes it by setting its
+         * sequence number. When the ring is full, the message is dropped
+         * instead of waiting. */
+        struct slot_t {
+            std::atomic<uint64_t> seq;
+            log_level_t level;
+            uint32_t num_suppressed;
+            std::chrono::system_clock::time_point time;
+            size_t len;
+            char text[LOG_TEXT_SIZE];
+            std::string long_text;
+        };
+
+        static constexpr size_t NUM_SLOTS = 4096;
+        std::unique_ptr<slot_t[]> m_slots;
+        std::atomic<uint64_t> m_enqueue_pos = 0;
+        uint64_t m_dequeue_pos = 0;
+
+        // Incremented for every published message, the IO thread waits on it
+        std::atomic<uint32_t> m_published = 0;
+        std::atomic<bool> m_running = true;
+
+        struct rate_limit_site_t {
+            std::atomic<uint64_t> site = 0;
+            std::atomic<int64_t> window_start_ms = 0;
+            std::atomic<uint32_t> count = 0;
+            std::atomic<uint32_t> num_suppressed = 0;
+        };
+
+        // Open addressing hash table, sites that don't fit are not limited
+        static constexpr size_t NUM_RATE_LIMIT_SITES = 1024;
+        std::unique_ptr<rate_limit_site_t[]> m_rate_limit_sites;
+        std::atomic<size_t> m_rate_limit_max_messages = 100;
+        std::atomic<int64_t> m_rate_limit_interval_ms = 60000;
+
+        std::atomic<uint64_t> m_num_dropped = 0;
+        std::atomic<uint64_t> m_num_suppressed = 0;
 
-        ThreadsafeQueue<log_message_t> m_message_queue;
+        std::list<std::shared_ptr<LogBackend> > backends;
         std::thread m_io_thread;
         std::mutex m_backend_mutex;
 };
@@ -166,35 +248,120 @@ extern Logger etiLog;
 
 // Accumulate a line of logs, using same syntax as stringstream
 // The line is logged when the LogLine gets destroyed
+//
+// Strings and numbers are formatted directly into a buffer on the stack.
+// Other types, and everything that follows them, go through an ostringstream,
+// so that manipulators keep working.
 class LogLine {
     public:
         LogLine(const LogLine& logline);
         const LogLine& operator=(const LogLine& other) = delete;
-        LogLine(Logger* logger, log_level_t level) :
-            logger_(logger)
+        LogLine(Logger* logger, log_level_t level, uint32_t num_suppressed = 0) :
+            logger_(logger),
+            num_suppressed_(num_suppressed)
         {
             level_ = level;
         }
 
-        // Push the new element into the stringstream
+        // Push the new element into the line
         template <typename T>
-        LogLine& operator<<(T s) {
-            if (level_ != discard) {
-                os << s;
+        LogLine& operator<<(const T& s) {
+            if (level_ == discard) {
+                return *this;
+            }
+
+            using value_t = std::decay_t<T>;
+            if (os_) {
+                *os_ << s;
+            }
+            else if constexpr (std::is_same_v<value_t, char*> or
+                    std::is_same_v<value_t, const char*>) {
+                const char *str = s;
+                if (str) {
+                    append(str, strlen(str));
+                }
+            }
+            else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+                const std::string_view str = s;
+                append(str.data(), str.size());
+            }
+            else if constexpr (std::is_same_v<value_t, char>) {
+                append(&s, 1);
+            }
+            else if constexpr (std::is_same_v<value_t, bool>) {
+                append(s ? "1" : "0", 1);
+            }
+            else if constexpr (std::is_integral_v<value_t> and
+                    not std::is_same_v<value_t, signed char> and
+                    not std::is_same_v<value_t, unsigned char> and
+                    not std::is_same_v<value_t, wchar_t> and
+                    not std::is_same_v<value_t, char8_t> and
+                    not std::is_same_v<value_t, char16_t> and
+                    not std::is_same_v<value_t, char32_t>) {
+                char buf[24];
+                const auto r = std::to_chars(buf, buf + sizeof(buf), s);
+                append(buf, r.ptr - buf);
+            }
+            else if constexpr (std::is_floating_point_v<value_t>) {
+                // Same as the default format of streams
+                char buf[32];
+                const auto r = std::to_chars(buf, buf + sizeof(buf), s,
+                        std::chars_format::general, 6);
+                append(buf, r.ptr - buf);
+            }
+            else {
+                os_ = std::make_unique<std::ostringstream>();
+                os_->write(text(), len_);
+                *os_ << s;
             }
             return *this;
         }
 
         ~LogLine()
         {
-            if (level_ != discard) {
-                logger_->logstr(level_, os.str());
+            if (level_ == discard) {
+                return;
+            }
+
+            if (os_) {
+                auto str = os_->str();
+                if (str.size() <= LOG_TEXT_SIZE) {
+                    logger_->push(level_, str.data(), str.size(), {}, num_suppressed_);
+                }
+                else {
+                    logger_->push(level_, nullptr, 0, std::move(str), num_suppressed_);
+                }
+            }
+            else if (long_text_.empty()) {
+                logger_->push(level_, buf_, len_, {}, num_suppressed_);
+            }
+            else {
+                logger_->push(level_, nullptr, 0, std::move(long_text_), num_suppressed_);
             }
         }
 
     private:
-        std::ostringstream os;
+        const char* text() const { return long_text_.empty() ? buf_ : long_text_.data(); }
+
+        void append(const char* str, size_t len) {
+            if (long_text_.empty() and len_ + len <= LOG_TEXT_SIZE) {
+                memcpy(buf_ + len_, str, len);
+            }
+            else {
+                if (long_text_.empty()) {
+                    long_text_.assign(buf_, len_);
+                }
+                long_text_.append(str, len);
+            }
+            len_ += len;
+        }
+
         log_level_t level_;
         Logger* logger_;
+        uint32_t num_suppressed_;
+        char buf_[LOG_TEXT_SIZE];
+        size_t len_ = 0;
+        std::string long_text_;
+        std::unique_ptr<std::ostringstream> os_;
 };
 
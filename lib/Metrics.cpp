@@ -0,0 +1,234 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+ */
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+
+namespace metrics {
+
+const char* content_type =
+    "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+Histogram::Histogram(const std::vector<double>& bounds) :
+    m_bounds(bounds),
+    m_counts(new std::atomic<uint64_t>[bounds.size() + 1])
+{
+    if (not std::is_sorted(m_bounds.begin(), m_bounds.end())) {
+        throw std::invalid_argument("Histogram bounds must be increasing");
+    }
+
+    for (size_t i = 0; i < m_bounds.size() + 1; i++) {
+        m_counts[i] = 0;
+    }
+}
+
+void Histogram::observe(double value)
+{
+    // A value equal to a bound belongs to the bucket of that bound
+    const size_t bucket = std::lower_bound(m_bounds.begin(), m_bounds.end(), value) -
+        m_bounds.begin();
+    m_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::snapshot_t Histogram::snapshot() const
+{
+    snapshot_t s;
+    s.bounds = m_bounds;
+    s.counts.resize(m_bounds.size() + 1);
+
+    // The count is the sum of the buckets, so that it is consistent with
+    // them even if observe() is called concurrently.
+    for (size_t i = 0; i < s.counts.size(); i++) {
+        s.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+        s.count += s.counts[i];
+    }
+    s.sum = m_sum.load(std::memory_order_relaxed);
+    return s;
+}
+
+std::vector<double> duration_buckets()
+{
+    return {10e-6, 25e-6, 50e-6, 100e-6, 250e-6, 500e-6,
+        1e-3, 2.5e-3, 5e-3, 10e-3, 24e-3, 50e-3, 100e-3};
+}
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+Registry::family_t& Registry::get_family(
+        const std::string& name, const std::string& help, type_t type)
+{
+    auto it = m_families.find(name);
+    if (it == m_families.end()) {
+        family_t f;
+        f.type = type;
+        f.help = help;
+        it = m_families.emplace(name, std::move(f)).first;
+    }
+    else if (it->second.type != type) {
+        throw std::logic_error("Metric " + name + " registered with two types");
+    }
+    return it->second;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& help,
+        const labels_t& labels)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& metric = get_family(name, help, type_t::Counter).counters[labels];
+    if (not metric) {
+        metric = std::make_unique<Counter>();
+    }
+    return *metric;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& help,
+        const labels_t& labels)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& metric = get_family(name, help, type_t::Gauge).gauges[labels];
+    if (not metric) {
+        metric = std::make_unique<Gauge>();
+    }
+    return *metric;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& help,
+        const std::vector<double>& bounds, const labels_t& labels)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto& metric = get_family(name, help, type_t::Histogram).histograms[labels];
+    if (not metric) {
+        metric = std::make_unique<Histogram>(bounds);
+    }
+    return *metric;
+}
+
+static std::string format_value(double value)
+{
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    else if (std::isinf(value)) {
+        return value > 0 ? "+Inf" : "-Inf";
+    }
+
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.10g", value);
+    return buf;
+}
+
+static std::string escape_label_value(const std::string& value)
+{
+    std::string escaped;
+    for (const char c : value) {
+        switch (c) {
+            case '\\': escaped += "\\\\"; break;
+            case '"': escaped += "\\\""; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+// Render the labels, with an optional additional le label for histograms
+static std::string format_labels(const labels_t& labels, const std::string& le = "")
+{
+    if (labels.empty() and le.empty()) {
+        return "";
+    }
+
+    std::string s = "{";
+    bool first = true;
+    for (const auto& label : labels) {
+        if (not first) {
+            s += ",";
+        }
+        s += label.first + "=\"" + escape_label_value(label.second) + "\"";
+        first = false;
+    }
+    if (not le.empty()) {
+        if (not first) {
+            s += ",";
+        }
+        s += "le=\"" + le + "\"";
+    }
+    s += "}";
+    return s;
+}
+
+std::string Registry::render() const
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    std::string out;
+    for (const auto& [name, family] : m_families) {
+        switch (family.type) {
+            case type_t::Counter:
+                out += "# TYPE " + name + " counter\n";
+                out += "# HELP " + name + " " + family.help + "\n";
+                for (const auto& [labels, counter] : family.counters) {
+                    out += name + "_total" + format_labels(labels) + " " +
+                        std::to_string(counter->value()) + "\n";
+                }
+                break;
+            case type_t::Gauge:
+                out += "# TYPE " + name + " gauge\n";
+                out += "# HELP " + name + " " + family.help + "\n";
+                for (const auto& [labels, gauge] : family.gauges) {
+                    out += name + format_labels(labels) + " " +
+                        format_value(gauge->value()) + "\n";
+                }
+                break;
+            case type_t::Histogram:
+                out += "# TYPE " + name + " histogram\n";
+                out += "# HELP " + name + " " + family.help + "\n";
+                for (const auto& [labels, histogram] : family.histograms) {
+                    const auto s = histogram->snapshot();
+                    uint64_t cumulative = 0;
+                    for (size_t i = 0; i < s.counts.size(); i++) {
+                        cumulative += s.counts[i];
+                        const std::string le = i < s.bounds.size() ?
+                            format_value(s.bounds[i]) : "+Inf";
+                        out += name + "_bucket" + format_labels(labels, le) + " " +
+                            std::to_string(cumulative) + "\n";
+                    }
+                    out += name + "_count" + format_labels(labels) + " " +
+                        std::to_string(s.count) + "\n";
+                    out += name + "_sum" + format_labels(labels) + " " +
+                        format_value(s.sum) + "\n";
+                }
+                break;
+        }
+    }
+    out += "# EOF\n";
+    return out;
+}
+
+} // namespace metrics
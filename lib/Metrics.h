@@ -0,0 +1,128 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Counters, gauges and histograms exported in the OpenMetrics text format,
+   which Prometheus can scrape.
+ */
+/*
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* Metrics are created once, when the element they describe is set up, and
+ * are then updated with relaxed atomic operations only, so that they can be
+ * updated from the multiplexer thread for every frame. The registry lock is
+ * only taken to create metrics and to render them.
+ *
+ * Metrics are never destroyed: asking the registry twice for the same name
+ * and labels returns the same metric, and references to it stay valid until
+ * the end of the program.
+ */
+namespace metrics {
+
+using labels_t = std::vector<std::pair<std::string, std::string>>;
+
+class Counter {
+    public:
+        void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value = 0;
+};
+
+class Gauge {
+    public:
+        void set(double value) { m_value.store(value, std::memory_order_relaxed); }
+        double value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<double> m_value = 0;
+};
+
+class Histogram {
+    public:
+        // The bounds are the upper bounds of the buckets, in increasing order.
+        // Values above the last bound go to the +Inf bucket.
+        Histogram(const std::vector<double>& bounds);
+
+        void observe(double value);
+
+        struct snapshot_t {
+            std::vector<double> bounds;
+            // Per bucket, not cumulative. One more than bounds, for +Inf
+            std::vector<uint64_t> counts;
+            uint64_t count = 0;
+            double sum = 0;
+        };
+        snapshot_t snapshot() const;
+
+    private:
+        const std::vector<double> m_bounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+        std::atomic<double> m_sum = 0;
+};
+
+// Bounds suitable for durations in seconds, from 10us to 100ms
+std::vector<double> duration_buckets();
+
+class Registry {
+    public:
+        Counter& counter(const std::string& name, const std::string& help,
+                const labels_t& labels = {});
+        Gauge& gauge(const std::string& name, const std::string& help,
+                const labels_t& labels = {});
+        Histogram& histogram(const std::string& name, const std::string& help,
+                const std::vector<double>& bounds, const labels_t& labels = {});
+
+        // Render all metrics in the OpenMetrics text format
+        std::string render() const;
+
+    private:
+        enum class type_t { Counter, Gauge, Histogram };
+
+        struct family_t {
+            type_t type;
+            std::string help;
+            std::map<labels_t, std::unique_ptr<Counter>> counters;
+            std::map<labels_t, std::unique_ptr<Gauge>> gauges;
+            std::map<labels_t, std::unique_ptr<Histogram>> histograms;
+        };
+
+        family_t& get_family(const std::string& name, const std::string& help, type_t type);
+
+        mutable std::mutex m_mutex;
+        std::map<std::string, family_t> m_families;
+};
+
+// Construct the registry on first use, and return a reference to it
+Registry& registry();
+
+// Content-Type of the output of Registry::render()
+extern const char* content_type;
+
+} // namespace metrics
@@ -79,10 +79,27 @@ void RemoteControllers::add_controller(std::shared_ptr<BaseRemoteController> rc)
 
 void RemoteControllers::enrol(RemoteControllable *rc) {
     controllables.push_back(rc);
+    m_controllables_by_name.emplace(rc->get_rc_name(), rc);
+    m_generation++;
 }
 
 void RemoteControllers::remove_controllable(RemoteControllable *rc) {
     controllables.remove(rc);
+
+    const auto name = rc->get_rc_name();
+    auto it = m_controllables_by_name.find(name);
+    if (it != m_controllables_by_name.end() and it->second == rc) {
+        m_controllables_by_name.erase(it);
+
+        // Another controllable with the same name takes its place
+        for (auto c : controllables) {
+            if (c->get_rc_name() == name) {
+                m_controllables_by_name.emplace(name, c);
+                break;
+            }
+        }
+    }
+    m_generation++;
 }
 
 std::list< std::vector<std::string> > RemoteControllers::get_param_list_values(const std::string& name) {
@@ -107,12 +124,23 @@ std::list< std::vector<std::string> > RemoteControllers::get_param_list_values(c
 
 
 std::string RemoteControllers::get_showjson() {
-    json::map_t root;
-    for (auto &controllable : rcs.controllables) {
-        root[controllable->get_rc_name()] = controllable->get_all_values();
+    std::lock_guard<std::mutex> lock(m_showjson_mutex);
+
+    const uint64_t generation = m_generation.load();
+    const auto now = chrono::steady_clock::now();
+    if (m_showjson.empty() or generation != m_showjson_generation or
+            now - m_showjson_time >= SHOWJSON_MAX_AGE) {
+        json::map_t root;
+        for (auto &controllable : controllables) {
+            root[controllable->get_rc_name()] = controllable->get_all_values();
+        }
+
+        m_showjson = json::map_to_json(root);
+        m_showjson_generation = generation;
+        m_showjson_time = now;
     }
 
-    return json::map_to_json(root);
+    return m_showjson;
 }
 
 std::string RemoteControllers::get_param(const std::string& name, const std::string& param) {
@@ -120,6 +148,17 @@ std::string RemoteControllers::get_param(const std::string& name, const std::str
     return controllable->get_parameter(param);
 }
 
+std::vector<std::string> RemoteControllers::get_params(
+        const std::vector<std::pair<std::string, std::string> >& params)
+{
+    std::vector<std::string> values;
+    values.reserve(params.size());
+    for (const auto& param : params) {
+        values.push_back(get_param(param.first, param.second));
+    }
+    return values;
+}
+
 void RemoteControllers::check_faults() {
     for (auto &controller : m_controllers) {
         if (controller->fault_detected()) {
@@ -132,14 +171,13 @@ void RemoteControllers::check_faults() {
 
 RemoteControllable* RemoteControllers::get_controllable_(const std::string& name)
 {
-    auto rc = std::find_if(controllables.begin(), controllables.end(),
-            [&](RemoteControllable* r) { return r->get_rc_name() == name; });
+    auto rc = m_controllables_by_name.find(name);
 
-    if (rc == controllables.end()) {
+    if (rc == m_controllables_by_name.end()) {
         throw ParameterError(string{"Module name '"} + name + "' unknown");
     }
     else {
-        return *rc;
+        return rc->second;
     }
 }
 
@@ -148,17 +186,143 @@ void RemoteControllers::set_param(
         const std::string& param,
         const std::string& value)
 {
-    etiLog.level(info) << "RC: Setting " << name << " " << param
-        << " to " << value;
-    RemoteControllable* controllable = get_controllable_(name);
-    try {
-        return controllable->set_parameter(param, value);
+    set_params({{name, param, value}});
+}
+
+void RemoteControllers::apply_changes(const std::vector<rc_param_change_t>& changes)
+{
+    for (const auto& change : changes) {
+        etiLog.level(info) << "RC: Setting " << change.name << " " << change.param
+            << " to " << change.value;
+        RemoteControllable* controllable = get_controllable_(change.name);
+        try {
+            controllable->set_parameter(change.param, change.value);
+        }
+        catch (const ios_base::failure& e) {
+            etiLog.level(info) << "RC: Failed to set " << change.name << " " <<
+                change.param << " to " << change.value << ": " << e.what();
+            throw ParameterError("Cannot understand value");
+        }
+        // After the change, so that get_showjson() cannot cache the old value
+        m_generation++;
+    }
+}
+
+void RemoteControllers::set_params(const std::vector<rc_param_change_t>& changes)
+{
+    bool from_rc_thread = true;
+    for (const auto& change : changes) {
+        if (not get_controllable_(change.name)->set_parameter_from_rc_thread()) {
+            from_rc_thread = false;
+        }
+    }
+
+    if (from_rc_thread or not m_command_queue_enabled.load()) {
+        apply_changes(changes);
+        return;
+    }
+
+    auto command = new queued_command_t();
+    command->changes = changes;
+    auto done = command->done.get_future();
+    auto state = command->state;
+
+    command->next = m_queued_commands.load(memory_order_relaxed);
+    while (not m_queued_commands.compare_exchange_weak(command->next, command,
+                memory_order_seq_cst, memory_order_relaxed)) {
+    }
+
+    // The queue might have been disabled and emptied before we pushed the
+    // command, nobody else would answer it then.
+    if (not m_command_queue_enabled.load()) {
+        fail_queued_commands();
     }
-    catch (const ios_base::failure& e) {
-        etiLog.level(info) << "RC: Failed to set " << name << " " << param
-        << " to " << value << ": " << e.what();
-        throw ParameterError("Cannot understand value");
+
+    if (done.wait_for(chrono::seconds(10)) != future_status::ready) {
+        auto expected = command_state_t::Queued;
+        if (state->compare_exchange_strong(expected, command_state_t::Cancelled)) {
+            throw ParameterError("Timeout waiting for the multiplexer to apply the change");
+        }
+        // The main loop is applying it right now, it will answer shortly
     }
+
+    // Rethrows the exception of the main loop
+    done.get();
+}
+
+RemoteControllers::queued_command_t* RemoteControllers::take_queued_commands()
+{
+    queued_command_t *command = m_queued_commands.exchange(nullptr, memory_order_seq_cst);
+
+    // The stack has the most recent command first
+    queued_command_t *reversed = nullptr;
+    while (command) {
+        queued_command_t *next = command->next;
+        command->next = reversed;
+        reversed = command;
+        command = next;
+    }
+    return reversed;
+}
+
+void RemoteControllers::apply_queued_commands()
+{
+    if (m_queued_commands.load(memory_order_relaxed) == nullptr) {
+        return;
+    }
+
+    queued_command_t *command = take_queued_commands();
+    while (command) {
+        auto expected = command_state_t::Queued;
+        if (not command->state->compare_exchange_strong(expected,
+                    command_state_t::Applying)) {
+            // Timed out, the client was told it failed
+            queued_command_t *next = command->next;
+            delete command;
+            command = next;
+            continue;
+        }
+
+        try {
+            apply_changes(command->changes);
+            command->done.set_value();
+        }
+        catch (...) {
+            // The remote controller thread handles it as if it had set the
+            // parameter itself
+            command->done.set_exception(std::current_exception());
+        }
+
+        queued_command_t *next = command->next;
+        delete command;
+        command = next;
+    }
+}
+
+void RemoteControllers::fail_queued_commands()
+{
+    queued_command_t *command = take_queued_commands();
+    while (command) {
+        command->done.set_exception(make_exception_ptr(
+                    ParameterError("The multiplexer is not running")));
+        queued_command_t *next = command->next;
+        delete command;
+        command = next;
+    }
+}
+
+void RemoteControllers::enable_command_queue(bool enable)
+{
+    m_command_queue_enabled.store(enable);
+
+    if (not enable) {
+        fail_queued_commands();
+    }
+}
+
+RemoteControllers::~RemoteControllers()
+{
+    enable_command_queue(false);
 }
 
 // This runs in a separate thread, because
@@ -186,6 +350,7 @@ void RemoteControllerTelnet::handle_accept(Socket::TCPSocket&& socket)
 
     try {
         etiLog.level(info) << "RC: Accepted";
+        m_batch.reset();
 
         socket.sendall(welcome.data(), welcome.size());
 
@@ -299,6 +464,12 @@ void RemoteControllerTelnet::dispatch_command(Socket::TCPSocket& socket, string
                 "    * Gets the value for the specified PARAMETER from module MODULE\n"
                 "  set MODULE PARAMETER VALUE\n"
                 "    * Sets the value for the PARAMETER ofr module MODULE\n"
+                "  begin\n"
+                "    * Collect the following set commands until commit\n"
+                "  commit\n"
+                "    * Apply the collected set commands in the same frame\n"
+                "  abort\n"
+                "    * Discard the collected set commands\n"
                 "  quit\n"
                 "    * Terminate this session\n"
                 "\n");
@@ -367,8 +538,14 @@ void RemoteControllerTelnet::dispatch_command(Socket::TCPSocket& socket, string
                     }
                 }
 
-                rcs.set_param(cmd[1], cmd[2], new_param_value.str());
-                reply(socket, "ok");
+                if (m_batch) {
+                    m_batch->push_back({cmd[1], cmd[2], new_param_value.str()});
+                    reply(socket, "queued");
+                }
+                else {
+                    rcs.set_param(cmd[1], cmd[2], new_param_value.str());
+                    reply(socket, "ok");
+                }
             }
             catch (const ParameterError &e) {
                 reply(socket, e.what());
@@ -381,6 +558,38 @@ void RemoteControllerTelnet::dispatch_command(Socket::TCPSocket& socket, string
             reply(socket, "Incorrect parameters for command 'set'");
         }
     }
+    else if (cmd[0] == "begin") {
+        if (m_batch) {
+            reply(socket, "Already collecting set commands");
+        }
+        else {
+            m_batch.emplace();
+            reply(socket, "ok");
+        }
+    }
+    else if (cmd[0] == "commit") {
+        if (not m_batch) {
+            reply(socket, "No 'begin' before 'commit'");
+        }
+        else {
+            const auto changes = std::move(*m_batch);
+            m_batch.reset();
+            try {
+                rcs.set_params(changes);
+                reply(socket, "ok");
+            }
+            catch (const ParameterError &e) {
+                reply(socket, e.what());
+            }
+            catch (const exception &e) {
+                reply(socket, "Error: Invalid parameter value. ");
+            }
+        }
+    }
+    else if (cmd[0] == "abort") {
+        m_batch.reset();
+        reply(socket, "ok");
+    }
     else if (cmd[0] == "quit") {
         reply(socket, "Goodbye");
     }
@@ -564,27 +773,35 @@ void RemoteControllerZmq::process()
                         send_fail_reply(repSocket, err.what());
                     }
                 }
-                else if (msg.size() == 3 && command == "get") {
-                    const std::string module((char*) msg[1].data(), msg[1].size());
-                    const std::string parameter((char*) msg[2].data(), msg[2].size());
+                else if (msg.size() >= 3 && (msg.size() - 1) % 2 == 0 && command == "get") {
+                    // Several module, parameter pairs give one value each, in the same order
+                    std::vector<std::pair<std::string, std::string> > params;
+                    for (size_t i = 1; i < msg.size(); i += 2) {
+                        params.emplace_back(msg[i], msg[i+1]);
+                    }
 
                     try {
-                        std::string value = rcs.get_param(module, parameter);
-                        zmq::message_t zmsg(value.size());
-                        memcpy ((void*) zmsg.data(), value.data(), value.size());
-                        repSocket.send(zmsg, zmq::send_flags::none);
+                        const auto values = rcs.get_params(params);
+                        for (size_t i = 0; i < values.size(); i++) {
+                            zmq::message_t zmsg(values[i].size());
+                            memcpy ((void*) zmsg.data(), values[i].data(), values[i].size());
+                            repSocket.send(zmsg, (i + 1 < values.size()) ?
+                                    zmq::send_flags::sndmore : zmq::send_flags::none);
+                        }
                     }
                     catch (const ParameterError &err) {
                         send_fail_reply(repSocket, err.what());
                     }
                 }
-                else if (msg.size() == 4 && command == "set") {
-                    const std::string module((char*) msg[1].data(), msg[1].size());
-                    const std::string parameter((char*) msg[2].data(), msg[2].size());
-                    const std::string value((char*) msg[3].data(), msg[3].size());
+                else if (msg.size() >= 4 && (msg.size() - 1) % 3 == 0 && command == "set") {
+                    // Several module, parameter, value triplets are applied in the same frame
+                    std::vector<rc_param_change_t> changes;
+                    for (size_t i = 1; i < msg.size(); i += 3) {
+                        changes.push_back({msg[i], msg[i+1], msg[i+2]});
+                    }
 
                     try {
-                        rcs.set_param(module, parameter, value);
+                        rcs.set_params(changes);
                         send_ok_reply(repSocket);
                     }
                     catch (const ParameterError &err) {
@@ -42,11 +42,17 @@
 #include <variant>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
 #include <atomic>
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <thread>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "Log.h"
 #include "Socket.h"
@@ -125,21 +131,46 @@ class RemoteControllable {
 
         virtual const json::map_t get_all_values() const = 0;
 
+        /* Parameters are normally set by the main loop between two frames,
+         * see RemoteControllers::apply_queued_commands(). Controllables
+         * whose state is protected against concurrent access can return
+         * true, to be set directly from the remote controller thread.
+         */
+        virtual bool set_parameter_from_rc_thread() const { return false; }
+
     protected:
         std::string m_rc_name;
         std::list< std::vector<std::string> > m_parameters;
 };
 
+struct rc_param_change_t {
+    std::string name;
+    std::string param;
+    std::string value;
+};
+
 /* Holds all our remote controllers and controlled object.
  */
 class RemoteControllers {
     public:
+        ~RemoteControllers();
+
         void add_controller(std::shared_ptr<BaseRemoteController> rc);
         void enrol(RemoteControllable *rc);
         void remove_controllable(RemoteControllable *rc);
         void check_faults();
         std::list< std::vector<std::string> > get_param_list_values(const std::string& name);
         std::string get_param(const std::string& name, const std::string& param);
+
+        /* Get several parameters, given as controllable name and parameter
+         * name. Throws a ParameterError at the first one that fails. */
+        std::vector<std::string> get_params(
+                const std::vector<std::pair<std::string, std::string> >& params);
+
+        /* The values of all controllables, in JSON. The result is rebuilt
+         * after a parameter was set or a controllable was added or
+         * removed, and otherwise at most every SHOWJSON_MAX_AGE, for
+         * the values that change by themselves. */
         std::string get_showjson();
 
         void set_param(
@@ -147,11 +178,66 @@ class RemoteControllers {
                 const std::string& param,
                 const std::string& value);
 
+        /* Set several parameters in the same frame, in the given order.
+         * Throws a ParameterError at the first change that fails, the
+         * changes before it stay applied. */
+        void set_params(const std::vector<rc_param_change_t>& changes);
+
+        /* When the command queue is enabled, set_param and set_params
+         * queue the changes and wait until the main loop has applied them
+         * with apply_queued_commands(). Disabling the queue fails the
+         * commands that are still waiting. */
+        void enable_command_queue(bool enable);
+
+        /* Called by the main loop between two frames */
+        void apply_queued_commands();
+
         std::list<RemoteControllable*> controllables;
 
     private:
         RemoteControllable* get_controllable_(const std::string& name);
 
+        // Index of controllables, by name. If two have the same name, the
+        // first one enrolled is used, like in the list
+        std::unordered_map<std::string, RemoteControllable*> m_controllables_by_name;
+
+        // Incremented every time a parameter is set, or the controllables change
+        std::atomic<uint64_t> m_generation = 0;
+
+        static constexpr std::chrono::milliseconds SHOWJSON_MAX_AGE{100};
+        std::mutex m_showjson_mutex;
+        std::string m_showjson;
+        uint64_t m_showjson_generation = 0;
+        std::chrono::steady_clock::time_point m_showjson_time;
+
+        void apply_changes(const std::vector<rc_param_change_t>& changes);
+
+        /* Commands are pushed onto a lock-free stack by the remote
+         * controller threads. The main loop takes the whole stack at once
+         * and applies the commands in the order they were pushed. The
+         * command gets deleted by the main loop, the remote controller
+         * thread only keeps the future and the state. A command that timed
+         * out is cancelled, unless the main loop has already started to
+         * apply it. */
+        enum class command_state_t { Queued, Applying, Cancelled };
+
+        struct queued_command_t {
+            std::vector<rc_param_change_t> changes;
+            std::promise<void> done;
+            std::shared_ptr<std::atomic<command_state_t> > state =
+                std::make_shared<std::atomic<command_state_t> >(command_state_t::Queued);
+            queued_command_t *next = nullptr;
+        };
+
+        // Returns the commands in the order they were pushed
+        queued_command_t* take_queued_commands();
+
+        // Answer the commands still in the queue with an error
+        void fail_queued_commands();
+
+        std::atomic<queued_command_t*> m_queued_commands = nullptr;
+        std::atomic<bool> m_command_queue_enabled = false;
+
         std::list<std::shared_ptr<BaseRemoteController> > m_controllers;
 };
 
@@ -206,6 +292,10 @@ class RemoteControllerTelnet : public BaseRemoteController {
 
         Socket::TCPSocket m_socket;
         int m_port;
+
+        /* Changes collected between 'begin' and 'commit' on the current
+         * connection */
+        std::optional<std::vector<rc_param_change_t> > m_batch;
 };
 
 #if defined(HAVE_ZEROMQ)
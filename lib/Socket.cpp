@@ -31,6 +31,9 @@
 #include <cerrno>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <netinet/tcp.h>
 
 namespace Socket {
@@ -1126,10 +1129,22 @@ TCPConnection::stats_t TCPConnection::get_stats() const
             );
 
     s.buffer_fullness = std::accumulate(buffer_sizes.cbegin(), buffer_sizes.cend(), 0);
+    s.queued_buffers = buffer_sizes.size();
     s.remote_address = m_sock.get_remote_address();
     return s;
 }
 
+// Upper bound on the number of buffers given to a single sendmsg()
+static const size_t MAX_IOV = 64;
+
+static void set_nonblock(int fd)
+{
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 or fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        throw runtime_error(string("Could not set O_NONBLOCK: ") + strerror(errno));
+    }
+}
+
 TCPDataDispatcher::TCPDataDispatcher(size_t max_queue_size, size_t buffers_to_preroll) :
     m_max_queue_size(max_queue_size),
     m_buffers_to_preroll(buffers_to_preroll)
@@ -1139,19 +1154,54 @@ TCPDataDispatcher::TCPDataDispatcher(size_t max_queue_size, size_t buffers_to_pr
 TCPDataDispatcher::~TCPDataDispatcher()
 {
     m_running = false;
-    if (m_listener_thread.joinable()) {
-        m_listener_thread.join();
+    if (m_event_fd != -1) {
+        const uint64_t one = 1;
+        if (::write(m_event_fd, &one, sizeof(one)) == -1) {
+            // The dispatcher thread will notice on the next epoll_wait timeout
+        }
+    }
+    if (m_dispatcher_thread.joinable()) {
+        m_dispatcher_thread.join();
     }
     m_listener_socket.close();
     m_connections.clear();
+    m_dropped.clear();
+
+    if (m_epoll_fd != -1) {
+        ::close(m_epoll_fd);
+    }
+    if (m_event_fd != -1) {
+        ::close(m_event_fd);
+    }
 }
 
 void TCPDataDispatcher::start(int port, const string& address)
 {
     m_listener_socket.listen(port, address);
+    const int listen_fd = m_listener_socket.get_sockfd();
+    set_nonblock(listen_fd);
+
+    m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll_fd == -1) {
+        throw runtime_error(string("TCPDataDispatcher epoll_create1 error: ") + strerror(errno));
+    }
+
+    m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_event_fd == -1) {
+        throw runtime_error(string("TCPDataDispatcher eventfd error: ") + strerror(errno));
+    }
+
+    for (const int fd : {listen_fd, m_event_fd}) {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            throw runtime_error(string("TCPDataDispatcher epoll_ctl error: ") + strerror(errno));
+        }
+    }
 
     m_running = true;
-    m_listener_thread = std::thread(&TCPDataDispatcher::process, this);
+    m_dispatcher_thread = std::thread(&TCPDataDispatcher::process, this);
 }
 
 void TCPDataDispatcher::write(const vector<uint8_t>& data)
@@ -1160,40 +1210,82 @@ void TCPDataDispatcher::write(const vector<uint8_t>& data)
         throw runtime_error(m_exception_data);
     }
 
-    auto lock = unique_lock<mutex>(m_mutex);
-
-    if (m_buffers_to_preroll > 0) {
-        m_preroll_queue.push_back(data);
-        if (m_preroll_queue.size() > m_buffers_to_preroll) {
-            m_preroll_queue.pop_front();
-        }
+    auto buf = make_shared<const vector<uint8_t> >(data);
+    {
+        auto lock = unique_lock<mutex>(m_pending_mutex);
+        m_pending.push_back(std::move(buf));
     }
 
-    for (auto& connection : m_connections) {
-        connection.queue.push(data);
+    const uint64_t one = 1;
+    if (::write(m_event_fd, &one, sizeof(one)) == -1 and errno != EAGAIN) {
+        throw runtime_error(string("TCPDataDispatcher eventfd write error: ") + strerror(errno));
     }
-
-    m_connections.remove_if( [&](const TCPConnection& conn){ return conn.queue.size() > m_max_queue_size; });
 }
 
 void TCPDataDispatcher::process()
 {
     try {
         const int timeout_ms = 1000;
+        const int listen_fd = m_listener_socket.get_sockfd();
+
+        constexpr int max_events = 64;
+        struct epoll_event events[max_events];
 
         while (m_running) {
-            // Add a new TCPConnection to the list, constructing it from the client socket
-            auto sock = m_listener_socket.accept(timeout_ms);
-            if (sock.valid()) {
-                auto lock = unique_lock<mutex>(m_mutex);
-                m_connections.emplace(m_connections.begin(), std::move(sock));
-
-                if (m_buffers_to_preroll > 0) {
-                    for (const auto& buf : m_preroll_queue) {
-                        m_connections.front().queue.push(buf);
+            const int num_events = epoll_wait(m_epoll_fd, events, max_events, timeout_ms);
+            if (num_events == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw runtime_error(string("epoll_wait error: ") + strerror(errno));
+            }
+
+            auto lock = unique_lock<mutex>(m_mutex);
+            for (int i = 0; i < num_events; i++) {
+                const int fd = events[i].data.fd;
+
+                if (fd == listen_fd) {
+                    accept_connections();
+                }
+                else if (fd == m_event_fd) {
+                    uint64_t count = 0;
+                    if (::read(m_event_fd, &count, sizeof(count)) == -1 and errno != EAGAIN) {
+                        throw runtime_error(string("eventfd read error: ") + strerror(errno));
+                    }
+
+                    deque<buffer_t> buffers;
+                    {
+                        auto pending_lock = unique_lock<mutex>(m_pending_mutex);
+                        buffers.swap(m_pending);
+                    }
+                    distribute(buffers);
+                }
+                else {
+                    auto it = m_connections.find(fd);
+                    if (it == m_connections.end()) {
+                        continue;
+                    }
+
+                    bool keep = not (events[i].events & (EPOLLERR | EPOLLHUP));
+
+                    if (keep and (events[i].events & EPOLLIN)) {
+                        // We don't expect anything from the clients, but
+                        // need to read to detect disconnections.
+                        uint8_t discard[256];
+                        const ssize_t r = ::recv(fd, discard, sizeof(discard), 0);
+                        keep = r > 0 or (r == -1 and (errno == EAGAIN or errno == EINTR));
+                    }
+
+                    if (keep and (events[i].events & EPOLLOUT)) {
+                        keep = flush(it->second);
+                    }
+
+                    if (not keep) {
+                        drop(it);
                     }
                 }
             }
+            m_dropped.clear();
         }
     }
     catch (const std::runtime_error& e) {
@@ -1202,13 +1294,170 @@ void TCPDataDispatcher::process()
     }
 }
 
+void TCPDataDispatcher::accept_connections()
+{
+    while (true) {
+        auto sock = m_listener_socket.accept(0);
+        if (not sock.valid()) {
+            // EAGAIN, or the client is already gone
+            break;
+        }
+
+        const int fd = sock.get_sockfd();
+        try {
+            set_nonblock(fd);
+        }
+        catch (const runtime_error&) {
+            continue;
+        }
+
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            continue;
+        }
+
+        auto it = m_connections.emplace(fd, Connection(std::move(sock))).first;
+
+        auto& conn = it->second;
+        for (const auto& buf : m_preroll_queue) {
+            conn.queue.push_back(buf);
+            conn.queued_bytes += buf->size();
+        }
+
+        if (not flush(conn)) {
+            drop(it);
+        }
+    }
+}
+
+void TCPDataDispatcher::distribute(deque<buffer_t>& buffers)
+{
+    for (auto& buf : buffers) {
+        for (auto& [fd, conn] : m_connections) {
+            conn.queue.push_back(buf);
+            conn.queued_bytes += buf->size();
+        }
+
+        if (m_buffers_to_preroll > 0) {
+            m_preroll_queue.push_back(std::move(buf));
+            if (m_preroll_queue.size() > m_buffers_to_preroll) {
+                m_preroll_queue.pop_front();
+            }
+        }
+    }
+
+    for (auto it = m_connections.begin(); it != m_connections.end();) {
+        auto& conn = it->second;
+
+        // While waiting for POLLOUT, the socket buffer is known to be full
+        // and the data will be sent when epoll tells us.
+        const bool keep = conn.waiting_for_pollout or flush(conn);
+
+        if (not keep or conn.queue.size() > m_max_queue_size) {
+            it = drop(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+bool TCPDataDispatcher::flush(Connection& conn)
+{
+    /* On Linux, the MSG_NOSIGNAL flag ensures that the process would not
+     * receive a SIGPIPE and die.
+     * Other systems have SO_NOSIGPIPE set on the socket for the same effect. */
+#if defined(HAVE_MSG_NOSIGNAL)
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    while (not conn.queue.empty()) {
+        struct iovec iov[MAX_IOV];
+        size_t num_iov = 0;
+        for (const auto& buf : conn.queue) {
+            if (num_iov == MAX_IOV) {
+                break;
+            }
+            const size_t skip = (num_iov == 0) ? conn.offset : 0;
+            iov[num_iov].iov_base = const_cast<uint8_t*>(buf->data()) + skip;
+            iov[num_iov].iov_len = buf->size() - skip;
+            num_iov++;
+        }
+
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = num_iov;
+
+        const ssize_t sent = ::sendmsg(conn.sock.get_sockfd(), &msg, flags);
+        if (sent == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // This suppresses the -Wlogical-op warning
+#if EAGAIN == EWOULDBLOCK
+            else if (errno == EAGAIN)
+#else
+            else if (errno == EAGAIN or errno == EWOULDBLOCK)
+#endif
+            {
+                return set_pollout(conn, true);
+            }
+            return false;
+        }
+
+        conn.queued_bytes -= sent;
+        size_t remaining = sent;
+        while (not conn.queue.empty()) {
+            const size_t left_in_front = conn.queue.front()->size() - conn.offset;
+            if (remaining < left_in_front) {
+                conn.offset += remaining;
+                break;
+            }
+            remaining -= left_in_front;
+            conn.offset = 0;
+            conn.queue.pop_front();
+        }
+    }
+
+    return set_pollout(conn, false);
+}
+
+bool TCPDataDispatcher::set_pollout(Connection& conn, bool enable)
+{
+    if (conn.waiting_for_pollout == enable) {
+        return true;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | (enable ? EPOLLOUT : 0);
+    ev.data.fd = conn.sock.get_sockfd();
+    if (epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, ev.data.fd, &ev) == -1) {
+        return false;
+    }
+    conn.waiting_for_pollout = enable;
+    return true;
+}
+
+TCPDataDispatcher::connections_t::iterator TCPDataDispatcher::drop(connections_t::iterator it)
+{
+    m_dropped.push_back(std::move(it->second));
+    return m_connections.erase(it);
+}
 
 std::vector<TCPConnection::stats_t> TCPDataDispatcher::get_stats() const
 {
     std::vector<TCPConnection::stats_t> s;
     auto lock = unique_lock<mutex>(m_mutex);
-    for (const auto& conn : m_connections) {
-        s.push_back(conn.get_stats());
+    for (const auto& [fd, conn] : m_connections) {
+        TCPConnection::stats_t st;
+        st.buffer_fullness = conn.queued_bytes;
+        st.queued_buffers = conn.queue.size();
+        st.remote_address = conn.sock.get_remote_address();
+        s.push_back(st);
     }
     return s;
 }
@@ -32,7 +32,10 @@
 #include <cstdlib>
 #include <atomic>
 #include <chrono>
+#include <deque>
 #include <list>
+#include <map>
+#include <mutex>
 #include <memory>
 #include <optional>
 #include <string>
@@ -262,6 +265,7 @@ class TCPConnection
 
         struct stats_t {
             size_t buffer_fullness = 0;
+            size_t queued_buffers = 0;
             InetAddress remote_address;
         };
         stats_t get_stats() const;
@@ -276,6 +280,11 @@ class TCPConnection
 
 /* Send a TCP stream to several destinations, and automatically disconnect destinations
  * whose buffer overflows.
+ *
+ * All connections are served by a single thread using epoll. The data given to
+ * write() is copied once into an immutable buffer shared by all connections,
+ * and sent with non-blocking gathering writes. A connection that lags more than
+ * max_queue_size buffers behind is dropped.
  */
 class TCPDataDispatcher
 {
@@ -291,20 +300,46 @@ class TCPDataDispatcher
         std::vector<TCPConnection::stats_t> get_stats() const;
 
     private:
+        using buffer_t = std::shared_ptr<const std::vector<uint8_t> >;
+
+        struct Connection {
+            Connection(TCPSocket&& s) : sock(std::move(s)) {}
+            TCPSocket sock;
+            std::deque<buffer_t> queue;
+            size_t offset = 0; // bytes of queue.front() already sent
+            size_t queued_bytes = 0;
+            bool waiting_for_pollout = false;
+        };
+        using connections_t = std::map<int, Connection>;
+
         void process();
+        void accept_connections();
+        void distribute(std::deque<buffer_t>& buffers);
+        // Returns false if the connection has to be dropped
+        bool flush(Connection& conn);
+        bool set_pollout(Connection& conn, bool enable);
+        connections_t::iterator drop(connections_t::iterator it);
 
         size_t m_max_queue_size;
         size_t m_buffers_to_preroll;
 
-
         std::atomic<bool> m_running = ATOMIC_VAR_INIT(false);
         std::string m_exception_data;
-        std::thread m_listener_thread;
+        std::thread m_dispatcher_thread;
         TCPSocket m_listener_socket;
+        int m_epoll_fd = -1;
+        int m_event_fd = -1;
+
+        std::mutex m_pending_mutex;
+        std::deque<buffer_t> m_pending;
 
+        // Modified by the dispatcher thread only, the mutex is for get_stats()
         mutable std::mutex m_mutex;
-        std::deque<std::vector<uint8_t> > m_preroll_queue;
-        std::list<TCPConnection> m_connections;
+        std::deque<buffer_t> m_preroll_queue;
+        connections_t m_connections;
+        // Dropped connections are closed after all events of an epoll_wait
+        // were handled, so that their fd doesn't get reused in the meantime.
+        std::vector<Connection> m_dropped;
 };
 
 struct TCPReceiveMessage { virtual ~TCPReceiveMessage() {}; };
@@ -124,19 +124,21 @@ Sender::Sender(const configuration_t& conf) :
     }
 }
 
-void Sender::write(const TagPacket& tagpacket)
+size_t Sender::write(const TagPacket& tagpacket)
 {
     // Assemble into one AF Packet
     edi::AFPacket af_packet = edi_af_packetiser.Assemble(tagpacket);
 
-    write(af_packet);
+    return write(af_packet);
 }
 
-void Sender::write(const AFPacket& af_packet)
+size_t Sender::write(const AFPacket& af_packet)
 {
+    size_t num_packets = 0;
     for (auto& sender : m_pft_spreaders) {
-        sender->send_af_packet(af_packet);
+        num_packets += sender->send_af_packet(af_packet);
     }
+    return num_packets;
 }
 
 void Sender::override_af_sequence(uint16_t seq)
@@ -246,7 +248,7 @@ Sender::PFTSpreader::PFTSpreader(const pft_settings_t& conf, sender_sp sender) :
 {
 }
 
-void Sender::PFTSpreader::send_af_packet(const AFPacket& af_packet)
+size_t Sender::PFTSpreader::send_af_packet(const AFPacket& af_packet)
 {
     using namespace std::chrono;
     if (edi_pft.is_enabled()) {
@@ -282,14 +284,16 @@ void Sender::PFTSpreader::send_af_packet(const AFPacket& af_packet)
                 tp += inter_fragment_wait_time;
             }
         }
+
+        // Actual transmission done in tick() function
+        return edi_fragments.size();
     }
     else /* PFT disabled */ {
         const auto now = steady_clock::now();
         unique_lock<mutex> lock(m_mutex);
         m_pending_frames[now] = std::move(af_packet);
+        return 1;
     }
-
-    // Actual transmission done in tick() function
 }
 
 void Sender::PFTSpreader::tick(const std::chrono::steady_clock::time_point& now)
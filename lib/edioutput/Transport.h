@@ -53,11 +53,12 @@ class Sender {
 
         // Assemble the tagpacket into an AF packet, and if needed,
         // apply PFT and then schedule for transmission.
-        void write(const TagPacket& tagpacket);
+        // Returns the number of packets scheduled for all destinations.
+        size_t write(const TagPacket& tagpacket);
 
         // Schedule an already assembled AF Packet for transmission,
         // applying PFT if needed.
-        void write(const AFPacket& af_packet);
+        size_t write(const AFPacket& af_packet);
 
         // Set the sequence numbers to be used for the next call to write()
         // seq is for the AF layer
@@ -134,7 +135,8 @@ class Sender {
                 sender_sp sender;
                 edi::PFT edi_pft;
 
-                void send_af_packet(const AFPacket &af_packet);
+                // Returns the number of packets scheduled
+                size_t send_af_packet(const AFPacket &af_packet);
                 void tick(const std::chrono::steady_clock::time_point& now);
 
             private:
@@ -22,27 +22,40 @@
  */
 
 #include "webserver.h"
+#include <algorithm>
 #include <future>
+#include <poll.h>
 
 #include "Log.h"
+#include "Metrics.h"
 
 using namespace std;
 
 static const char* http_ok = "HTTP/1.0 200 OK\r\n";
 static const char* http_404 = "HTTP/1.0 404 Not Found\r\n";
+static const char* http_503 = "HTTP/1.0 503 Service Unavailable\r\n";
 /* unused:
 static const char* http_400 = "HTTP/1.0 400 Bad Request\r\n";
 static const char* http_405 = "HTTP/1.0 405 Method Not Allowed\r\n";
 static const char* http_500 = "HTTP/1.0 500 Internal Server Error\r\n";
-static const char* http_503 = "HTTP/1.0 503 Service Unavailable\r\n";
 static const char* http_contenttype_data = "Content-Type: application/octet-stream\r\n";
 static const char* http_contenttype_html = "Content-Type: text/html; charset=utf-8\r\n";
 */
 static const char* http_contenttype_text = "Content-Type: text/plain\r\n";
 static const char* http_contenttype_json = "Content-Type: application/json; charset=utf-8\r\n";
 
+static const char* http_contenttype_event_stream = "Content-Type: text/event-stream\r\n";
+
 static const char* http_nocache = "Cache-Control: no-cache\r\n";
 
+// Stream clients that cannot keep up get disconnected once this much data
+// is waiting to be sent to them
+static constexpr size_t MAX_STREAM_PENDING_BYTES = 1024 * 1024;
+static constexpr size_t MAX_STREAM_CLIENTS = 256;
+// Interval of the comments sent to idle clients, for proxies not to close
+// the connection
+static constexpr auto STREAM_KEEPALIVE_INTERVAL = chrono::seconds(15);
+
 WebServer::WebServer(std::string listen_ip, uint16_t port, const std::string& index_content)
     : index_content(index_content)
 {
@@ -59,6 +72,10 @@ WebServer::~WebServer()
         handler_thread.join();
     }
 
+    if (stream_thread.joinable()) {
+        stream_thread.join();
+    }
+
     server_socket.close();
 }
 
@@ -68,6 +85,25 @@ void WebServer::update_stats_json(const std::string& new_stats_json)
     stats_json = new_stats_json;
 }
 
+void WebServer::set_stats_source(stats_source_t source)
+{
+    unique_lock<mutex> lock(data_mutex);
+    stats_source = source;
+}
+
+void WebServer::set_stats_stream_source(stats_values_source_t source,
+        std::chrono::milliseconds interval)
+{
+    unique_lock<mutex> lock(data_mutex);
+    if (stream_thread.joinable()) {
+        throw logic_error("WebServer stats stream already started");
+    }
+    stats_stream_source = source;
+    stats_stream_interval = interval;
+
+    stream_thread = thread(&WebServer::stream_stats, this);
+}
+
 void WebServer::serve()
 {
     deque<future<bool> > running_connections;
@@ -298,6 +334,12 @@ bool WebServer::dispatch_client(Socket::TCPSocket&& sock)
             else if (req.url == "/stats.json") {
                 success = send_stats(s);
             }
+            else if (req.url == "/metrics") {
+                success = send_metrics(s);
+            }
+            else if (req.url == "/stats/events") {
+                success = subscribe_stats_stream(s);
+            }
         }
         else if (req.is_post) {
             if (req.url == "/rc") {
@@ -339,18 +381,24 @@ bool WebServer::send_index(Socket::TCPSocket& s)
 
 bool WebServer::send_stats(Socket::TCPSocket& s)
 {
-    if (not send_http_response(s, http_ok, "", http_contenttype_json)) {
-        return false;
-    }
-
     std::string jsonstr = "{ }";
+    stats_source_t source;
     {
         unique_lock<mutex> lock(data_mutex);
+        source = stats_source;
         if (not stats_json.empty()) {
             jsonstr = stats_json;
         }
     }
 
+    if (source) {
+        jsonstr = source();
+    }
+
+    if (not send_http_response(s, http_ok, "", http_contenttype_json)) {
+        return false;
+    }
+
     ssize_t ret = s.send(jsonstr.c_str(), jsonstr.size(), MSG_NOSIGNAL);
     if (ret == -1) {
         etiLog.level(warn) << "Failed to send index";
@@ -358,3 +406,220 @@ bool WebServer::send_stats(Socket::TCPSocket& s)
     }
     return true;
 }
+
+bool WebServer::send_metrics(Socket::TCPSocket& s)
+{
+    const auto metrics_text = metrics::registry().render();
+
+    const string content_type = string("Content-Type: ") + metrics::content_type + "\r\n";
+    if (not send_http_response(s, http_ok, "", content_type)) {
+        return false;
+    }
+
+    ssize_t ret = s.send(metrics_text.c_str(), metrics_text.size(), MSG_NOSIGNAL);
+    if (ret == -1) {
+        etiLog.level(warn) << "Failed to send metrics";
+        return false;
+    }
+    return true;
+}
+
+bool WebServer::subscribe_stats_stream(Socket::TCPSocket& s)
+{
+    unique_lock<mutex> lock(data_mutex);
+    if (not stream_thread.joinable()) {
+        return false;
+    }
+
+    if (num_stream_clients + new_stream_clients.size() >= MAX_STREAM_CLIENTS) {
+        etiLog.level(warn) << "Too many clients of the stats stream, refusing " <<
+            s.get_remote_address().to_string();
+        send_http_response(s, http_503, "Too many clients.\r\n");
+        return true;
+    }
+
+    // The stream thread sends the headers together with the first event
+    new_stream_clients.push_back(std::move(s));
+    return true;
+}
+
+struct stream_client_t {
+    Socket::TCPSocket sock;
+    std::string pending;
+    bool snapshot_sent = false;
+    chrono::steady_clock::time_point last_event;
+};
+
+// Send as much of the pending data as the socket accepts without blocking.
+// Returns false if the client is gone.
+static bool flush_stream_client(stream_client_t& client)
+{
+    while (not client.pending.empty()) {
+        const ssize_t ret = ::send(client.sock.get_sockfd(),
+                client.pending.data(), client.pending.size(),
+                MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (ret == -1) {
+            // This suppresses the -Wlogical-op warning
+#if EAGAIN == EWOULDBLOCK
+            if (errno == EAGAIN)
+#else
+            if (errno == EAGAIN or errno == EWOULDBLOCK)
+#endif
+            {
+                break;
+            }
+            else if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        client.pending.erase(0, ret);
+    }
+
+    if (client.pending.size() > MAX_STREAM_PENDING_BYTES) {
+        etiLog.level(warn) << "Stats stream client " <<
+            client.sock.get_remote_address().to_string() <<
+            " too slow, disconnecting";
+        return false;
+    }
+    return true;
+}
+
+void WebServer::stream_stats()
+{
+    using namespace chrono;
+
+    stats_values_source_t source;
+    milliseconds interval;
+    {
+        unique_lock<mutex> lock(data_mutex);
+        source = stats_stream_source;
+        interval = stats_stream_interval;
+    }
+
+    vector<stream_client_t> clients;
+
+    // All clients get the same delta, computed from the values of the previous
+    // interval. Clients that connect in between get these values as snapshot.
+    json::map_t previous_values;
+    bool have_values = false;
+    string previous_snapshot;
+    const auto snapshot_event = [&]() {
+        if (previous_snapshot.empty()) {
+            previous_snapshot = json::map_to_json(previous_values);
+        }
+        return "event: snapshot\ndata: " + previous_snapshot + "\n\n";
+    };
+
+    auto next_update = steady_clock::now();
+
+    while (running) {
+        {
+            unique_lock<mutex> lock(data_mutex);
+            for (auto& sock : new_stream_clients) {
+                stream_client_t client;
+                client.sock = std::move(sock);
+                client.pending = string(http_ok) + http_contenttype_event_stream +
+                    http_nocache + "\r\n";
+                client.last_event = steady_clock::now();
+                clients.push_back(std::move(client));
+            }
+            new_stream_clients.clear();
+            num_stream_clients = clients.size();
+        }
+
+        const auto now = steady_clock::now();
+        if (now >= next_update) {
+            next_update += interval;
+            if (next_update < now) {
+                next_update = now + interval;
+            }
+
+            if (clients.empty()) {
+                // Do not compute the stats for nobody, and make sure the
+                // next client does not get stale values
+                previous_values.clear();
+                previous_snapshot.clear();
+                have_values = false;
+            }
+            else {
+                json::map_t values = source();
+                const auto delta = json::diff(previous_values, values);
+                const string delta_event = delta.empty() ? "" :
+                    "event: delta\ndata: " + json::map_to_json(delta) + "\n\n";
+                previous_values = std::move(values);
+                previous_snapshot.clear();
+                have_values = true;
+
+                for (auto& client : clients) {
+                    if (not client.snapshot_sent) {
+                        client.pending += snapshot_event();
+                        client.snapshot_sent = true;
+                        client.last_event = now;
+                    }
+                    else if (not delta_event.empty()) {
+                        client.pending += delta_event;
+                        client.last_event = now;
+                    }
+                    else if (now - client.last_event > STREAM_KEEPALIVE_INTERVAL) {
+                        client.pending += ": keepalive\n\n";
+                        client.last_event = now;
+                    }
+                }
+            }
+        }
+
+        for (auto& client : clients) {
+            if (not client.snapshot_sent and have_values) {
+                client.pending += snapshot_event();
+                client.snapshot_sent = true;
+            }
+        }
+
+        vector<struct pollfd> fds(clients.size());
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (not flush_stream_client(clients[i])) {
+                clients[i].sock.close();
+                fds[i].fd = -1;
+                continue;
+            }
+            fds[i].fd = clients[i].sock.get_sockfd();
+            fds[i].events = POLLIN;
+            if (not clients[i].pending.empty()) {
+                fds[i].events |= POLLOUT;
+            }
+            fds[i].revents = 0;
+        }
+
+        // Wake up regularly to pick up new clients
+        const auto timeout = std::min(
+                duration_cast<milliseconds>(next_update - steady_clock::now()),
+                milliseconds(100));
+        if (poll(fds.data(), fds.size(), std::max<int>(timeout.count(), 0)) == -1 and
+                errno != EINTR) {
+            etiLog.level(error) << "Stats stream poll error: " << strerror(errno);
+        }
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            if (fds[i].fd == -1) {
+                continue;
+            }
+
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                clients[i].sock.close();
+            }
+            else if (fds[i].revents & POLLIN) {
+                // Clients have nothing to say, except that they disconnect
+                char buf[512];
+                const ssize_t ret = ::recv(fds[i].fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (ret == 0 or (ret == -1 and errno != EAGAIN and errno != EINTR)) {
+                    clients[i].sock.close();
+                }
+            }
+        }
+
+        clients.erase(std::remove_if(clients.begin(), clients.end(),
+                    [](const stream_client_t& client) { return not client.sock.valid(); }),
+                clients.end());
+    }
+}
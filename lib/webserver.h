@@ -24,9 +24,16 @@
 #pragma once
 #include <cmath>
 #include <atomic>
+#include <chrono>
 #include <cstring>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "Json.h"
 #include "Socket.h"
 
 class WebServer {
@@ -38,11 +45,31 @@ class WebServer {
 
         void update_stats_json(const std::string& new_stats_json);
 
+        /* Instead of the last stats given to update_stats_json(), serve
+         * what the function returns. It is called by the connection
+         * threads for every request. */
+        using stats_source_t = std::function<std::string()>;
+        void set_stats_source(stats_source_t source);
+
+        /* Push the stats to the clients of /stats/events as Server-Sent
+         * Events. The function is called once per interval, whatever the
+         * number of clients. A client first gets a "snapshot" event with
+         * all values, then "delta" events that only contain the values that
+         * changed, see json::diff. Must be called at most once. */
+        using stats_values_source_t = std::function<json::map_t()>;
+        void set_stats_stream_source(stats_values_source_t source,
+                std::chrono::milliseconds interval);
+
     private:
         void serve();
         bool dispatch_client(Socket::TCPSocket&& sock);
         bool send_index(Socket::TCPSocket& s);
         bool send_stats(Socket::TCPSocket& s);
+        bool send_metrics(Socket::TCPSocket& s);
+        bool subscribe_stats_stream(Socket::TCPSocket& s);
+
+        // Event loop that sends the stats to all stream clients
+        void stream_stats();
 
         Socket::TCPSocket server_socket;
 
@@ -53,4 +80,12 @@ class WebServer {
 
         mutable std::mutex data_mutex;
         std::string stats_json;
+        stats_source_t stats_source;
+
+        stats_values_source_t stats_stream_source;
+        std::chrono::milliseconds stats_stream_interval;
+        std::thread stream_thread;
+        // Clients handed over by dispatch_client, not yet seen by stream_stats
+        std::vector<Socket::TCPSocket> new_stream_clients;
+        std::atomic<size_t> num_stream_clients = ATOMIC_VAR_INIT(0);
 };
@@ -1212,6 +1212,40 @@ static void setup_subchannel_from_ptree(shared_ptr<DabSubchannel>& subchan,
         throw runtime_error(ss.str());
     }
 
+    if (auto recording_subchannel = pt.get_optional<string>("recording_subchannel")) {
+        if (proto != "file") {
+            throw runtime_error("Subchannel with uid " + subchanuid +
+                    ": recording_subchannel is only supported for file inputs");
+        }
+
+        const unsigned long recording_subchid = hexparse(*recording_subchannel);
+        if (recording_subchid >= 64) {
+            throw runtime_error("Subchannel with uid " + subchanuid +
+                    ": invalid recording_subchannel " + *recording_subchannel);
+        }
+
+        std::time_t start_time = 0;
+        const string recording_start = pt.get<string>("recording_start", "");
+        if (not recording_start.empty()) {
+            struct tm tm = {};
+            const char *end = strptime(recording_start.c_str(), "%Y-%m-%dT%H:%M:%S", &tm);
+            if (end != nullptr and (*end == '\0' or strcmp(end, "Z") == 0)) {
+                start_time = timegm(&tm);
+            }
+            else {
+                try {
+                    start_time = std::stoll(recording_start);
+                }
+                catch (const std::logic_error&) {
+                    throw runtime_error("Subchannel with uid " + subchanuid +
+                            ": invalid recording_start " + recording_start);
+                }
+            }
+        }
+
+        subchan->input = make_shared<Inputs::EtiRecordingFile>(recording_subchid, start_time);
+    }
+
     if (pt.get("nonblock", false)) {
         if (auto filein = dynamic_pointer_cast<Inputs::FileBase>(subchan->input)) {
             filein->setNonblocking(true);
@@ -1230,6 +1264,15 @@ static void setup_subchannel_from_ptree(shared_ptr<DabSubchannel>& subchan,
         }
     }
 
+    if (pt.get("background_indexing", false)) {
+        if (auto mpegin = dynamic_pointer_cast<Inputs::MPEGFile>(subchan->input)) {
+            mpegin->setBackgroundIndexing(true);
+        }
+        else {
+            etiLog.level(warn) << "The background_indexing option is not supported";
+        }
+    }
+
     const string bufferManagement = pt.get("buffer-management", "prebuffering");
     if (bufferManagement == "prebuffering") {
         subchan->input->setBufferManagement(Inputs::BufferManagement::Prebuffering);
@@ -31,6 +31,7 @@
 
 #include "DabMultiplexer.h"
 #include "ConfigParser.h"
+#include "FrameTrace.h"
 #include "ManagementServer.h"
 #include "crc.h"
 #include "utils.h"
@@ -125,6 +126,7 @@ std::pair<uint32_t, std::time_t> MuxTime::get_milliseconds_seconds()
 void DabMultiplexerConfig::read(const std::string& filename)
 {
     m_config_file = "";
+    m_version++;
     try {
         if (stringEndsWith(filename, ".json")) {
             read_json(filename, pt);
@@ -145,12 +147,17 @@ DabMultiplexer::DabMultiplexer(DabMultiplexerConfig& config, ClockTAI& clock_tai
     m_config(config),
     m_time(),
     ensemble(std::make_shared<dabEnsemble>()),
-    m_clock_tai(clock_tai)
+    m_clock_tai(clock_tai),
+    m_metric_frames(metrics::registry().counter("odr_dabmux_frames",
+                "Number of ETI frames created"))
 {
     RC_ADD_PARAMETER(frames, "Show number of frames generated [read-only]");
     RC_ADD_PARAMETER(tist_offset, "Configured tist-offset");
     RC_ADD_PARAMETER(reload_linking, "Write 1 to this parameter to trigger a reload of the linkage sets, frequency info and other-services from the config [write-only]");
     RC_ADD_PARAMETER(fic_repetition_correction, "In highly loaded ensembles, nominal repetition rates cannot be respected. Increase this correction factor to allow longer deadlines.");
+    RC_ADD_PARAMETER(slow_frame_threshold, "Log a breakdown of the frames that take longer than this many milliseconds to create, 0 to disable");
+    RC_ADD_PARAMETER(frame_timing, "Show percentiles of the time spent in each stage of the frame creation [read-only]");
+    RC_ADD_PARAMETER(frame_timing_reset, "Write 1 to this parameter to reset the frame timing histograms [write-only]");
 }
 
 void DabMultiplexer::set_edi_config(const edi::configuration_t& new_edi_conf)
@@ -190,6 +197,12 @@ void DabMultiplexer::prepare(bool require_tai_clock)
                 m_fig_carousel_priority.emplace(ensemble, time_func);
                 break;
             }
+        case FIC::FIGSchedulerType::EDF:
+            {
+                etiLog.level(info) << "Using earliest deadline first FIG scheduler";
+                m_fig_carousel_edf.emplace(ensemble, time_func);
+                break;
+            }
     }
 
     rcs.enrol(this);
@@ -231,13 +244,13 @@ void DabMultiplexer::prepare(bool require_tai_clock)
             currentFrame, edi_time,
             (timestamp & 0xFFFFFF) / 16384000.0);
 
-    // Try to load offset once
+    // Load the offset once, and keep it up to date in the background
 
     m_tai_clock_required = (tist_enabled and edi_conf.enabled()) or require_tai_clock;
 
     if (m_tai_clock_required) {
         try {
-            m_clock_tai.get_offset();
+            m_clock_tai.start();
         }
         catch (const std::runtime_error& e) {
             etiLog.level(error) <<
@@ -294,6 +307,17 @@ void DabMultiplexer::prepare(bool require_tai_clock)
 
     if (m_fig_carousel_classic)
         m_fig_carousel_classic->set_rate_correction(m_config.pt.get<double>("general.fic-repetition-correction", 1.0));
+
+    vector<string> subchannel_uids;
+    for (const auto& subchannel : ensemble->subchannels) {
+        subchannel_uids.push_back(subchannel->uid);
+    }
+    m_timing.set_inputs(subchannel_uids);
+    for (const auto& uid : subchannel_uids) {
+        m_trace_inputs.push_back(get_frame_trace().register_source(uid));
+    }
+    m_timing.set_slow_frame_threshold(m_config.pt.get<double>("general.slow-frame-threshold", 0));
+    m_timing.registerAtServer();
 }
 
 
@@ -438,24 +462,7 @@ void DabMultiplexer::prepare_data_inputs()
             throw MuxInitException();
         }
         (*subchannel)->bitrate = subch_bitrate;
-
-        /* Use EEP unless we find a UEP configuration
-         * UEP is only used for MPEG audio, but some bitrates don't
-         * have a UEP profile (EN 300 401 Clause 6.2.1).
-         * For these bitrates, we must switch to EEP.
-         *
-         * AAC audio and data is already EEP
-         */
-        if (protection->form == UEP) {
-            protection->form = EEP;
-            for (int i = 0; i < 64; i++) {
-                if ( (*subchannel)->bitrate == BitRateTable[i] &&
-                        protection->level == ProtectionLevelTable[i] ) {
-                    protection->form = UEP;
-                    protection->uep.tableIndex = i;
-                }
-            }
-        }
+        (*subchannel)->select_protection_form();
 
         /* EEP B can only be used for subchannels with bitrates
          * multiple of 32kbit/s
@@ -542,17 +549,43 @@ void DabMultiplexer::reload_linking()
 /* Helper method for FIG carousel write_fibs - abstracts the scheduler type */
 size_t DabMultiplexer::fig_carousel_write_fibs(uint8_t* buf, uint64_t current_frame, bool fib3_present)
 {
+    size_t written = 0;
+    FIC::FICFillStats stats;
+
     if (m_fig_carousel_priority) {
-        return m_fig_carousel_priority->write_fibs(buf, current_frame, fib3_present);
+        written = m_fig_carousel_priority->write_fibs(buf, current_frame, fib3_present);
+        stats = m_fig_carousel_priority->last_frame_stats();
+    } else if (m_fig_carousel_edf) {
+        written = m_fig_carousel_edf->write_fibs(buf, current_frame, fib3_present);
+        stats = m_fig_carousel_edf->last_frame_stats();
     } else if (m_fig_carousel_classic) {
-        return m_fig_carousel_classic->write_fibs(buf, current_frame, fib3_present);
+        written = m_fig_carousel_classic->write_fibs(buf, current_frame, fib3_present);
+        stats = m_fig_carousel_classic->last_frame_stats();
+    }
+
+    get_mgmt_server().fic_frame_filled(stats.capacity(), stats.used());
+    return written;
+}
+
+DabMultiplexer::output_metrics_t& DabMultiplexer::get_output_metrics(const DabOutput& output)
+{
+    auto it = m_output_metrics.find(&output);
+    if (it == m_output_metrics.end()) {
+        output_metrics_t m;
+        m.write_errors = &metrics::registry().counter(
+                "odr_dabmux_output_write_errors",
+                "Number of ETI frames the output failed to write",
+                {{"output", output.get_info()}});
+        it = m_output_metrics.emplace(&output, m).first;
     }
-    return 0;
+    return it->second;
 }
 
 /*  Each call creates one ETI frame */
 void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs)
 {
+    m_timing.begin_frame(currentFrame);
+
     unsigned char etiFrame[6144];
     unsigned short index = 0;
 
@@ -583,6 +616,8 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
     auto tist_edi_time = m_time.get_tist_seconds();
     const auto timestamp = tist_edi_time.first;
     const auto edi_time = tist_edi_time.second;
+    get_frame_trace().begin_frame(currentFrame,
+            tist_enabled ? (timestamp & 0xffffff) : 0xffffff, edi_time);
     /*
     etiLog.level(debug) << "Frame " << currentFrame << " " << edi_time <<
         " + " << (timestamp >> TIMESTAMP_LEVEL_2_SHIFT);
@@ -770,7 +805,13 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
 
     // Insert all FIBs using the selected scheduler
     const bool fib3_present = (ensemble->transmission_mode == TransmissionMode_e::TM_III);
-    index += fig_carousel_write_fibs(&etiFrame[index], currentFrame, fib3_present);
+    m_timing.stage_done(FrameTiming::stage_t::Header);
+    const size_t fic_size = fig_carousel_write_fibs(&etiFrame[index], currentFrame, fib3_present);
+    for (size_t fib = 0; fib < fic_size / 32; fib++) {
+        get_frame_trace().record_fib(fib, &etiFrame[index + 32 * fib]);
+    }
+    index += fic_size;
+    m_timing.stage_done(FrameTiming::stage_t::Fic);
 
     /**********************************************************************
      ******  Input Data Reading *******************************************
@@ -790,14 +831,16 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
                     "Subchannel %d read failed at ETI frame number: %d",
                     subchannel->id, currentFrame);
         }
+        get_frame_trace().record(frametrace::event_type_t::InputRead, m_trace_inputs[i],
+                sizeSubchannel, result);
 
         // save pointer to Audio or Data Stream into correct TagESTn for EDI
         edi_est_tags[i].mst_data = &etiFrame[index];
 
         index += sizeSubchannel;
+        m_timing.input_done(i);
     }
 
-
     index = (3 + fc->NST + FICL) * 4;
     for (auto subchannel : ensemble->subchannels) {
         index += subchannel->getSizeByte();
@@ -836,23 +879,16 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
         edi_tagDETI.tsta = 0xffffff;
     }
 
+    frame_metadata_t frame_md;
+    frame_md.due_time_ms = m_time.due_time_ms();
     if (tist_enabled and m_tai_clock_required) {
         edi_tagDETI.set_edi_time(edi_time, tai_utc_offset);
         edi_tagDETI.atstf = true;
 
-        for (auto output : outputs) {
-            shared_ptr<OutputMetadata> md_utco =
-                make_shared<OutputMetadataUTCO>(edi_tagDETI.utco);
-            output->setMetadata(md_utco);
-
-            shared_ptr<OutputMetadata> md_edi_time =
-                make_shared<OutputMetadataEDITime>(edi_tagDETI.seconds);
-            output->setMetadata(md_edi_time);
-
-            shared_ptr<OutputMetadata> md_dlfc =
-                make_shared<OutputMetadataDLFC>(currentFrame % 5000);
-            output->setMetadata(md_dlfc);
-        }
+        frame_md.timestamp_valid = true;
+        frame_md.utco = edi_tagDETI.utco;
+        frame_md.edi_seconds = edi_tagDETI.seconds;
+        frame_md.dlfc = currentFrame % 5000;
     }
 
     /* Coding of the TIST, according to ETS 300 799 Annex C
@@ -874,25 +910,40 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
 
     int frame_size = (FLtmp + 1 + 1 + 1 + 1) * 4;
 
-    for (auto output : outputs) {
-        auto out_zmq = std::dynamic_pointer_cast<DabOutputZMQ>(output);
-        if (out_zmq) {
-            // The separator allows the receiver to associate the right
-            // metadata with the right ETI frame, since the output gathers
-            // four ETI frames into one message
-            shared_ptr<OutputMetadata> md_sep =
-                make_shared<OutputMetadataSeparation>();
-            out_zmq->setMetadata(md_sep);
+    if (m_timing.num_outputs() != outputs.size()) {
+        vector<string> output_names;
+        for (const auto& output : outputs) {
+            output_names.push_back(output->get_info());
+        }
+        m_timing.set_outputs(output_names);
+
+        m_trace_outputs.clear();
+        for (const auto& name : output_names) {
+            m_trace_outputs.push_back(get_frame_trace().register_source(name));
         }
     }
+    m_timing.stage_done(FrameTiming::stage_t::Crc);
 
     // Give the data to the outputs
-    for (auto output : outputs) {
-        if (output->Write(etiFrame, frame_size) == -1) {
+    for (size_t i = 0; i < outputs.size(); i++) {
+        const auto& output = outputs[i];
+        auto& output_metrics = get_output_metrics(*output);
+
+        if (output->wantsMetadata()) {
+            output->setMetadata(frame_md);
+        }
+
+        const bool write_failed = output->Write(etiFrame, frame_size) == -1;
+        if (write_failed) {
+            output_metrics.write_errors->inc();
             etiLog.level(error) <<
                 "Can't write to output " <<
                 output->get_info();
         }
+        get_frame_trace().record(frametrace::event_type_t::OutputWrite, m_trace_outputs[i],
+                frame_size, write_failed);
+
+        m_timing.output_done(i);
     }
 
     /**********************************************************************
@@ -907,12 +958,15 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
             edi_tagpacket.tag_items.push_back(&tag);
         }
 
-        edi_sender->write(edi_tagpacket);
+        const size_t num_packets = edi_sender->write(edi_tagpacket);
+        get_frame_trace().record(frametrace::event_type_t::EdiWrite, 0, num_packets);
 
         for (const auto& stat : edi_sender->get_tcp_server_stats()) {
             get_mgmt_server().update_edi_tcp_output_stat(
                     stat.listen_port, stat.stats);
         }
+
+        m_timing.stage_done(FrameTiming::stage_t::Edi);
     }
 
 #if _DEBUG
@@ -932,6 +986,9 @@ void DabMultiplexer::mux_frame(std::vector<std::shared_ptr<DabOutput> >& outputs
     }
 #endif
 
+    m_metric_frames.inc();
+    m_timing.end_frame();
+
     currentFrame++;
 }
 
@@ -969,6 +1026,26 @@ void DabMultiplexer::set_parameter(const std::string& parameter,
             throw ParameterError(ss.str());
         }
     }
+    else if (parameter == "slow_frame_threshold") {
+        try {
+            m_timing.set_slow_frame_threshold(std::stod(value));
+        }
+        catch (const logic_error& e) {
+            stringstream ss;
+            ss << "Error: " << e.what();
+            throw ParameterError(ss.str());
+        }
+    }
+    else if (parameter == "frame_timing") {
+        stringstream ss;
+        ss << "Parameter '" << parameter <<
+            "' of " << get_rc_name() <<
+            " is read-only";
+        throw ParameterError(ss.str());
+    }
+    else if (parameter == "frame_timing_reset") {
+        m_timing.reset();
+    }
     else {
         stringstream ss;
         ss << "Parameter '" << parameter <<
@@ -1002,6 +1079,17 @@ const std::string DabMultiplexer::get_parameter(const std::string& parameter) co
             throw ParameterError(ss.str());
         }
     }
+    else if (parameter == "slow_frame_threshold") {
+        ss << m_timing.get_slow_frame_threshold();
+    }
+    else if (parameter == "frame_timing") {
+        ss << m_timing.summary();
+    }
+    else if (parameter == "frame_timing_reset") {
+        ss << "Parameter '" << parameter <<
+            "' is not write-only in controllable " << get_rc_name();
+        throw ParameterError(ss.str());
+    }
     else {
         ss << "Parameter '" << parameter <<
             "' is not exported by controllable " << get_rc_name();
@@ -1022,6 +1110,8 @@ const json::map_t DabMultiplexer::get_all_values() const
     else {
         map["fic_repetition_correction"] = std::nullopt;
     }
+    map["slow_frame_threshold"] = m_timing.get_slow_frame_threshold();
+    map["frame_timing"] = m_timing.encode_json();
     return map;
 }
 
@@ -33,10 +33,14 @@
 #include "edioutput/Transport.h"
 #include "fig/FIGCarousel.h"
 #include "fig/FIGCarouselPriority.h"
+#include "fig/FIGCarouselEDF.h"
 #include "fig/FIGSchedulerType.h"
 #include "MuxElements.h"
 #include "RemoteControl.h"
 #include "ClockTAI.h"
+#include "FrameTiming.h"
+#include "Metrics.h"
+#include <unordered_map>
 #include <vector>
 #include <memory>
 #include <optional>
@@ -74,6 +78,11 @@ class MuxTime {
         uint64_t init(uint32_t tist_at_fct0_ms, double tist_offset);
         void increment_timestamp();
         double tist_offset() const { return m_tist_offset_ms / 1000.0; }
+
+        /* Milliseconds since the UNIX epoch at which the current frame is
+         * due, i.e. its timestamp minus the tist_offset */
+        int64_t due_time_ms() const {
+            return (int64_t)m_edi_time * 1000 + m_pps_offset_ms - m_tist_offset_ms; }
         void set_tist_offset(double new_tist_offset);
 };
 
@@ -85,8 +94,13 @@ class DabMultiplexerConfig {
         bool valid() const { return m_config_file != ""; }
         std::string config_file() const { return m_config_file; }
 
+        // Incremented every time pt is read, so that copies of it
+        // can be updated only when it changes
+        uint64_t version() const { return m_version; }
+
     private:
         std::string m_config_file;
+        uint64_t m_version = 0;
 };
 
 class DabMultiplexer : public RemoteControllable {
@@ -130,7 +144,7 @@ class DabMultiplexer : public RemoteControllable {
         bool m_tai_clock_required = false;
         ClockTAI& m_clock_tai;
 
-        /* FIG Carousel - supports classic and priority schedulers
+        /* FIG Carousel - supports classic, priority and EDF schedulers
          *
          * Only one of these will be instantiated based on config.
          * The scheduler type is determined by ensemble->fic_scheduler
@@ -139,7 +153,26 @@ class DabMultiplexer : public RemoteControllable {
         FIC::FIGSchedulerType m_scheduler_type = FIC::FIGSchedulerType::Classic;
         std::optional<FIC::FIGCarousel> m_fig_carousel_classic;
         std::optional<FIC::FIGCarouselPriority> m_fig_carousel_priority;
+        std::optional<FIC::FIGCarouselEDF> m_fig_carousel_edf;
 
         /* Helper method for FIG carousel write_fibs */
         size_t fig_carousel_write_fibs(uint8_t* buf, uint64_t current_frame, bool fib3_present);
+
+        /* Time spent in the stages of mux_frame, see FrameTiming.h */
+        FrameTiming m_timing;
+
+        /* Sources of the trace events of the subchannels and outputs,
+         * see FrameTrace.h */
+        std::vector<uint16_t> m_trace_inputs;
+        std::vector<uint16_t> m_trace_outputs;
+
+        /* Metrics of mux_frame, see Metrics.h */
+        metrics::Counter& m_metric_frames;
+
+        struct output_metrics_t {
+            metrics::Counter* write_errors;
+        };
+        std::unordered_map<const DabOutput*, output_metrics_t> m_output_metrics;
+
+        output_metrics_t& get_output_metrics(const DabOutput& output);
 };
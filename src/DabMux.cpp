@@ -44,6 +44,7 @@
 #include <set>
 
 #include "DabMultiplexer.h"
+#include "FrameTrace.h"
 
 #include "dabOutput/dabOutput.h"
 #include "MuxElements.h"
@@ -57,12 +58,19 @@ using namespace std;
 using boost::property_tree::ptree;
 
 volatile sig_atomic_t running = 1;
+volatile sig_atomic_t trace_dump_requested = 0;
 
 /* We are not allowed to use etiLog in the signal handler,
  * because etiLog uses mutexes
  */
 void signalHandler(int signum)
 {
+    if (signum == SIGUSR1) {
+        // The main loop dumps the trace
+        trace_dump_requested = 1;
+        return;
+    }
+
     fprintf(stderr, "\npid: %i, ppid: %i\n", getpid(), getppid());
 
 #define SIG_MSG "Signal received: "
@@ -113,7 +121,7 @@ int main(int argc, char *argv[])
     memset(&sa, 0, sizeof(struct sigaction));
     sa.sa_handler = &signalHandler;
 
-    const int sigs[] = {SIGHUP, SIGQUIT, SIGINT, SIGTERM};
+    const int sigs[] = {SIGHUP, SIGQUIT, SIGINT, SIGTERM, SIGUSR1};
     for (int sig : sigs) {
         if (sigaction(sig, &sa, nullptr) == -1) {
             perror("sigaction");
@@ -180,6 +188,10 @@ int main(int argc, char *argv[])
             etiLog.register_backend(std::make_shared<LogToSyslog>());
         }
 
+        etiLog.set_rate_limit(
+                mux_conf.pt.get<size_t>("general.log-rate-limit", 100),
+                std::chrono::minutes(1));
+
         const auto startupcheck = mux_conf.pt.get<string>("general.startupcheck", "");
         if (not startupcheck.empty()) {
             etiLog.level(info) << "Running startup check '" << startupcheck << "'";
@@ -228,6 +240,17 @@ int main(int argc, char *argv[])
 
             etiLog.level(info) << "Starting webserver at " << http_listen_on << ":" << http_port;
             webserver.emplace(http_listen_on, http_port, index_text);
+            webserver->set_stats_source([]() {
+                    return get_mgmt_server().get_json_stats_for_http();
+                });
+
+            const double stream_interval = mux_conf.pt.get<double>(
+                    "general.http-stats-stream-interval", 0.5);
+            if (stream_interval > 0) {
+                webserver->set_stats_stream_source([]() {
+                        return get_mgmt_server().get_stats_for_http();
+                    }, std::chrono::milliseconds(lrint(stream_interval * 1000)));
+            }
         }
 
         /************** READ REMOTE CONTROL PARAMETERS *************/
@@ -245,15 +268,23 @@ int main(int argc, char *argv[])
 
         const int tai_clock_offset = mux_conf.pt.get<int>("general.tai_clock_offset", 0);
         const string tai_bulletins = mux_conf.pt.get("general.tai_clock_bulletins", "");
+        const string tai_leap_seconds_file = mux_conf.pt.get(
+                "general.tai_clock_leap_seconds_file", "/usr/share/zoneinfo/leap-seconds.list");
         ClockTAI clock_tai;
         if (tai_clock_offset > 0) {
             clock_tai.init(tai_clock_offset);
         }
         else {
-            clock_tai.init(tai_bulletins);
+            clock_tai.init(tai_bulletins, tai_leap_seconds_file);
         }
         rcs.enrol(&clock_tai);
 
+        /* The trace must be ready before the inputs get created */
+        get_frame_trace().init(
+                mux_conf.pt.get<size_t>("general.trace-events", 65536),
+                mux_conf.pt.get<string>("general.trace-file", "/tmp/odr-dabmux-trace.bin"));
+        rcs.enrol(&get_frame_trace());
+
         DabMultiplexer mux(mux_conf, clock_tai);
 
         etiLog.level(info) <<
@@ -442,6 +473,10 @@ int main(int argc, char *argv[])
                 } else if (proto == "simul") {
                     output = make_shared<DabOutputSimul>();
 #endif // defined(HAVE_OUTPUT_SIMUL)
+#if defined(HAVE_OUTPUT_SHM)
+                } else if (proto == "shm") {
+                    output = make_shared<DabOutputShm>();
+#endif // defined(HAVE_OUTPUT_SHM)
 #if defined(HAVE_OUTPUT_ZEROMQ)
                 /* The legacy configuration setting will not enable metadata,
                  * to keep backward compatibility
@@ -496,12 +531,25 @@ int main(int argc, char *argv[])
 
         const size_t limit = mux_conf.pt.get("general.nbframes", 0);
 
+        get_mgmt_server().set_clocktai_expiry(clock_tai.expires_at());
+
+        /* From now on, changes from the remote control are applied
+         * between two frames, by this thread */
+        rcs.enable_command_queue(true);
+
         etiLog.level(info) << "Start loop";
         /*   Each iteration of the main loop creates one ETI frame */
         size_t currentFrame;
         for (currentFrame = 0; running; currentFrame++) {
+            rcs.apply_queued_commands();
+
             mux.mux_frame(outputs);
 
+            if (trace_dump_requested) {
+                trace_dump_requested = 0;
+                get_frame_trace().dump_in_background();
+            }
+
             if (limit && currentFrame >= limit) {
                 etiLog.level(info) << "Max number of ETI frames reached: " << currentFrame;
                 break;
@@ -510,13 +558,14 @@ int main(int argc, char *argv[])
             /* Check every six seconds if the remote control is still working */
             if (currentFrame % 250 == 249) {
                 rcs.check_faults();
+                get_mgmt_server().set_clocktai_expiry(clock_tai.expires_at());
             }
 
             /* Same for statistics server */
             if (currentFrame % 10 == 0) {
                 ManagementServer& mgmt_server = get_mgmt_server();
 
-                mgmt_server.set_num_frames(currentFrame);
+                mgmt_server.publish_statistics(currentFrame);
 
                 if (mgmt_server.fault_detected()) {
                     etiLog.level(warn) <<
@@ -524,11 +573,8 @@ int main(int argc, char *argv[])
                     mgmt_server.restart();
                 }
 
-                mgmt_server.update_ptree(mux_conf.pt);
-
-                if (webserver) {
-                    webserver->update_stats_json(mgmt_server.get_json_stats_for_http(clock_tai.expires_at()));
-                }
+                // Only copies the configuration if it changed
+                mgmt_server.update_ptree(mux_conf.pt, mux_conf.version());
             }
         }
     }
@@ -553,6 +599,8 @@ int main(int argc, char *argv[])
         returnCode = 2;
     }
 
+    rcs.enable_command_queue(false);
+
     etiLog.log(debug, "exiting...\n");
     fflush(stderr);
 
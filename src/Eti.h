@@ -120,4 +120,33 @@ struct eti_MNSC_TIME_3 {
     void setFromTime(struct tm *time_tm);
 } PACKED;
 
+// ----- used in File and Fifo outputs, and the ETI recording input
+enum EtiFileType {
+    ETI_FILE_TYPE_NONE = 0,
+    ETI_FILE_TYPE_RAW,
+    ETI_FILE_TYPE_STREAMED,
+    ETI_FILE_TYPE_FRAMED
+};
+
+/* Segmented recordings made by the file output get a sidecar index
+ * with one entry per frame, in the order they were written. See
+ * doc/dab_output_formats.txt. All fields are in host byte order.
+ */
+#define ETI_INDEX_MAGIC "ETIIDX01"
+
+struct eti_index_header {
+    char magic[8];
+    uint32_t file_type; // EtiFileType of the recording
+    uint32_t entry_size; // sizeof(eti_index_entry)
+} PACKED;
+
+struct eti_index_entry {
+    uint64_t offset;       // Position of the frame in the recording
+    int64_t wallclock_ms;  // UNIX time in milliseconds when the frame was written
+    uint32_t edi_seconds;  // EDI seconds from the output metadata, 0 if unknown
+    uint32_t tist;         // TIST of the frame, 0xFFFFFF if disabled
+    uint16_t dlfc;         // DLFC from the metadata, or FCT if unknown
+    uint16_t rfu;
+} PACKED;
+
 #endif // ETI_
@@ -0,0 +1,245 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameClock.h"
+#include "Log.h"
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+static const int64_t NS_PER_S = 1000000000;
+static const int64_t FRAME_DURATION_NS = 24000000;
+
+const std::array<int64_t, FrameClock::NUM_BUCKETS - 1> FrameClock::bucket_limits_us = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+static struct timespec to_timespec(int64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / NS_PER_S;
+    ts.tv_nsec = ns % NS_PER_S;
+    return ts;
+}
+
+FrameClock::FrameClock(const config_t& config) :
+    RemoteControllable("frameclock"),
+    m_config(config)
+{
+    for (auto& bucket : m_histogram) {
+        bucket = 0;
+    }
+
+    RC_ADD_PARAMETER(histogram, "Number of frames per lateness bucket");
+    RC_ADD_PARAMETER(max_lateness, "Largest lateness in microseconds");
+    RC_ADD_PARAMETER(mean_lateness, "Mean lateness in microseconds");
+    RC_ADD_PARAMETER(reset, "Set to 1 to clear the statistics");
+
+    // Fail early if the kernel doesn't support the clock
+    now_ns();
+}
+
+int64_t FrameClock::now_ns() const
+{
+    struct timespec ts;
+    if (clock_gettime(m_config.clock_id, &ts) != 0) {
+        throw runtime_error(string("FrameClock: clock_gettime failed: ") + strerror(errno));
+    }
+    return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+void FrameClock::start()
+{
+    m_next_deadline_ns = now_ns() + FRAME_DURATION_NS;
+}
+
+void FrameClock::set_frame_due_time(int64_t due_time_ms)
+{
+    if (not m_config.align) {
+        return;
+    }
+
+    struct timespec ts;
+    if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        throw runtime_error(string("FrameClock: clock_gettime failed: ") + strerror(errno));
+    }
+    const int64_t realtime_ns = ts.tv_sec * NS_PER_S + ts.tv_nsec;
+
+    // The due time is in UTC, our clock is TAI
+    const int64_t clock_offset_s = llround((double)(now_ns() - realtime_ns) / NS_PER_S);
+    const int64_t deadline_ns = (due_time_ms + clock_offset_s * 1000) * 1000000;
+
+    if (deadline_ns != m_next_deadline_ns) {
+        if (m_aligned) {
+            etiLog.level(info) << "FrameClock: multiplexer timestamps moved by " <<
+                (deadline_ns - m_next_deadline_ns) / 1000000 << "ms";
+        }
+        else {
+            etiLog.level(info) << "FrameClock: aligned to the multiplexer timestamps, "
+                "TAI-UTC " << clock_offset_s << "s";
+        }
+        m_next_deadline_ns = deadline_ns;
+    }
+    m_aligned = true;
+}
+
+void FrameClock::wait_next_frame()
+{
+    const int64_t spin_ns = chrono::duration_cast<chrono::nanoseconds>(m_config.spin).count();
+    const int64_t sleep_until = m_next_deadline_ns - spin_ns;
+
+    const struct timespec ts = to_timespec(sleep_until);
+    int r = 0;
+    do {
+        r = clock_nanosleep(m_config.clock_id, TIMER_ABSTIME, &ts, nullptr);
+    } while (r == EINTR);
+
+    if (r != 0) {
+        throw runtime_error(string("FrameClock: clock_nanosleep failed: ") + strerror(r));
+    }
+
+    int64_t now = now_ns();
+    while (now < m_next_deadline_ns) {
+        now = now_ns();
+    }
+
+    record_lateness(now - m_next_deadline_ns);
+
+    // When we are late, the following frames are released immediately
+    // until we catch up, as the downstream timestamps expect one frame
+    // every 24ms.
+    m_next_deadline_ns += FRAME_DURATION_NS;
+}
+
+void FrameClock::record_lateness(int64_t lateness_ns)
+{
+    const int64_t lateness_us = lateness_ns / 1000;
+
+    size_t bucket = 0;
+    while (bucket < bucket_limits_us.size() and lateness_us >= bucket_limits_us[bucket]) {
+        bucket++;
+    }
+
+    m_histogram[bucket].fetch_add(1, memory_order_relaxed);
+    m_num_frames.fetch_add(1, memory_order_relaxed);
+    m_total_lateness_ns.fetch_add(lateness_ns, memory_order_relaxed);
+
+    if (lateness_ns > m_max_lateness_ns.load(memory_order_relaxed)) {
+        m_max_lateness_ns.store(lateness_ns, memory_order_relaxed);
+    }
+}
+
+void FrameClock::reset_stats()
+{
+    for (auto& bucket : m_histogram) {
+        bucket = 0;
+    }
+    m_num_frames = 0;
+    m_max_lateness_ns = 0;
+    m_total_lateness_ns = 0;
+}
+
+void FrameClock::set_parameter(const string& parameter, const string& value)
+{
+    if (parameter == "reset") {
+        if (value == "1") {
+            reset_stats();
+        }
+    }
+    else if (parameter == "histogram" or parameter == "max_lateness" or
+            parameter == "mean_lateness") {
+        throw ParameterError("Parameter '" + parameter +
+            "' is read-only in controllable " + get_rc_name());
+    }
+    else {
+        throw ParameterError("Parameter '" + parameter +
+            "' is not exported by controllable " + get_rc_name());
+    }
+}
+
+const string FrameClock::get_parameter(const string& parameter) const
+{
+    stringstream ss;
+    if (parameter == "histogram") {
+        // <limit_us>:<count> pairs, the last bucket is unbounded
+        for (size_t i = 0; i < NUM_BUCKETS; i++) {
+            if (i > 0) {
+                ss << ",";
+            }
+            if (i < bucket_limits_us.size()) {
+                ss << "<" << bucket_limits_us[i];
+            }
+            else {
+                ss << ">=" << bucket_limits_us.back();
+            }
+            ss << ":" << m_histogram[i].load(memory_order_relaxed);
+        }
+    }
+    else if (parameter == "max_lateness") {
+        ss << m_max_lateness_ns.load(memory_order_relaxed) / 1000;
+    }
+    else if (parameter == "mean_lateness") {
+        const uint64_t n = m_num_frames.load(memory_order_relaxed);
+        ss << (n ? m_total_lateness_ns.load(memory_order_relaxed) / 1000 / (int64_t)n : 0);
+    }
+    else if (parameter == "reset") {
+        throw ParameterError("Parameter '" + parameter +
+            "' is write-only in controllable " + get_rc_name());
+    }
+    else {
+        throw ParameterError("Parameter '" + parameter +
+            "' is not exported by controllable " + get_rc_name());
+    }
+    return ss.str();
+}
+
+const json::map_t FrameClock::get_all_values() const
+{
+    json::map_t map;
+
+    vector<json::value_t> histogram;
+    vector<json::value_t> limits;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        json::value_t count;
+        count = m_histogram[i].load(memory_order_relaxed);
+        histogram.push_back(count);
+
+        if (i < bucket_limits_us.size()) {
+            json::value_t limit;
+            limit = bucket_limits_us[i];
+            limits.push_back(limit);
+        }
+    }
+    map["histogram"] = histogram;
+    map["histogram_limits_us"] = limits;
+
+    const uint64_t n = m_num_frames.load(memory_order_relaxed);
+    map["frames"] = n;
+    map["max_lateness"] = m_max_lateness_ns.load(memory_order_relaxed) / 1000;
+    map["mean_lateness"] = n ? m_total_lateness_ns.load(memory_order_relaxed) / 1000 / (int64_t)n : 0;
+    return map;
+}
+
@@ -0,0 +1,106 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include "RemoteControl.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <time.h>
+
+/* Releases one ETI frame every 24ms.
+ *
+ * Every frame has an absolute deadline on the selected clock, derived from
+ * the start time and the number of frames, and the thread sleeps until the
+ * deadline with clock_nanosleep(TIMER_ABSTIME). The wakeup latency of one
+ * frame therefore has no influence on the following ones. The end of the
+ * wait can be done in a busy loop, which trades CPU time for lower jitter.
+ *
+ * How late each frame was released is collected in a histogram that is
+ * available through the remote control.
+ */
+class FrameClock : public RemoteControllable {
+    public:
+        struct config_t {
+            // CLOCK_MONOTONIC or CLOCK_TAI
+            clockid_t clock_id = CLOCK_MONOTONIC;
+
+            // How long before the deadline we stop sleeping and spin
+            std::chrono::microseconds spin = std::chrono::microseconds(0);
+
+            // Release every frame when it is due according to the timestamps
+            // of the multiplexer, given with set_frame_due_time(). Requires
+            // CLOCK_TAI, which the kernel keeps at a whole number of seconds
+            // from UTC.
+            bool align = false;
+        };
+
+        static constexpr size_t NUM_BUCKETS = 10;
+
+        // Upper bounds of the lateness histogram buckets in microseconds.
+        // The last bucket contains everything above the last limit.
+        static const std::array<int64_t, NUM_BUCKETS - 1> bucket_limits_us;
+
+        FrameClock(const config_t& config);
+
+        /* Set the deadline of the first frame, one frame duration from now */
+        void start();
+
+        /* When aligned, make the deadline of the next frame the time at
+         * which it is due, in milliseconds since the UNIX epoch. */
+        void set_frame_due_time(int64_t due_time_ms);
+
+        /* Block until the deadline of the next frame */
+        void wait_next_frame();
+
+        /* RemoteControllable */
+        virtual void set_parameter(const std::string& parameter,
+                const std::string& value);
+
+        virtual const std::string get_parameter(
+                const std::string& parameter) const;
+
+        virtual const json::map_t get_all_values() const;
+
+    private:
+        int64_t now_ns() const;
+        void record_lateness(int64_t lateness_ns);
+        void reset_stats();
+
+        config_t m_config;
+        int64_t m_next_deadline_ns = 0;
+        bool m_aligned = false;
+
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_histogram;
+        std::atomic<uint64_t> m_num_frames = ATOMIC_VAR_INIT(0);
+        std::atomic<int64_t> m_max_lateness_ns = ATOMIC_VAR_INIT(0);
+        std::atomic<int64_t> m_total_lateness_ns = ATOMIC_VAR_INIT(0);
+};
+
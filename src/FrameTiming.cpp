@@ -0,0 +1,378 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "FrameTiming.h"
+#include "ManagementServer.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+using namespace std;
+
+static constexpr auto SLOW_FRAME_LOG_INTERVAL = chrono::seconds(10);
+
+static const char* stage_names[FrameTiming::NUM_STAGES] = {
+    "header", "fic", "inputs", "crc", "outputs", "edi" };
+
+/************************************************/
+
+size_t LatencyHistogram::bucket_index(uint64_t duration_us)
+{
+    if (duration_us < NUM_LINEAR) {
+        return duration_us;
+    }
+
+    // Position of the highest bit, at least 4 as NUM_LINEAR is 16
+    const int magnitude = 63 - __builtin_clzll(duration_us);
+    const size_t sub_bucket = (duration_us >> (magnitude - 3)) & (SUB_BUCKETS - 1);
+    const size_t index = NUM_LINEAR + (magnitude - 4) * SUB_BUCKETS + sub_bucket;
+    return std::min(index, NUM_BUCKETS - 1);
+}
+
+uint64_t LatencyHistogram::bucket_highest(size_t index)
+{
+    if (index < NUM_LINEAR) {
+        return index;
+    }
+
+    const int magnitude = 4 + (index - NUM_LINEAR) / SUB_BUCKETS;
+    const uint64_t sub_bucket = (index - NUM_LINEAR) % SUB_BUCKETS;
+    const uint64_t width = 1ULL << (magnitude - 3);
+    return (SUB_BUCKETS + sub_bucket) * width + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t duration_us)
+{
+    m_counts[bucket_index(duration_us)].fetch_add(1, memory_order_relaxed);
+
+    if (duration_us > m_max.load(memory_order_relaxed)) {
+        m_max.store(duration_us, memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto& c : m_counts) {
+        c.store(0, memory_order_relaxed);
+    }
+    m_max.store(0, memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t total = 0;
+    for (const auto& c : m_counts) {
+        total += c.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+    std::array<uint64_t, NUM_BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        counts[i] = m_counts[i].load(memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil(q * total));
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+        cumulative += counts[i];
+        if (cumulative >= rank) {
+            // The bucket cannot contain more than the maximum
+            return std::min(bucket_highest(i), max());
+        }
+    }
+    return max();
+}
+
+json::map_t LatencyHistogram::encode_json() const
+{
+    json::map_t j;
+    j["count"] = count();
+    j["p50_us"] = quantile(0.5);
+    j["p90_us"] = quantile(0.9);
+    j["p99_us"] = quantile(0.99);
+    j["max_us"] = max();
+    return j;
+}
+
+/************************************************/
+
+FrameTiming::FrameTiming() :
+    m_metric_slow_frames(metrics::registry().counter("odr_dabmux_slow_frames",
+                "Number of ETI frames that took longer than the slow frame threshold"))
+{
+    m_total.name = "total";
+    m_total.metric = &metrics::registry().histogram(
+            "odr_dabmux_frame_duration_seconds",
+            "Time spent creating an ETI frame, including the outputs",
+            metrics::duration_buckets());
+
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        m_stages[i].name = stage_names[i];
+        m_stages[i].metric = &metrics::registry().histogram(
+                "odr_dabmux_frame_stage_duration_seconds",
+                "Time spent in each stage of the creation of an ETI frame",
+                metrics::duration_buckets(), {{"stage", stage_names[i]}});
+    }
+}
+
+FrameTiming::~FrameTiming()
+{
+    get_mgmt_server().unregister_frame_timing(this);
+}
+
+void FrameTiming::registerAtServer()
+{
+    get_mgmt_server().register_frame_timing(this);
+}
+
+void FrameTiming::set_inputs(const std::vector<std::string>& names)
+{
+    vector<unique_ptr<element_t>> elements;
+    for (const auto& name : names) {
+        auto e = make_unique<element_t>();
+        e->name = name;
+        e->metric = &metrics::registry().histogram(
+                "odr_dabmux_input_read_duration_seconds",
+                "Time the input needs to deliver the data of a frame",
+                metrics::duration_buckets(), {{"input", name}});
+        elements.push_back(std::move(e));
+    }
+
+    unique_lock<mutex> lock(m_elements_mutex);
+    m_inputs = std::move(elements);
+    m_frame_inputs_us.assign(names.size(), 0);
+}
+
+void FrameTiming::set_outputs(const std::vector<std::string>& names)
+{
+    vector<unique_ptr<element_t>> elements;
+    for (const auto& name : names) {
+        auto e = make_unique<element_t>();
+        e->name = name;
+        e->metric = &metrics::registry().histogram(
+                "odr_dabmux_output_write_duration_seconds",
+                "Time the output needs to accept an ETI frame",
+                metrics::duration_buckets(), {{"output", name}});
+        elements.push_back(std::move(e));
+    }
+
+    unique_lock<mutex> lock(m_elements_mutex);
+    m_outputs = std::move(elements);
+    m_frame_outputs_us.assign(names.size(), 0);
+}
+
+void FrameTiming::begin_frame(uint64_t frame_number)
+{
+    m_frame_number = frame_number;
+    m_frame_start = chrono::steady_clock::now();
+    m_last_stamp = m_frame_start;
+    m_frame_stages_us.fill(0);
+    std::fill(m_frame_inputs_us.begin(), m_frame_inputs_us.end(), 0);
+    std::fill(m_frame_outputs_us.begin(), m_frame_outputs_us.end(), 0);
+}
+
+uint64_t FrameTiming::stamp()
+{
+    const auto now = chrono::steady_clock::now();
+    const auto elapsed = now - m_last_stamp;
+    m_last_stamp = now;
+    return chrono::duration_cast<chrono::microseconds>(elapsed).count();
+}
+
+void FrameTiming::stage_done(stage_t stage)
+{
+    m_frame_stages_us[static_cast<size_t>(stage)] += stamp();
+}
+
+void FrameTiming::input_done(size_t index)
+{
+    const uint64_t elapsed_us = stamp();
+    m_frame_inputs_us.at(index) = elapsed_us;
+    m_frame_stages_us[static_cast<size_t>(stage_t::Inputs)] += elapsed_us;
+}
+
+void FrameTiming::output_done(size_t index)
+{
+    const uint64_t elapsed_us = stamp();
+    m_frame_outputs_us.at(index) = elapsed_us;
+    m_frame_stages_us[static_cast<size_t>(stage_t::Outputs)] += elapsed_us;
+}
+
+static void record(FrameTiming::element_t& element, uint64_t duration_us)
+{
+    element.histogram.record(duration_us);
+    element.metric->observe(duration_us / 1e6);
+}
+
+void FrameTiming::end_frame()
+{
+    const auto now = chrono::steady_clock::now();
+    const uint64_t total_us =
+        chrono::duration_cast<chrono::microseconds>(now - m_frame_start).count();
+
+    record(m_total, total_us);
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        record(m_stages[i], m_frame_stages_us[i]);
+    }
+    for (size_t i = 0; i < m_inputs.size(); i++) {
+        record(*m_inputs[i], m_frame_inputs_us[i]);
+    }
+    for (size_t i = 0; i < m_outputs.size(); i++) {
+        record(*m_outputs[i], m_frame_outputs_us[i]);
+    }
+
+    const double threshold_ms = m_slow_frame_threshold_ms.load(memory_order_relaxed);
+    if (threshold_ms > 0 and total_us > threshold_ms * 1000.0) {
+        m_metric_slow_frames.inc();
+
+        if (now - m_last_slow_frame_log > SLOW_FRAME_LOG_INTERVAL) {
+            log_slow_frame(total_us);
+            m_last_slow_frame_log = now;
+            m_num_slow_frames_not_logged = 0;
+        }
+        else {
+            m_num_slow_frames_not_logged++;
+        }
+    }
+}
+
+void FrameTiming::log_slow_frame(uint64_t total_us)
+{
+    auto slowest = [](const vector<unique_ptr<element_t>>& elements,
+            const vector<uint64_t>& durations_us) -> string {
+        const auto it = max_element(durations_us.begin(), durations_us.end());
+        if (it == durations_us.end() or *it == 0) {
+            return "";
+        }
+        const size_t ix = it - durations_us.begin();
+        return " (slowest " + elements[ix]->name + " " + to_string(*it) + "us)";
+    };
+
+    stringstream ss;
+    ss << "Slow frame " << m_frame_number << " took " << total_us << "us:";
+    for (size_t i = 0; i < NUM_STAGES; i++) {
+        ss << " " << stage_names[i] << " " << m_frame_stages_us[i] << "us";
+        if (i == static_cast<size_t>(stage_t::Inputs)) {
+            ss << slowest(m_inputs, m_frame_inputs_us);
+        }
+        else if (i == static_cast<size_t>(stage_t::Outputs)) {
+            ss << slowest(m_outputs, m_frame_outputs_us);
+        }
+    }
+
+    if (m_num_slow_frames_not_logged > 0) {
+        ss << ", " << m_num_slow_frames_not_logged << " other slow frames since last report";
+    }
+
+    etiLog.level(warn) << ss.str();
+}
+
+void FrameTiming::set_slow_frame_threshold(double threshold_ms)
+{
+    if (threshold_ms < 0) {
+        throw out_of_range("Slow frame threshold cannot be negative");
+    }
+    m_slow_frame_threshold_ms.store(threshold_ms, memory_order_relaxed);
+}
+
+double FrameTiming::get_slow_frame_threshold() const
+{
+    return m_slow_frame_threshold_ms.load(memory_order_relaxed);
+}
+
+void FrameTiming::reset()
+{
+    m_total.histogram.reset();
+    for (auto& stage : m_stages) {
+        stage.histogram.reset();
+    }
+
+    unique_lock<mutex> lock(m_elements_mutex);
+    for (auto& input : m_inputs) {
+        input->histogram.reset();
+    }
+    for (auto& output : m_outputs) {
+        output->histogram.reset();
+    }
+}
+
+json::map_t FrameTiming::encode_json() const
+{
+    json::map_t stages;
+    for (const auto& stage : m_stages) {
+        stages[stage.name] = stage.histogram.encode_json();
+    }
+
+    unique_lock<mutex> lock(m_elements_mutex);
+    json::map_t inputs;
+    for (const auto& input : m_inputs) {
+        inputs[input->name] = input->histogram.encode_json();
+    }
+
+    json::map_t outputs;
+    for (const auto& output : m_outputs) {
+        outputs[output->name] = output->histogram.encode_json();
+    }
+
+    json::map_t j;
+    j["total"] = m_total.histogram.encode_json();
+    j["stages"] = stages;
+    j["inputs"] = inputs;
+    j["outputs"] = outputs;
+    j["slow_frame_threshold_ms"] = get_slow_frame_threshold();
+    return j;
+}
+
+std::string FrameTiming::summary() const
+{
+    stringstream ss;
+    auto line = [&](const string& name, const LatencyHistogram& h) {
+        ss << name << ": p50 " << h.quantile(0.5) << "us, p99 " <<
+            h.quantile(0.99) << "us, max " << h.max() << "us\n";
+    };
+
+    line("total", m_total.histogram);
+    for (const auto& stage : m_stages) {
+        line(stage.name, stage.histogram);
+    }
+
+    unique_lock<mutex> lock(m_elements_mutex);
+    for (const auto& input : m_inputs) {
+        line("input " + input->name, input->histogram);
+    }
+    for (const auto& output : m_outputs) {
+        line("output " + output->name, output->histogram);
+    }
+    return ss.str();
+}
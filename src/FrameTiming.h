@@ -0,0 +1,172 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Time measurement of the stages of the creation of every ETI frame.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#pragma once
+
+#include "Json.h"
+#include "Metrics.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Histogram of durations in microseconds, with buckets whose width grows
+ * with the value, like an HDR histogram: values below 16us have their own
+ * bucket, and every power of two above is split into eight buckets, which
+ * gives a precision of 12.5%. Values above one second go to the last bucket.
+ *
+ * Only one thread may call record(), any thread may read.
+ */
+class LatencyHistogram
+{
+    public:
+        void record(uint64_t duration_us);
+
+        // Forget all values. Values recorded concurrently may get lost.
+        void reset();
+
+        uint64_t count() const;
+        uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+        // Highest value of the bucket that contains the given quantile, 0 if empty
+        uint64_t quantile(double q) const;
+
+        json::map_t encode_json() const;
+
+    private:
+        static constexpr size_t NUM_LINEAR = 16;
+        static constexpr size_t SUB_BUCKETS = 8;
+        static constexpr size_t NUM_BUCKETS = NUM_LINEAR + 17 * SUB_BUCKETS;
+
+        static size_t bucket_index(uint64_t duration_us);
+        static uint64_t bucket_highest(size_t index);
+
+        std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_counts = {};
+        std::atomic<uint64_t> m_max = 0;
+};
+
+/* FrameTiming measures where the time goes in DabMultiplexer::mux_frame.
+ *
+ * The multiplexer calls begin_frame() at the start of the frame, and after
+ * each stage, each input and each output, the corresponding function. Every
+ * call takes one timestamp, and accounts the time since the previous one.
+ * The time spent in the inputs and outputs is also accounted to the Inputs
+ * and Outputs stages. end_frame() records the frame in the histograms, and
+ * logs a breakdown of frames that took longer than the slow frame threshold.
+ *
+ * The histograms are exported as metrics, and through the management server
+ * and the remote control of the multiplexer.
+ */
+class FrameTiming
+{
+    public:
+        enum class stage_t {
+            // Frame header, timestamps and the preparation of the EDI tags
+            Header,
+            Fic,
+            Inputs,
+            // CRC of the main stream, end of frame and TIST
+            Crc,
+            Outputs,
+            Edi,
+        };
+        static constexpr size_t NUM_STAGES = 6;
+
+        FrameTiming();
+        FrameTiming(const FrameTiming& other) = delete;
+        FrameTiming& operator=(const FrameTiming& other) = delete;
+        ~FrameTiming();
+
+        void registerAtServer();
+
+        /* Set the names of the inputs and outputs, which are identified
+         * by their index afterwards. Must be called from the multiplexer
+         * thread. */
+        void set_inputs(const std::vector<std::string>& names);
+        void set_outputs(const std::vector<std::string>& names);
+        size_t num_outputs() const { return m_outputs.size(); }
+
+        void begin_frame(uint64_t frame_number);
+        void stage_done(stage_t stage);
+        void input_done(size_t index);
+        void output_done(size_t index);
+        void end_frame();
+
+        // Threshold in milliseconds above which a breakdown of the frame
+        // is logged, 0 to disable.
+        void set_slow_frame_threshold(double threshold_ms);
+        double get_slow_frame_threshold() const;
+
+        void reset();
+
+        // Percentiles of all histograms
+        json::map_t encode_json() const;
+
+        // One line per histogram
+        std::string summary() const;
+
+        struct element_t {
+            std::string name;
+            LatencyHistogram histogram;
+            metrics::Histogram* metric = nullptr;
+        };
+
+    private:
+        using timepoint_t = std::chrono::steady_clock::time_point;
+
+        // Microseconds since the previous stamp
+        uint64_t stamp();
+
+        void log_slow_frame(uint64_t total_us);
+
+        element_t m_total;
+        std::array<element_t, NUM_STAGES> m_stages;
+
+        /* Only the multiplexer thread changes the inputs and outputs, under
+         * the mutex. It therefore doesn't need the mutex to read them. */
+        mutable std::mutex m_elements_mutex;
+        std::vector<std::unique_ptr<element_t>> m_inputs;
+        std::vector<std::unique_ptr<element_t>> m_outputs;
+
+        /* The current frame, only used by the multiplexer thread */
+        uint64_t m_frame_number = 0;
+        timepoint_t m_frame_start;
+        timepoint_t m_last_stamp;
+        std::array<uint64_t, NUM_STAGES> m_frame_stages_us = {};
+        std::vector<uint64_t> m_frame_inputs_us;
+        std::vector<uint64_t> m_frame_outputs_us;
+
+        // Slow frames are logged at most every SLOW_FRAME_LOG_INTERVAL,
+        // the others are counted.
+        timepoint_t m_last_slow_frame_log;
+        uint64_t m_num_slow_frames_not_logged = 0;
+
+        std::atomic<double> m_slow_frame_threshold_ms = 0;
+        metrics::Counter& m_metric_slow_frames;
+};
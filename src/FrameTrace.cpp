@@ -0,0 +1,292 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "FrameTrace.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace frametrace;
+
+static uint64_t realtime_ns()
+{
+    using namespace chrono;
+    return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+FrameTrace& get_frame_trace()
+{
+    static FrameTrace frame_trace;
+    return frame_trace;
+}
+
+FrameTrace::FrameTrace() :
+    RemoteControllable("trace")
+{
+    RC_ADD_PARAMETER(dump, "Write the events of the last given number of seconds to the trace file, 0 for all events [write-only]");
+    RC_ADD_PARAMETER(file, "File the trace is written to");
+    RC_ADD_PARAMETER(size, "Number of events the trace can hold [read-only]");
+    RC_ADD_PARAMETER(events, "Number of events recorded since startup [read-only]");
+}
+
+FrameTrace::~FrameTrace()
+{
+    if (m_background_dump.valid()) {
+        m_background_dump.wait();
+    }
+}
+
+void FrameTrace::init(size_t num_events, const std::string& filename)
+{
+    {
+        unique_lock<mutex> lock(m_mutex);
+        m_filename = filename;
+    }
+
+    if (num_events == 0) {
+        m_num_slots = 0;
+        m_slots.reset();
+        return;
+    }
+
+    size_t num_slots = 1;
+    while (num_slots < num_events) {
+        num_slots *= 2;
+    }
+
+    m_slots = make_unique<slot_t[]>(num_slots);
+    for (size_t i = 0; i < num_slots; i++) {
+        m_slots[i].seq.store(0, memory_order_relaxed);
+    }
+    m_num_slots = num_slots;
+}
+
+uint16_t FrameTrace::register_source(const std::string& name)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    const auto it = find(m_sources.begin(), m_sources.end(), name);
+    if (it != m_sources.end()) {
+        return it - m_sources.begin();
+    }
+
+    if (m_sources.size() > numeric_limits<uint16_t>::max()) {
+        throw logic_error("Too many trace sources");
+    }
+
+    m_sources.push_back(name);
+    return m_sources.size() - 1;
+}
+
+void FrameTrace::write_slot(event_t& event)
+{
+    event.time_ns = realtime_ns();
+    event.frame = m_frame.load(memory_order_relaxed);
+    event.rfu = 0;
+
+    const uint64_t index = m_write_index.fetch_add(1, memory_order_relaxed);
+    auto& slot = m_slots[index & (m_num_slots - 1)];
+
+    // Mark the slot as being written before touching the event
+    slot.seq.store(2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.event = event;
+
+    slot.seq.store(2 * index + 2, memory_order_release);
+}
+
+void FrameTrace::begin_frame(uint64_t frame, uint32_t tist, uint64_t edi_seconds)
+{
+    m_frame.store(frame, memory_order_relaxed);
+    record(event_type_t::FrameBegin, 0, tist, edi_seconds);
+}
+
+void FrameTrace::record(event_type_t type, uint16_t source, uint64_t a, uint64_t b)
+{
+    if (m_num_slots == 0) {
+        return;
+    }
+
+    event_t event;
+    event.type = type;
+    event.source = source;
+    event.values.a = a;
+    event.values.b = b;
+    write_slot(event);
+}
+
+void FrameTrace::record_fib(uint16_t fib, const uint8_t *fib_data)
+{
+    if (m_num_slots == 0) {
+        return;
+    }
+
+    event_t event;
+    event.type = event_type_t::Fib;
+    event.source = fib;
+    event.fib.figs.fill(0);
+    parse_fib(fib_data, event.fib);
+    write_slot(event);
+}
+
+size_t FrameTrace::dump(const std::string& filename, double seconds) const
+{
+    trace_file_t trace;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        trace.sources = m_sources;
+    }
+
+    const uint64_t write_index = m_write_index.load(memory_order_acquire);
+    const uint64_t first = write_index > m_num_slots ? write_index - m_num_slots : 0;
+    const uint64_t oldest_ns = seconds > 0 ? realtime_ns() - seconds * 1e9 : 0;
+
+    trace.events.reserve(write_index - first);
+    for (uint64_t index = first; index < write_index; index++) {
+        const auto& slot = m_slots[index & (m_num_slots - 1)];
+
+        // Skip the events that are being written, or that were overwritten
+        // while we copied them
+        if (slot.seq.load(memory_order_acquire) != 2 * index + 2) {
+            continue;
+        }
+        const event_t event = slot.event;
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.seq.load(memory_order_relaxed) != 2 * index + 2) {
+            continue;
+        }
+
+        if (event.time_ns >= oldest_ns) {
+            trace.events.push_back(event);
+        }
+    }
+
+    write_trace_file(filename, trace);
+    return trace.events.size();
+}
+
+void FrameTrace::dump_in_background()
+{
+    if (m_background_dump.valid() and
+            m_background_dump.wait_for(chrono::seconds(0)) != future_status::ready) {
+        etiLog.level(warn) << "Trace dump already running";
+        return;
+    }
+
+    m_background_dump = async(launch::async, [this]() {
+            const auto filename = get_filename();
+            try {
+                const size_t num_events = dump(filename, 0);
+                etiLog.level(info) << "Wrote " << num_events << " trace events to " << filename;
+            }
+            catch (const runtime_error& e) {
+                etiLog.level(error) << "Could not dump trace: " << e.what();
+            }
+        });
+}
+
+std::string FrameTrace::get_filename() const
+{
+    unique_lock<mutex> lock(m_mutex);
+    return m_filename;
+}
+
+void FrameTrace::set_parameter(const std::string& parameter,
+        const std::string& value)
+{
+    if (parameter == "dump") {
+        double seconds = 0;
+        try {
+            seconds = std::stod(value);
+        }
+        catch (const logic_error&) {
+            throw ParameterError("Invalid number of seconds " + value);
+        }
+
+        const auto filename = get_filename();
+        try {
+            const size_t num_events = dump(filename, seconds);
+            etiLog.level(info) << "Wrote " << num_events << " trace events to " << filename;
+        }
+        catch (const runtime_error& e) {
+            throw ParameterError(e.what());
+        }
+    }
+    else if (parameter == "file") {
+        unique_lock<mutex> lock(m_mutex);
+        m_filename = value;
+    }
+    else if (parameter == "size" or parameter == "events") {
+        stringstream ss;
+        ss << "Parameter '" << parameter <<
+            "' of " << get_rc_name() <<
+            " is read-only";
+        throw ParameterError(ss.str());
+    }
+    else {
+        stringstream ss;
+        ss << "Parameter '" << parameter <<
+            "' is not exported by controllable " << get_rc_name();
+        throw ParameterError(ss.str());
+    }
+}
+
+const std::string FrameTrace::get_parameter(const std::string& parameter) const
+{
+    stringstream ss;
+    if (parameter == "dump") {
+        ss << "Parameter '" << parameter <<
+            "' is not write-only in controllable " << get_rc_name();
+        throw ParameterError(ss.str());
+    }
+    else if (parameter == "file") {
+        ss << get_filename();
+    }
+    else if (parameter == "size") {
+        ss << m_num_slots;
+    }
+    else if (parameter == "events") {
+        ss << m_write_index.load(memory_order_relaxed);
+    }
+    else {
+        ss << "Parameter '" << parameter <<
+            "' is not exported by controllable " << get_rc_name();
+        throw ParameterError(ss.str());
+    }
+    return ss.str();
+}
+
+const json::map_t FrameTrace::get_all_values() const
+{
+    json::map_t map;
+    map["file"] = get_filename();
+    map["size"] = m_num_slots;
+    map["events"] = m_write_index.load(memory_order_relaxed);
+    return map;
+}
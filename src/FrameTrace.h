@@ -0,0 +1,123 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Flight recorder of the events of every ETI frame, for the analysis
+   of glitches after they happened.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#pragma once
+
+#include "FrameTraceFile.h"
+#include "RemoteControl.h"
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* The multiplexer, the inputs and the outputs record compact binary events
+ * into a fixed-size ring. Any thread can record an event: it claims a slot
+ * with an atomic increment of the write index, and fills it under a
+ * sequence lock, like the slots of the shm:// output (see shmEti.h). Old
+ * events get overwritten, and recording never waits.
+ *
+ * On request over the remote control, or on SIGUSR1, the events of the last
+ * seconds are copied out of the ring and written to a file, which
+ * odr-trace2txt decodes.
+ */
+class FrameTrace : public RemoteControllable
+{
+    public:
+        FrameTrace();
+        FrameTrace(const FrameTrace& other) = delete;
+        FrameTrace& operator=(const FrameTrace& other) = delete;
+        ~FrameTrace();
+
+        /* Allocate a ring for num_events, rounded up to a power of two. 0
+         * disables the trace. Must be called before the first event
+         * gets recorded. */
+        void init(size_t num_events, const std::string& filename);
+
+        /* Inputs and outputs are identified by a number in the events.
+         * Registering the same name twice gives the same number. */
+        uint16_t register_source(const std::string& name);
+
+        /* Record the start of a frame. The events recorded afterwards, from
+         * any thread, carry this frame number. */
+        void begin_frame(uint64_t frame, uint32_t tist, uint64_t edi_seconds);
+
+        void record(frametrace::event_type_t type,
+                uint16_t source = 0, uint64_t a = 0, uint64_t b = 0);
+
+        // Record the content of the FIB, from its 30 data bytes
+        void record_fib(uint16_t fib, const uint8_t *fib_data);
+
+        /* Write the events of the last seconds to the file, all events if
+         * seconds is 0. Returns the number of events written, throws a
+         * runtime_error if the file cannot be written. */
+        size_t dump(const std::string& filename, double seconds) const;
+
+        /* Dump all events to the configured file, from another thread. Does
+         * nothing if the previous dump is still running. */
+        void dump_in_background();
+
+        /* Remote control */
+        virtual void set_parameter(const std::string& parameter,
+               const std::string& value);
+
+        virtual const std::string get_parameter(const std::string& parameter) const;
+
+        virtual const json::map_t get_all_values() const;
+
+        // A dump takes too long to be done between two frames
+        virtual bool set_parameter_from_rc_thread() const { return true; }
+
+    private:
+        struct slot_t {
+            std::atomic<uint64_t> seq;
+            frametrace::event_t event;
+        };
+
+        // Fill in the common fields of the event, and write it to the ring
+        void write_slot(frametrace::event_t& event);
+
+        std::string get_filename() const;
+
+        std::unique_ptr<slot_t[]> m_slots;
+        size_t m_num_slots = 0;
+
+        // Number of events recorded since startup
+        std::atomic<uint64_t> m_write_index = 0;
+
+        std::atomic<uint32_t> m_frame = 0;
+
+        mutable std::mutex m_mutex;
+        std::vector<std::string> m_sources;
+        std::string m_filename;
+
+        std::future<void> m_background_dump;
+};
+
+// Construct the trace on first use, and return a reference to it
+FrameTrace& get_frame_trace();
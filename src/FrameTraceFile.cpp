@@ -0,0 +1,220 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameTraceFile.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace frametrace {
+
+constexpr size_t FIB_DATA_SIZE = 30;
+
+const char* event_type_name(event_type_t type)
+{
+    switch (type) {
+        case event_type_t::FrameBegin: return "frame";
+        case event_type_t::Fib: return "fib";
+        case event_type_t::InputRead: return "read";
+        case event_type_t::InputUnderrun: return "underrun";
+        case event_type_t::InputOverrun: return "overrun";
+        case event_type_t::InputReceived: return "received";
+        case event_type_t::OutputWrite: return "write";
+        case event_type_t::EdiWrite: return "edi";
+    }
+    return "unknown";
+}
+
+void parse_fib(const uint8_t *fib_data, fib_t& fib)
+{
+    fib.used = 0;
+    fib.num_figs = 0;
+
+    size_t i = 0;
+    while (i < FIB_DATA_SIZE) {
+        const uint8_t header = fib_data[i];
+        if (header == 0xff) {
+            // End marker
+            break;
+        }
+
+        const uint8_t type = header >> 5;
+        const size_t length = header & 0x1f;
+        if (length == 0 or i + 1 + length > FIB_DATA_SIZE) {
+            break;
+        }
+
+        // The extension is in the first data byte: five bits for FIG 0,
+        // three bits for FIG 1 and 2
+        const uint8_t first = fib_data[i + 1];
+        const uint8_t extension = (type == 0) ? (first & 0x1f) : (first & 0x07);
+
+        if (fib.num_figs < fib_t::MAX_FIGS) {
+            fib.figs[fib.num_figs] = fig_id(type, extension);
+        }
+        fib.num_figs++;
+
+        i += 1 + length;
+    }
+    fib.used = i;
+}
+
+struct file_closer {
+    void operator()(FILE *fd) { if (fd) fclose(fd); }
+};
+using file_ptr = unique_ptr<FILE, file_closer>;
+
+void write_trace_file(const std::string& filename, const trace_file_t& trace)
+{
+    file_ptr fd(fopen(filename.c_str(), "wb"));
+    if (not fd) {
+        throw runtime_error("Cannot open " + filename + ": " + strerror(errno));
+    }
+
+    trace_file_header_t header = {};
+    memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.event_size = sizeof(event_t);
+    header.num_sources = trace.sources.size();
+    header.num_events = trace.events.size();
+
+    bool success = fwrite(&header, sizeof(header), 1, fd.get()) == 1;
+
+    for (const auto& source : trace.sources) {
+        const uint16_t length = source.size();
+        success = success and
+            fwrite(&length, sizeof(length), 1, fd.get()) == 1 and
+            fwrite(source.data(), 1, length, fd.get()) == length;
+    }
+
+    if (not trace.events.empty()) {
+        success = success and fwrite(trace.events.data(), sizeof(event_t),
+                trace.events.size(), fd.get()) == trace.events.size();
+    }
+
+    if (not success or fflush(fd.get()) != 0) {
+        throw runtime_error("Cannot write " + filename + ": " + strerror(errno));
+    }
+}
+
+trace_file_t read_trace_file(const std::string& filename)
+{
+    file_ptr fd(fopen(filename.c_str(), "rb"));
+    if (not fd) {
+        throw runtime_error("Cannot open " + filename + ": " + strerror(errno));
+    }
+
+    trace_file_header_t header;
+    if (fread(&header, sizeof(header), 1, fd.get()) != 1 or
+            memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        throw runtime_error(filename + " is not a trace file");
+    }
+
+    if (header.version != TRACE_FILE_VERSION or header.event_size != sizeof(event_t)) {
+        throw runtime_error(filename + " has an incompatible format");
+    }
+
+    trace_file_t trace;
+    for (uint32_t i = 0; i < header.num_sources; i++) {
+        uint16_t length = 0;
+        if (fread(&length, sizeof(length), 1, fd.get()) != 1) {
+            throw runtime_error(filename + " is truncated");
+        }
+        string source(length, '\0');
+        if (fread(source.data(), 1, length, fd.get()) != length) {
+            throw runtime_error(filename + " is truncated");
+        }
+        trace.sources.push_back(std::move(source));
+    }
+
+    trace.events.resize(header.num_events);
+    if (fread(trace.events.data(), sizeof(event_t), header.num_events, fd.get()) !=
+            header.num_events) {
+        throw runtime_error(filename + " is truncated");
+    }
+
+    return trace;
+}
+
+std::string describe_event(const event_t& event, const std::vector<std::string>& sources)
+{
+    stringstream ss;
+    ss << event_type_name(event.type);
+
+    switch (event.type) {
+        case event_type_t::FrameBegin:
+        case event_type_t::Fib:
+        case event_type_t::EdiWrite:
+            break;
+        default:
+            ss << " " << (event.source < sources.size() ?
+                    sources[event.source] : "#" + to_string(event.source));
+            break;
+    }
+
+    switch (event.type) {
+        case event_type_t::FrameBegin:
+            if (event.values.a == 0xffffff) {
+                ss << " no tist";
+            }
+            else {
+                ss << " tist " << event.values.a / 16384.0 << "ms";
+            }
+            ss << " edi_seconds " << event.values.b;
+            break;
+        case event_type_t::Fib:
+            ss << " " << event.source << " used " << (int)event.fib.used <<
+                "/" << FIB_DATA_SIZE << " figs";
+            for (size_t i = 0; i < event.fib.num_figs and i < fib_t::MAX_FIGS; i++) {
+                ss << " " << (event.fib.figs[i] >> 5) << "/" << (event.fib.figs[i] & 0x1f);
+            }
+            if (event.fib.num_figs > fib_t::MAX_FIGS) {
+                ss << " and " << event.fib.num_figs - fib_t::MAX_FIGS << " more";
+            }
+            break;
+        case event_type_t::InputRead:
+            ss << " " << (int64_t)event.values.b << "/" << event.values.a << " bytes";
+            break;
+        case event_type_t::InputUnderrun:
+        case event_type_t::InputOverrun:
+            break;
+        case event_type_t::InputReceived:
+            ss << " buffer " << event.values.a << " frames";
+            break;
+        case event_type_t::OutputWrite:
+            ss << " " << event.values.a << " bytes" << (event.values.b ? " failed" : "");
+            break;
+        case event_type_t::EdiWrite:
+            ss << " " << event.values.a << " packets";
+            break;
+    }
+
+    return ss.str();
+}
+
+} // namespace frametrace
@@ -0,0 +1,131 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Events of the frame trace, see FrameTrace.h, and the format of the files
+ * the trace is dumped to. This file and FrameTraceFile.cpp have no other
+ * dependency, so that odr-trace2txt can decode the files.
+ *
+ * A file contains a trace_file_header_t, the names of the sources, each
+ * preceded by its length as uint16_t, and the events. All values are in
+ * the byte order of the host that wrote the file.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define TRACE_FILE_MAGIC "ODRTRACE"
+#define TRACE_FILE_VERSION 1
+
+namespace frametrace {
+
+enum class event_type_t : uint8_t {
+    // The multiplexer starts a frame.
+    // a: TIST of the frame, 0xffffff if disabled. b: EDI seconds
+    FrameBegin = 1,
+    // Content of one FIB, see fib_t. source: index of the FIB
+    Fib,
+    // The multiplexer read a subchannel from its input.
+    // a: size of the subchannel. b: value returned by the input
+    InputRead,
+    // The input had no data for the frame
+    InputUnderrun,
+    // The input had to drop data, because its buffer was full
+    InputOverrun,
+    // The input received a frame, from the thread of the input.
+    // a: number of frames in its buffer
+    InputReceived,
+    // The multiplexer gave the frame to an output.
+    // a: size of the frame. b: 0 on success, 1 if the output failed
+    OutputWrite,
+    // The multiplexer gave the frame to the EDI sender.
+    // a: number of packets scheduled for all destinations
+    EdiWrite,
+};
+
+const char* event_type_name(event_type_t type);
+
+// FIG type and extension, packed in one byte
+inline uint8_t fig_id(uint8_t type, uint8_t extension) {
+    return (type << 5) | (extension & 0x1f);
+}
+
+struct fib_t {
+    // Bytes used by FIGs, out of 30
+    uint8_t used;
+    // Number of FIGs in the FIB. Only the first MAX_FIGS are in figs
+    uint8_t num_figs;
+    static constexpr size_t MAX_FIGS = 14;
+    std::array<uint8_t, MAX_FIGS> figs;
+};
+
+struct values_t {
+    uint64_t a;
+    uint64_t b;
+};
+
+struct event_t {
+    // CLOCK_REALTIME in nanoseconds
+    uint64_t time_ns;
+    // Frame the multiplexer was creating when the event was recorded
+    uint32_t frame;
+    event_type_t type;
+    uint8_t rfu;
+    // Index in the list of sources, for the input and output events
+    uint16_t source;
+    union {
+        values_t values;
+        fib_t fib;
+    };
+};
+
+static_assert(sizeof(event_t) == 32, "trace events must stay compact");
+
+// Fill in the fib_t from the 30 data bytes of a FIB, by parsing the FIG headers
+void parse_fib(const uint8_t *fib_data, fib_t& fib);
+
+struct trace_file_header_t {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint32_t num_sources;
+    uint32_t rfu;
+    uint64_t num_events;
+};
+
+struct trace_file_t {
+    std::vector<std::string> sources;
+    std::vector<event_t> events;
+};
+
+// Both throw a runtime_error if the file cannot be written or read
+void write_trace_file(const std::string& filename, const trace_file_t& trace);
+trace_file_t read_trace_file(const std::string& filename);
+
+// One line describing the event, without timestamp
+std::string describe_event(const event_t& event, const std::vector<std::string>& sources);
+
+} // namespace frametrace
@@ -36,6 +36,8 @@
 #include <limits>
 #include <boost/version.hpp>
 #include "ManagementServer.h"
+#include "FrameTiming.h"
+#include "FrameTrace.h"
 #include "Log.h"
 
 using namespace std;
@@ -109,6 +111,11 @@ PEAK_STATS_SHORT_WINDOW = std::chrono::milliseconds(500);
 static constexpr auto
 PEAK_STATS_KEEP_DURATION = std::chrono::minutes(5);
 
+/* The inputs notify about two samples per frame, the ring holds them for
+ * about 12 seconds. The collector thread takes them out every second. */
+static constexpr size_t
+INPUT_STAT_RING_SIZE = 1024;
+
 ManagementServer& get_mgmt_server()
 {
     static ManagementServer mgmt_server;
@@ -146,6 +153,29 @@ void ManagementServer::unregister_input(std::string id)
     }
 }
 
+void ManagementServer::register_frame_timing(FrameTiming* timing)
+{
+    unique_lock<mutex> lock(m_statsmutex);
+    m_frame_timing = timing;
+}
+
+void ManagementServer::unregister_frame_timing(FrameTiming* timing)
+{
+    unique_lock<mutex> lock(m_statsmutex);
+    if (m_frame_timing == timing) {
+        m_frame_timing = nullptr;
+    }
+}
+
+json::map_t ManagementServer::get_frame_timing_values() const
+{
+    unique_lock<mutex> lock(m_statsmutex);
+    if (m_frame_timing) {
+        return m_frame_timing->encode_json();
+    }
+    return {};
+}
+
 // outputs will never disappear, no need to have a "remove" logic
 void ManagementServer::update_edi_tcp_output_stat(
         uint16_t listen_port,
@@ -154,6 +184,30 @@ void ManagementServer::update_edi_tcp_output_stat(
     unique_lock<mutex> lock(m_statsmutex);
 
     m_output_stats[listen_port] = stats;
+
+    auto metric = m_edi_tcp_metrics.find(listen_port);
+    if (metric == m_edi_tcp_metrics.end()) {
+        auto& r = metrics::registry();
+        const metrics::labels_t labels = {{"port", to_string(listen_port)}};
+        edi_tcp_metrics_t m;
+        m.num_connections = &r.gauge("odr_dabmux_edi_tcp_connections",
+                "Number of clients connected to the EDI/TCP output", labels);
+        m.max_buffer_fullness = &r.gauge("odr_dabmux_edi_tcp_max_buffer_fullness_bytes",
+                "Bytes waiting to be sent to the slowest EDI/TCP client", labels);
+        m.max_queued_buffers = &r.gauge("odr_dabmux_edi_tcp_max_queued_buffers",
+                "Packets waiting to be sent to the slowest EDI/TCP client", labels);
+        metric = m_edi_tcp_metrics.emplace(listen_port, m).first;
+    }
+
+    size_t max_buffer_fullness = 0;
+    size_t max_queued_buffers = 0;
+    for (const auto& s : stats) {
+        max_buffer_fullness = std::max(max_buffer_fullness, s.buffer_fullness);
+        max_queued_buffers = std::max(max_queued_buffers, s.queued_buffers);
+    }
+    metric->second.num_connections->set(stats.size());
+    metric->second.max_buffer_fullness->set(max_buffer_fullness);
+    metric->second.max_queued_buffers->set(max_queued_buffers);
 }
 
 bool ManagementServer::isInputRegistered(std::string& id)
@@ -169,8 +223,16 @@ bool ManagementServer::isInputRegistered(std::string& id)
     return true;
 }
 
-std::string ManagementServer::get_json_stats_for_http(std::optional<int64_t> clocktai_expires_at) const
+json::map_t ManagementServer::get_stats_for_http() const
 {
+    std::shared_ptr<const fig_counters_t> figs_missed_deadline;
+    std::optional<int64_t> clocktai_expires_at;
+    {
+        unique_lock<mutex> lock(m_snapshot_mutex);
+        figs_missed_deadline = m_figs_missed_deadline_snapshot;
+        clocktai_expires_at = m_clocktai_expires_at;
+    }
+
     json::map_t j;
 
     j["version"] = VERSION;
@@ -179,7 +241,7 @@ std::string ManagementServer::get_json_stats_for_http(std::optional<int64_t> clo
     using namespace chrono;
     j["process_startup_time"] = duration_cast<seconds>(m_startup_time_sys.time_since_epoch()).count();
     j["process_uptime"] = duration_cast<seconds>(steady_clock::now() - m_startup_time).count();
-    j["num_frames"] = m_frames;
+    j["num_frames"] = m_frames.load();
 
     if (clocktai_expires_at) {
         j["clock_tai_expiry"] = *clocktai_expires_at;
@@ -195,13 +257,30 @@ std::string ManagementServer::get_json_stats_for_http(std::optional<int64_t> clo
 
     json::map_t fic;
     json::map_t counter_per_fig;
-    for (const auto& fig_counter : m_figs_missed_deadline_counters) {
-        counter_per_fig[fig_counter.first] = fig_counter.second;
+    if (figs_missed_deadline) {
+        for (const auto& fig_counter : *figs_missed_deadline) {
+            counter_per_fig[fig_counter.first] = fig_counter.second;
+        }
     }
     fic["num_fig_deadlines_missed"] = counter_per_fig;
+    fic["num_bytes_capacity"] = m_fic_bytes_capacity.load();
+    fic["num_bytes_used"] = m_fic_bytes_used.load();
     j["fic"] = fic;
 
-    return json::map_to_json(j);
+    j["frame_timing"] = get_frame_timing_values();
+
+    const auto log_stats = etiLog.get_stats();
+    json::map_t log;
+    log["num_dropped"] = log_stats.num_dropped;
+    log["num_suppressed"] = log_stats.num_suppressed;
+    j["log"] = log;
+
+    return j;
+}
+
+std::string ManagementServer::get_json_stats_for_http() const
+{
+    return json::map_to_json(get_stats_for_http());
 }
 
 void ManagementServer::set_startup_time()
@@ -210,14 +289,59 @@ void ManagementServer::set_startup_time()
     m_startup_time_sys = std::chrono::system_clock::now();
 }
 
-void ManagementServer::set_num_frames(size_t frames)
+void ManagementServer::publish_statistics(size_t num_frames)
 {
-    m_frames = frames;
+    m_frames = num_frames;
+
+    const auto log_stats = etiLog.get_stats();
+    m_metric_log_dropped.inc(log_stats.num_dropped - m_log_stats_published.num_dropped);
+    m_metric_log_suppressed.inc(log_stats.num_suppressed - m_log_stats_published.num_suppressed);
+    m_log_stats_published = log_stats;
+
+    if (m_figs_missed_deadline_changed) {
+        auto snapshot = make_shared<const fig_counters_t>(m_figs_missed_deadline_counters);
+        m_figs_missed_deadline_changed = false;
+
+        unique_lock<mutex> lock(m_snapshot_mutex);
+        m_figs_missed_deadline_snapshot = std::move(snapshot);
+    }
+}
+
+void ManagementServer::set_clocktai_expiry(std::optional<int64_t> expires_at)
+{
+    unique_lock<mutex> lock(m_snapshot_mutex);
+    m_clocktai_expires_at = expires_at;
 }
 
 void ManagementServer::fig_deadline_missed(const std::string& fig_type_ext)
 {
     m_figs_missed_deadline_counters[fig_type_ext]++;
+    m_figs_missed_deadline_changed = true;
+
+    auto& metric = m_figs_missed_deadline_metrics[fig_type_ext];
+    if (metric == nullptr) {
+        metric = &metrics::registry().counter("odr_dabmux_fig_deadlines_missed",
+                "Number of times a FIG could not be sent at its repetition rate",
+                {{"fig", fig_type_ext}});
+    }
+    metric->inc();
+}
+
+void ManagementServer::fic_frame_filled(size_t capacity, size_t used)
+{
+    m_fic_bytes_capacity += capacity;
+    m_fic_bytes_used += used;
+    m_metric_fic_bytes_capacity.inc(capacity);
+    m_metric_fic_bytes_used.inc(used);
+}
+
+void ManagementServer::collect_input_statistics()
+{
+    unique_lock<mutex> lock(m_statsmutex);
+
+    for (auto& stat : m_input_stats) {
+        stat.second->collect();
+    }
 }
 
 json::map_t ManagementServer::get_input_config_json()
@@ -282,11 +406,32 @@ ManagementServer::ManagementServer() :
     m_zmq_context(),
     m_zmq_sock(m_zmq_context, ZMQ_REP),
     m_running(false),
-    m_fault(false)
+    m_fault(false),
+    m_metric_fic_bytes_capacity(metrics::registry().counter(
+                "odr_dabmux_fic_capacity_bytes",
+                "Space available to FIGs in the FIBs")),
+    m_metric_fic_bytes_used(metrics::registry().counter(
+                "odr_dabmux_fic_used_bytes",
+                "Space used by FIGs in the FIBs")),
+    m_metric_log_dropped(metrics::registry().counter(
+                "odr_dabmux_log_messages_dropped",
+                "Log messages lost because logging could not keep up")),
+    m_metric_log_suppressed(metrics::registry().counter(
+                "odr_dabmux_log_messages_suppressed",
+                "Log messages discarded by the rate limit"))
 { }
 
 ManagementServer::~ManagementServer()
 {
+    {
+        unique_lock<mutex> lock(m_collector_mutex);
+        m_collector_running = false;
+    }
+    m_collector_cv.notify_all();
+    if (m_collector_thread.joinable()) {
+        m_collector_thread.join();
+    }
+
     m_running = false;
     if (m_thread.joinable()) {
         m_thread.join();
@@ -296,12 +441,31 @@ ManagementServer::~ManagementServer()
 
 void ManagementServer::open(int listenport)
 {
+    {
+        unique_lock<mutex> lock(m_collector_mutex);
+        m_collector_running = true;
+    }
+    m_collector_thread = std::thread(&ManagementServer::collectorThread, this);
+
     m_listenport = listenport;
     if (m_listenport > 0) {
         m_thread = std::thread(&ManagementServer::serverThread, this);
     }
 }
 
+void ManagementServer::collectorThread()
+{
+    unique_lock<mutex> lock(m_collector_mutex);
+    while (m_collector_running) {
+        lock.unlock();
+        collect_input_statistics();
+        lock.lock();
+
+        m_collector_cv.wait_for(lock, std::chrono::seconds(1),
+                [&]() { return not m_collector_running; });
+    }
+}
+
 void ManagementServer::restart()
 {
     m_restarter_thread = thread(&ManagementServer::restart_thread, this);
@@ -394,9 +558,22 @@ void ManagementServer::handle_message(zmq::message_t& zmq_message)
             root["output_values"] = ov.values;
             answer << json::map_to_json(root);
         }
+        else if (data == "timing") {
+            json::map_t root;
+            root["frame_timing"] = get_frame_timing_values();
+            answer << json::map_to_json(root);
+        }
+        else if (data == "metrics") {
+            answer << metrics::registry().render();
+        }
         else if (data == "getptree") {
-            unique_lock<mutex> lock(m_configmutex);
-            boost::property_tree::json_parser::write_json(answer, m_pt);
+            std::shared_ptr<const boost::property_tree::ptree> pt;
+            {
+                unique_lock<mutex> lock(m_configmutex);
+                pt = m_pt;
+            }
+            boost::property_tree::json_parser::write_json(answer,
+                    pt ? *pt : boost::property_tree::ptree());
         }
         else {
             etiLog.level(warn) << "ManagementServer: Invalid request '" << data << "'";
@@ -414,18 +591,41 @@ void ManagementServer::handle_message(zmq::message_t& zmq_message)
     }
 }
 
-void ManagementServer::update_ptree(const boost::property_tree::ptree& pt)
+void ManagementServer::update_ptree(const boost::property_tree::ptree& pt, uint64_t version)
 {
-    if (m_running) {
+    {
         unique_lock<mutex> lock(m_configmutex);
-        m_pt = pt;
+        if (m_pt and m_pt_version == version) {
+            return;
+        }
     }
+
+    // Copy outside of the lock, so that the server thread never waits for it
+    auto new_pt = make_shared<const boost::property_tree::ptree>(pt);
+
+    unique_lock<mutex> lock(m_configmutex);
+    m_pt = std::move(new_pt);
+    m_pt_version = version;
 }
 
 /************************************************/
 
 InputStat::InputStat(const std::string& name) :
     m_name(name),
+    m_ring(INPUT_STAT_RING_SIZE),
+    m_metric_buffer_fill(metrics::registry().gauge(
+                "odr_dabmux_input_buffer_fill_bytes",
+                "Bytes in the buffer of the input", {{"input", name}})),
+    m_metric_tist_offset(metrics::registry().gauge(
+                "odr_dabmux_input_tist_offset_seconds",
+                "Last measured offset of the input timestamps", {{"input", name}})),
+    m_metric_underruns(metrics::registry().counter(
+                "odr_dabmux_input_underruns",
+                "Number of buffer underruns of the input", {{"input", name}})),
+    m_metric_overruns(metrics::registry().counter(
+                "odr_dabmux_input_overruns",
+                "Number of buffer overruns of the input", {{"input", name}})),
+    m_trace_source(get_frame_trace().register_source(name)),
     m_time_last_event(std::chrono::steady_clock::now())
 {
 }
@@ -440,59 +640,74 @@ void InputStat::registerAtServer()
     get_mgmt_server().register_input(this);
 }
 
-void InputStat::notifyBuffer(uint64_t bufsize)
+void InputStat::push_sample(const sample_t& sample)
 {
-    unique_lock<mutex> lock(m_mutex);
+    auto& slot = m_ring[m_producer_seq % m_ring.size()];
 
-    using namespace std::chrono;
-    const auto time_now = steady_clock::now();
-    m_buffer_fill_stats.push_front({time_now, bufsize});
+    // Mark the slot as being written before touching the sample
+    slot.seq.store(2 * m_producer_seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot.sample = sample;
+
+    slot.seq.store(2 * m_producer_seq + 2, memory_order_release);
 
-    prune_statistics(time_now);
+    m_producer_seq++;
+    m_write_seq.store(m_producer_seq, memory_order_release);
 }
 
-void InputStat::notifyTimestampOffset(double offset)
+void InputStat::notifyBuffer(uint64_t bufsize)
 {
-    unique_lock<mutex> lock(m_mutex);
+    sample_t sample = {};
+    sample.type = sample_type_t::BufferFill;
+    sample.timestamp = std::chrono::steady_clock::now();
+    sample.bufsize = bufsize;
+    push_sample(sample);
 
-    m_last_tist_offset = offset;
+    m_metric_buffer_fill.set(bufsize);
 }
 
-void InputStat::notifyPeakLevels(int peak_left, int peak_right)
+void InputStat::notifyTimestampOffset(double offset)
 {
-    unique_lock<mutex> lock(m_mutex);
+    m_last_tist_offset.store(offset, memory_order_relaxed);
+    m_metric_tist_offset.set(offset);
+}
 
+void InputStat::notifyPeakLevels(int peak_left, int peak_right)
+{
     using namespace std::chrono;
     const auto time_now = steady_clock::now();
-    m_peak_stats.push_front({time_now, peak_left, peak_right});
 
-    prune_statistics(time_now);
+    sample_t sample = {};
+    sample.type = sample_type_t::PeakLevels;
+    sample.timestamp = time_now;
+    sample.peak_left = peak_left;
+    sample.peak_right = peak_right;
+    push_sample(sample);
+
+    // The silence counter is only updated once there are two peak levels
+    // in the statistics.
+    const bool have_previous_peak = m_last_peak_time.has_value() and
+        *m_last_peak_time + PEAK_STATS_KEEP_DURATION >= time_now;
+    m_last_peak_time = time_now;
+
+    m_recent_peaks.push_front({time_now, peak_left, peak_right});
+    while (m_recent_peaks.back().timestamp + PEAK_STATS_SHORT_WINDOW < time_now) {
+        m_recent_peaks.pop_back();
+    }
 
-    if (m_peak_stats.size() >= 2) {
+    if (have_previous_peak) {
         // Calculate the peak over the short window
-        vector<peak_stat_t> short_peaks;
-        copy_if(m_peak_stats.begin(), m_peak_stats.end(),
-                back_inserter(short_peaks),
-                [&](const peak_stat_t& ps) {
-                    return ps.timestamp + PEAK_STATS_SHORT_WINDOW >= time_now;
-                });
-
-        const auto& short_left_peak_max = max_element(
-                short_peaks.begin(), short_peaks.end(),
-                [](const peak_stat_t& lhs, const peak_stat_t& rhs) {
-                    return lhs.peak_left < rhs.peak_left;
-                });
-
-        const auto& short_right_peak_max = max_element(
-                short_peaks.begin(), short_peaks.end(),
-                [](const peak_stat_t& lhs, const peak_stat_t& rhs) {
-                    return lhs.peak_right < rhs.peak_right;
-                });
+        int short_left_peak_max = 0;
+        int short_right_peak_max = 0;
+        for (const auto& ps : m_recent_peaks) {
+            short_left_peak_max = max(short_left_peak_max, ps.peak_left);
+            short_right_peak_max = max(short_right_peak_max, ps.peak_right);
+        }
 
         // Using the lower of the two channels allows us to detect if only one
         // channel is silent.
-        const int lower_peak = min(
-                short_left_peak_max->peak_left, short_right_peak_max->peak_right);
+        const int lower_peak = min(short_left_peak_max, short_right_peak_max);
 
         // State
         const int16_t int16_max = std::numeric_limits<int16_t>::max();
@@ -500,58 +715,92 @@ void InputStat::notifyPeakLevels(int peak_left, int peak_right)
             round(20*log10((double)lower_peak / int16_max)) :
             -90;
 
+        // Only this thread writes the counter
+        int silence_counter = m_silence_counter.load(memory_order_relaxed);
         if (peak_dB < INPUT_AUDIO_LEVEL_THRESHOLD) {
-            if (m_silence_counter < INPUT_AUDIO_LEVEL_COUNT_SATURATION) {
-                m_silence_counter++;
+            if (silence_counter < INPUT_AUDIO_LEVEL_COUNT_SATURATION) {
+                silence_counter++;
             }
         }
         else {
-            if (m_silence_counter > 0) {
-                m_silence_counter--;
+            if (silence_counter > 0) {
+                silence_counter--;
             }
         }
+        m_silence_counter.store(silence_counter, memory_order_relaxed);
     }
 }
 
-void InputStat::notifyUnderrun()
+bool InputStat::glitch_detected(const timepoint_t& time_now)
 {
-    unique_lock<mutex> lock(m_mutex);
+    int glitch_counter = m_glitch_counter.load(memory_order_relaxed);
 
+    /* if the last event was more that INPUT_COUNTER_RESET_TIME
+     * ago, the timeout has expired. We can reset our
+     * glitch counter.
+     */
+    if (time_now - m_time_last_event.load(memory_order_relaxed) > INPUT_COUNTER_RESET_TIME) {
+        glitch_counter = 0;
+    }
+
+    m_time_last_event.store(time_now, memory_order_relaxed);
+
+    if (glitch_counter < INPUT_UNSTABLE_THRESHOLD) {
+        m_glitch_counter.store(glitch_counter + 1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void InputStat::notifyUnderrun()
+{
     // Statistics
-    m_num_underruns++;
+    m_num_underruns.fetch_add(1, memory_order_relaxed);
+    m_metric_underruns.inc();
+    get_frame_trace().record(frametrace::event_type_t::InputUnderrun, m_trace_source);
 
     // State
-    m_time_last_event = std::chrono::steady_clock::now();
-    if (m_glitch_counter < INPUT_UNSTABLE_THRESHOLD) {
-        m_glitch_counter++;
-    }
-    else {
+    const auto time_now = std::chrono::steady_clock::now();
+    if (glitch_detected(time_now)) {
         // As we don't receive level notifications anymore, clear the
         // audio level information
-        m_peak_stats.clear();
+        sample_t sample = {};
+        sample.type = sample_type_t::PeakReset;
+        sample.timestamp = time_now;
+        push_sample(sample);
+
+        m_recent_peaks.clear();
+        m_last_peak_time.reset();
     }
 }
 
 void InputStat::notifyOverrun()
 {
-    unique_lock<mutex> lock(m_mutex);
-
     // Statistics
-    m_num_overruns++;
+    m_num_overruns.fetch_add(1, memory_order_relaxed);
+    m_metric_overruns.inc();
+    get_frame_trace().record(frametrace::event_type_t::InputOverrun, m_trace_source);
 
     // State
-    m_time_last_event = std::chrono::steady_clock::now();
-    if (m_glitch_counter < INPUT_UNSTABLE_THRESHOLD) {
-        m_glitch_counter++;
-    }
+    glitch_detected(std::chrono::steady_clock::now());
 }
 
 void InputStat::notifyVersion(const std::string& version, uint32_t uptime_s)
 {
-    unique_lock<mutex> lock(m_mutex);
+    m_uptime_s.store(uptime_s, memory_order_relaxed);
 
-    m_version = version;
-    m_uptime_s = uptime_s;
+    if (version != m_producer_version) {
+        m_producer_version = version;
+
+        unique_lock<mutex> lock(m_version_mutex);
+        m_version = version;
+    }
+}
+
+void InputStat::collect()
+{
+    unique_lock<mutex> lock(m_mutex);
+    update_statistics(std::chrono::steady_clock::now());
 }
 
 json::map_t InputStat::encodeValues()
@@ -560,6 +809,9 @@ json::map_t InputStat::encodeValues()
 
     unique_lock<mutex> lock(m_mutex);
 
+    const auto time_now = std::chrono::steady_clock::now();
+    update_statistics(time_now);
+
     int peak_left_short = 0;
     int peak_right_short = 0;
     int peak_left = 0;
@@ -615,7 +867,11 @@ json::map_t InputStat::encodeValues()
         return dB;
     };
 
-    auto version = m_version;
+    string version;
+    {
+        unique_lock<mutex> version_lock(m_version_mutex);
+        version = m_version;
+    }
     size_t pos = 0;
     while ((pos = version.find("\"", pos)) != std::string::npos) {
          version.replace(pos, 1, "\\\"");
@@ -629,15 +885,14 @@ json::map_t InputStat::encodeValues()
     inputstat["peak_right"] = to_dB(peak_right_short);
     inputstat["peak_left_slow"] = to_dB(peak_left);
     inputstat["peak_right_slow"] = to_dB(peak_right);
-    inputstat["num_underruns"] = m_num_underruns;
-    inputstat["num_overruns"] = m_num_overruns;
-    inputstat["last_tist_offset"] = m_last_tist_offset;
+    inputstat["num_underruns"] = m_num_underruns.load(memory_order_relaxed);
+    inputstat["num_overruns"] = m_num_overruns.load(memory_order_relaxed);
+    inputstat["last_tist_offset"] = m_last_tist_offset.load(memory_order_relaxed);
     inputstat["version"] = version;
-    inputstat["uptime"] = m_uptime_s;
+    inputstat["uptime"] = m_uptime_s.load(memory_order_relaxed);
     inputstat["state"] = "";
 
-    string state;
-    switch (determineState()) {
+    switch (compute_state(time_now)) {
         case input_state_t::NoData:
             inputstat["state"] = "NoData (1)";
             break;
@@ -659,18 +914,24 @@ json::map_t InputStat::encodeValues()
 
 input_state_t InputStat::determineState()
 {
-    const auto now = std::chrono::steady_clock::now();
-    prune_statistics(now);
+    unique_lock<mutex> lock(m_mutex);
+
+    const auto time_now = std::chrono::steady_clock::now();
+    update_statistics(time_now);
+    return compute_state(time_now);
+}
 
+input_state_t InputStat::compute_state(const timepoint_t& time_now) const
+{
     input_state_t state;
 
-    /* if the last event was more that INPUT_COUNTER_RESET_TIME
-     * ago, the timeout has expired. We can reset our
-     * glitch counter.
-     */
-    if (now - m_time_last_event > INPUT_COUNTER_RESET_TIME) {
-        m_glitch_counter = 0;
-    }
+    /* The glitch counter is reset with the next glitch once
+     * INPUT_COUNTER_RESET_TIME has expired, until then it
+     * counts as zero. */
+    const bool glitch_timeout_expired =
+        time_now - m_time_last_event.load(memory_order_relaxed) > INPUT_COUNTER_RESET_TIME;
+    const int glitch_counter = glitch_timeout_expired ?
+        0 : m_glitch_counter.load(memory_order_relaxed);
 
     // STATE CALCULATION
 
@@ -681,13 +942,13 @@ input_state_t InputStat::determineState()
         state = input_state_t::NoData;
     }
     /* Otherwise, the state depends on the glitch counter */
-    else if (m_glitch_counter >= INPUT_UNSTABLE_THRESHOLD) {
+    else if (glitch_counter >= INPUT_UNSTABLE_THRESHOLD) {
         state = input_state_t::Unstable;
     }
     else {
         /* The input is streaming, check if the audio level is too low */
 
-        if (m_silence_counter > INPUT_AUDIO_LEVEL_SILENCE_COUNT) {
+        if (m_silence_counter.load(memory_order_relaxed) > INPUT_AUDIO_LEVEL_SILENCE_COUNT) {
             state = input_state_t::Silence;
         }
         else {
@@ -698,24 +959,56 @@ input_state_t InputStat::determineState()
     return state;
 }
 
-void InputStat::prune_statistics(const std::chrono::time_point<std::chrono::steady_clock>& time_now)
+void InputStat::update_statistics(const timepoint_t& time_now)
 {
+    const uint64_t write_seq = m_write_seq.load(memory_order_acquire);
+
+    // The samples the input has already overwritten are lost
+    if (write_seq - m_read_seq > m_ring.size()) {
+        m_read_seq = write_seq - m_ring.size();
+    }
+
+    for (; m_read_seq < write_seq; m_read_seq++) {
+        const auto& slot = m_ring[m_read_seq % m_ring.size()];
+        const uint64_t complete_seq = 2 * m_read_seq + 2;
+
+        if (slot.seq.load(memory_order_acquire) != complete_seq) {
+            continue;
+        }
+        const sample_t sample = slot.sample;
+        atomic_thread_fence(memory_order_acquire);
+        if (slot.seq.load(memory_order_relaxed) != complete_seq) {
+            continue;
+        }
+
+        switch (sample.type) {
+            case sample_type_t::BufferFill:
+                m_buffer_fill_stats.push_front({sample.timestamp, sample.bufsize});
+                break;
+            case sample_type_t::PeakLevels:
+                m_peak_stats.push_front(
+                        {sample.timestamp, sample.peak_left, sample.peak_right});
+                break;
+            case sample_type_t::PeakReset:
+                m_peak_stats.clear();
+                break;
+        }
+    }
+
+    // The samples are in chronological order, the expired ones are
+    // at the back.
+
     // Keep only stats whose timestamp are more recent than
     // BUFFER_STATS_KEEP_DURATION ago
-    m_buffer_fill_stats.erase(remove_if(
-                m_buffer_fill_stats.begin(), m_buffer_fill_stats.end(),
-                [&](const fill_stat_t& fs) {
-                    return fs.timestamp + BUFFER_STATS_KEEP_DURATION < time_now;
-                }),
-                m_buffer_fill_stats.end());
+    while (not m_buffer_fill_stats.empty() and
+            m_buffer_fill_stats.back().timestamp + BUFFER_STATS_KEEP_DURATION < time_now) {
+        m_buffer_fill_stats.pop_back();
+    }
 
     // Keep only stats whose timestamp are more recent than
-    // BUFFER_STATS_KEEP_DURATION ago
-    m_peak_stats.erase(remove_if(
-                m_peak_stats.begin(), m_peak_stats.end(),
-                [&](const peak_stat_t& ps) {
-                    return ps.timestamp + PEAK_STATS_KEEP_DURATION < time_now;
-                }),
-                m_peak_stats.end());
+    // PEAK_STATS_KEEP_DURATION ago
+    while (not m_peak_stats.empty() and
+            m_peak_stats.back().timestamp + PEAK_STATS_KEEP_DURATION < time_now) {
+        m_peak_stats.pop_back();
+    }
 }
-
@@ -25,6 +25,14 @@
       Returns the internal boost property_tree that contains the
       multiplexer configuration DB.
 
+    - timing
+      Returns the percentiles of the time the multiplexer spends in
+      each stage of the creation of an ETI frame.
+
+    - metrics
+      Returns all metrics in the OpenMetrics text format, like the
+      /metrics endpoint of the web server.
+
    The server is using REQ/REP ZeroMQ sockets.
    */
 /*
@@ -47,6 +55,8 @@
 #pragma once
 
 #include "Json.h"
+#include "Log.h"
+#include "Metrics.h"
 #ifdef HAVE_CONFIG_H
 #   include "config.h"
 #endif
@@ -55,10 +65,14 @@
 #include "Socket.h"
 #include <string>
 #include <map>
+#include <memory>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <deque>
+#include <optional>
 #include <thread>
+#include <vector>
 #include <mutex>
 
 // Suppress an deprecation warning from boost
@@ -67,6 +81,8 @@
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
 
+class FrameTiming;
+
 /*** State handing ***/
 /* An input can be in one of the following three states:
  */
@@ -87,6 +103,14 @@ enum class input_state_t
 /* InputStat takes care of
  * - saving the statistics for graphing
  * - calculating the state of the input for monitoring
+ *
+ * The notify functions are called by the multiplexer for every frame, and
+ * never wait for the readers. The samples go to a ring, from which
+ * encodeValues() and determineState() collect them later, under a lock only
+ * the readers take. Counters and the state variables the input updates
+ * itself are atomics.
+ *
+ * There must be only one thread calling the notify functions.
  */
 class InputStat
 {
@@ -110,51 +134,117 @@ class InputStat
         json::map_t encodeValues();
         input_state_t determineState();
 
+        /* Move the samples from the ring to the statistics, so that
+         * they don't get overwritten before a slow reader asks for them */
+        void collect();
+
     private:
         std::string m_name;
 
-        // Remove all expired fill and peak stats
-        void prune_statistics(const std::chrono::time_point<std::chrono::steady_clock>& timestamp);
+        using timepoint_t = std::chrono::time_point<std::chrono::steady_clock>;
 
-        /************ STATISTICS ***********/
-        // Keep track of buffer fill with timestamps, so that we
-        // can calculate the correct state from it.
-        struct fill_stat_t {
-            std::chrono::time_point<std::chrono::steady_clock> timestamp;
+        /************ SAMPLE RING ***********/
+        enum class sample_type_t : uint8_t {
+            BufferFill,
+            PeakLevels,
+            // The input lost its audio, forget the previous peak levels
+            PeakReset,
+        };
+
+        struct sample_t {
+            sample_type_t type;
+            timepoint_t timestamp;
             uint64_t bufsize;
+            int peak_left;
+            int peak_right;
         };
-        std::deque<fill_stat_t> m_buffer_fill_stats;
 
-        // counter of number of overruns and underruns since startup
-        uint32_t m_num_underruns = 0;
-        uint32_t m_num_overruns = 0;
+        /* Sample number seq goes to slot seq % m_ring.size(). While it is
+         * being written, slot.seq is 2*seq+1, and 2*seq+2 once complete,
+         * like the slots of the shm output. */
+        struct slot_t {
+            std::atomic<uint64_t> seq = 0;
+            sample_t sample;
+        };
 
-        // last measured timestamp offset
-        double m_last_tist_offset = 0;
+        std::vector<slot_t> m_ring;
 
-        // Peak audio levels (linear 16-bit PCM) for the two channels.
-        // Keep a FIFO of values from the last minutes, apply
-        // a short window to also see short-term fluctuations.
+        // Number of samples written so far
+        std::atomic<uint64_t> m_write_seq = 0;
+
+        void push_sample(const sample_t& sample);
+
+        /************ INPUT SIDE ***********/
+        /* Only used by the thread calling the notify functions */
+        uint64_t m_producer_seq = 0;
+        std::string m_producer_version;
+
+        // Peak levels of the short window, to update the silence counter
         struct peak_stat_t {
-            std::chrono::time_point<std::chrono::steady_clock> timestamp;
+            timepoint_t timestamp;
             int peak_left;
             int peak_right;
         };
-        std::deque<peak_stat_t> m_peak_stats;
+        std::deque<peak_stat_t> m_recent_peaks;
+        std::optional<timepoint_t> m_last_peak_time;
 
-        size_t m_short_window_length = 0;
+        // Update the glitch counter, returns true if it was already saturated
+        bool glitch_detected(const timepoint_t& time_now);
+
+        // counter of number of overruns and underruns since startup
+        std::atomic<uint32_t> m_num_underruns = 0;
+        std::atomic<uint32_t> m_num_overruns = 0;
+
+        // last measured timestamp offset
+        std::atomic<double> m_last_tist_offset = 0;
+
+        std::atomic<uint32_t> m_uptime_s = 0;
+
+        // The same values, exported to the metrics registry
+        metrics::Gauge& m_metric_buffer_fill;
+        metrics::Gauge& m_metric_tist_offset;
+        metrics::Counter& m_metric_underruns;
+        metrics::Counter& m_metric_overruns;
 
+        // Identifies the input in the frame trace, see FrameTrace.h
+        uint16_t m_trace_source;
+
+        // Changes rarely, the input takes the lock only when it does
+        std::mutex m_version_mutex;
         std::string m_version;
-        uint32_t m_uptime_s = 0;
 
         /************* STATE ***************/
         /* Variables used for determining the input state */
-        int m_glitch_counter = 0; // saturating counter
-        int m_silence_counter = 0; // saturating counter
-        std::chrono::time_point<std::chrono::steady_clock> m_time_last_event;
+        std::atomic<int> m_glitch_counter = 0; // saturating counter
+        std::atomic<int> m_silence_counter = 0; // saturating counter
+        std::atomic<timepoint_t> m_time_last_event;
 
-        // The mutex that has to be held during all notify and readout
+        /************ READER SIDE ***********/
+        /* Everything below is protected by m_mutex */
         mutable std::mutex m_mutex;
+
+        // Next sample to take from the ring
+        uint64_t m_read_seq = 0;
+
+        // Collect the samples and remove the expired ones
+        void update_statistics(const timepoint_t& time_now);
+
+        input_state_t compute_state(const timepoint_t& time_now) const;
+
+        // Keep track of buffer fill with timestamps, so that we
+        // can calculate the correct state from it.
+        struct fill_stat_t {
+            timepoint_t timestamp;
+            uint64_t bufsize;
+        };
+        std::deque<fill_stat_t> m_buffer_fill_stats;
+
+        // Peak audio levels (linear 16-bit PCM) for the two channels.
+        // Keep a FIFO of values from the last minutes, apply
+        // a short window to also see short-term fluctuations.
+        std::deque<peak_stat_t> m_peak_stats;
+
+        size_t m_short_window_length = 0;
 };
 
 class ManagementServer
@@ -171,6 +261,9 @@ class ManagementServer
         void register_input(InputStat* is);
         void unregister_input(std::string id);
 
+        void register_frame_timing(FrameTiming* timing);
+        void unregister_frame_timing(FrameTiming* timing);
+
         void update_edi_tcp_output_stat(
                 uint16_t listen_port,
                 const std::vector<Socket::TCPConnection::stats_t>& stats);
@@ -181,21 +274,34 @@ class ManagementServer
          */
         bool retrieve_new_ptree(boost::property_tree::ptree& pt);
 
-        /* Update the copy of the configuration property tree and notify the
-         * update to the internal server thread.
+        /* Update the copy of the configuration property tree served by the
+         * internal server thread. The tree is only copied if version differs
+         * from the one of the current copy.
          */
-        void update_ptree(const boost::property_tree::ptree& pt);
+        void update_ptree(const boost::property_tree::ptree& pt, uint64_t version);
 
         bool fault_detected() const { return m_fault; }
         void restart();
 
-        std::string get_json_stats_for_http(std::optional<int64_t> clocktai_expires_at) const;
+        /* Get the statistics, as served on /stats.json. Can be called from
+         * any thread, and only reads the values the multiplexer published. */
+        json::map_t get_stats_for_http() const;
+        std::string get_json_stats_for_http() const;
 
         void set_startup_time();
-        void set_num_frames(size_t frames);
+
+        /* Called by the main loop every few frames: update the frame
+         * counter, and publish a copy of the FIG counters if they changed. */
+        void publish_statistics(size_t num_frames);
+
+        void set_clocktai_expiry(std::optional<int64_t> expires_at);
 
         void fig_deadline_missed(const std::string& fig_type_ext);
 
+        /* Account for the FIBs of one frame: the space available to FIGs,
+         * and how much of it they used. */
+        void fic_frame_filled(size_t capacity, size_t used);
+
 
     private:
         void restart_thread();
@@ -209,6 +315,12 @@ class ManagementServer
 
         bool isInputRegistered(std::string& id);
 
+        // Take the samples of all inputs out of their rings
+        void collect_input_statistics();
+
+        // Collects every second, whether the management server runs or not
+        void collectorThread();
+
         int m_listenport = 0;
 
         // serverThread runs in a separate thread
@@ -217,19 +329,55 @@ class ManagementServer
         std::thread m_thread;
         std::thread m_restarter_thread;
 
+        std::mutex m_collector_mutex;
+        std::condition_variable m_collector_cv;
+        bool m_collector_running = false;
+        std::thread m_collector_thread;
+
         /******* Statistics Data ********/
         std::chrono::steady_clock::time_point m_startup_time;
         std::chrono::system_clock::time_point m_startup_time_sys;
-        size_t m_frames = 0;
+        std::atomic<size_t> m_frames = 0;
 
         std::map<std::string, InputStat*> m_input_stats;
 
+        FrameTiming* m_frame_timing = nullptr;
+
         // Holds information about EDI/TCP outputs
         std::map<uint16_t /* port */,
             std::vector<Socket::TCPConnection::stats_t>> m_output_stats;
 
-        // Counters for FIGs for which rate could not be respected
-        std::unordered_map<std::string, size_t> m_figs_missed_deadline_counters;
+        // Counters for FIGs for which rate could not be respected,
+        // only used by the multiplexer thread
+        using fig_counters_t = std::unordered_map<std::string, size_t>;
+        fig_counters_t m_figs_missed_deadline_counters;
+        bool m_figs_missed_deadline_changed = false;
+        std::unordered_map<std::string, metrics::Counter*> m_figs_missed_deadline_metrics;
+
+        // Values published for the readers. The mutex is only held
+        // to exchange them, never while they get serialised.
+        mutable std::mutex m_snapshot_mutex;
+        std::shared_ptr<const fig_counters_t> m_figs_missed_deadline_snapshot;
+        std::optional<int64_t> m_clocktai_expires_at;
+
+        // FIB usage since startup, in bytes
+        std::atomic<uint64_t> m_fic_bytes_capacity = 0;
+        std::atomic<uint64_t> m_fic_bytes_used = 0;
+        metrics::Counter& m_metric_fic_bytes_capacity;
+        metrics::Counter& m_metric_fic_bytes_used;
+
+        // Log messages lost since startup, as last added to the metrics
+        Logger::stats_t m_log_stats_published;
+        metrics::Counter& m_metric_log_dropped;
+        metrics::Counter& m_metric_log_suppressed;
+
+        // Metrics of the EDI/TCP outputs, per port. Protected by m_statsmutex
+        struct edi_tcp_metrics_t {
+            metrics::Gauge* num_connections;
+            metrics::Gauge* max_buffer_fullness;
+            metrics::Gauge* max_queued_buffers;
+        };
+        std::map<uint16_t, edi_tcp_metrics_t> m_edi_tcp_metrics;
 
         /* Return a description of the configuration that will
          * allow to define what graphs to be created
@@ -250,12 +398,18 @@ class ManagementServer
         };
         output_stats get_output_values() const;
 
+        // Percentiles of the frame timing histograms, see FrameTiming.h
+        json::map_t get_frame_timing_values() const;
+
         // mutex for accessing the map
         mutable std::mutex m_statsmutex;
 
         /******** Configuration Data *******/
+        // Copy of the configuration, replaced only when its version changes.
+        // The mutex is only held to exchange the pointer.
         std::mutex m_configmutex;
-        boost::property_tree::ptree m_pt;
+        std::shared_ptr<const boost::property_tree::ptree> m_pt;
+        uint64_t m_pt_version = 0;
 };
 
 // If necessary construct the management server singleton and return
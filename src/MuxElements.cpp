@@ -28,6 +28,7 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
+#include <atomic>
 
 #include "MuxElements.h"
 #include "lib/charset/charset.h"
@@ -49,6 +50,18 @@ static CharsetConverter charset_converter;
 
 using namespace std;
 
+static std::atomic<uint64_t> config_generation = ATOMIC_VAR_INIT(0);
+
+uint64_t ensemble_config_generation()
+{
+    return config_generation.load(std::memory_order_acquire);
+}
+
+void ensemble_config_changed()
+{
+    config_generation.fetch_add(1, std::memory_order_release);
+}
+
 std::string AnnouncementCluster::tostring() const
 {
     stringstream ss;
@@ -234,6 +247,7 @@ int DabLabel::setLabel(const std::string& label)
 
     m_fig1_flag = 0xFF00; // truncate the label to the eight first characters
 
+    ensemble_config_changed();
     return 0;
 }
 
@@ -288,6 +302,7 @@ int DabLabel::setLabel(const std::string& label, const std::string& short_label)
 
     // short label is valid.
     m_fig1_label = newlabel.m_fig1_label;
+    ensemble_config_changed();
     return 0;
 }
 
@@ -372,6 +387,7 @@ const string DabLabel::fig2_label() const
 int DabLabel::setFIG2Label(const std::string& label)
 {
     m_fig2_label = label;
+    ensemble_config_changed();
     return 0;
 }
 
@@ -379,12 +395,14 @@ void DabLabel::setFIG2CharacterField(uint16_t character_field)
 {
     m_fig2_use_text_control = false;
     m_fig2_character_field = character_field;
+    ensemble_config_changed();
 }
 
 void DabLabel::setFIG2TextControl(FIG2TextControl tc)
 {
     m_fig2_use_text_control = true;
     m_fig2_text_control = tc;
+    ensemble_config_changed();
 }
 
 void DabLabel::writeLabel(uint8_t* buf) const
@@ -632,6 +650,7 @@ void DabService::set_parameter(const string& parameter, const string& value)
 
         if (newpty >= 0 and newpty < (1<<5)) {
             pty_settings.pty = newpty;
+            ensemble_config_changed();
         }
         else {
             throw ParameterError("PTy value is out of bounds");
@@ -640,9 +659,11 @@ void DabService::set_parameter(const string& parameter, const string& value)
     else if (parameter == "ptysd") {
         if (value == "static") {
             pty_settings.dynamic_no_static = false;
+            ensemble_config_changed();
         }
         else if (value == "dynamic") {
             pty_settings.dynamic_no_static = true;
+            ensemble_config_changed();
         }
         else {
             throw ParameterError("Invalid value for ptysd, use static or dynamic");
@@ -707,6 +728,7 @@ void dabEnsemble::set_parameter(const string& parameter, const string& value)
 
             this->lto = new_lto;
         }
+        ensemble_config_changed();
     }
     else {
         stringstream ss;
@@ -823,6 +845,21 @@ void dabEnsemble::set_linking_config(
     m_frequency_information = new_frequency_information;
     m_linkagesets = new_linkage_sets;
     m_service_other_ensemble = new_services_other_ensemble;
+    ensemble_config_changed();
+}
+
+void DabSubchannel::select_protection_form()
+{
+    if (protection.form == UEP) {
+        protection.form = EEP;
+        for (int i = 0; i < 64; i++) {
+            if (bitrate == BitRateTable[i] &&
+                    protection.level == ProtectionLevelTable[i]) {
+                protection.form = UEP;
+                protection.uep.tableIndex = i;
+            }
+        }
+    }
 }
 
 unsigned short DabSubchannel::getSizeCu() const
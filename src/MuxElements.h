@@ -180,6 +180,12 @@ struct dabOutput {
 
 #define DABLABEL_LENGTH 16
 
+/* The FIG encoders cache the parts of the FIC that only depend on the
+ * configuration. Everything that modifies the configuration at runtime
+ * calls ensemble_config_changed(), which invalidates these caches. */
+uint64_t ensemble_config_generation();
+void ensemble_config_changed();
+
 struct FIG2TextControl {
     bool bidi_flag = false;
     bool base_direction_is_rtl = false;
@@ -477,6 +483,15 @@ public:
             uid(uid),
             protection() { }
 
+    /* Use EEP unless we find a UEP configuration
+     * UEP is only used for MPEG audio, but some bitrates don't
+     * have a UEP profile (EN 300 401 Clause 6.2.1).
+     * For these bitrates, we must switch to EEP.
+     *
+     * AAC audio and data is already EEP
+     */
+    void select_protection_form();
+
     // Calculate subchannel size in number of CU
     unsigned short getSizeCu() const;
 
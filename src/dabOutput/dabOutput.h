@@ -33,9 +33,12 @@
 #include "string.h"
 #include <stdexcept>
 #include <signal.h>
+#include <array>
 #include <vector>
 #include <chrono>
 #include <memory>
+#include <mutex>
+#include <cstdlib>
 
 #include <unistd.h>
 #include <sys/time.h>
@@ -46,6 +49,9 @@
 #  include "zmq.hpp"
 #endif
 #include "dabOutput/metadata.h"
+#include "dabOutput/shmEti.h"
+#include "Eti.h"
+#include "FrameClock.h"
 
 // Abstract base class for all outputs
 class DabOutput
@@ -65,15 +71,11 @@ class DabOutput
 
         virtual std::string get_info() const = 0;
 
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) = 0;
-};
-
-// ----- used in File and Fifo outputs
-enum EtiFileType {
-    ETI_FILE_TYPE_NONE = 0,
-    ETI_FILE_TYPE_RAW,
-    ETI_FILE_TYPE_STREAMED,
-    ETI_FILE_TYPE_FRAMED
+        /* Outputs that carry metadata next to the frames return true once
+         * they are open. They then receive the metadata of every frame
+         * through setMetadata(), just before the frame itself. */
+        virtual bool wantsMetadata() const { return false; }
+        virtual void setMetadata(const frame_metadata_t& md) {}
 };
 
 // ---------- File output ------------
@@ -86,6 +88,11 @@ class DabOutputFile : public DabOutput
             type_ = ETI_FILE_TYPE_FRAMED;
         }
 
+        DabOutputFile(const DabOutputFile& other) = delete;
+        DabOutputFile& operator=(const DabOutputFile& other) = delete;
+
+        virtual ~DabOutputFile();
+
         int Open(const char* filename);
         int Write(void* buffer, int size);
         int Close();
@@ -94,9 +101,11 @@ class DabOutputFile : public DabOutput
             return "file://" + filename_;
         }
 
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) {}
+        /* EDI time and DLFC are recorded in the index of segmented recordings */
+        virtual bool wantsMetadata() const { return segmentMinutes_ > 0; }
+        virtual void setMetadata(const frame_metadata_t& md) { md_ = md; }
     protected:
-        /* Set ETI type according to filename, and return
+        /* Set ETI type and write options according to filename, and return
          * filename without the &type=foo part
          */
         std::string SetEtiType(const std::string& filename);
@@ -105,6 +114,52 @@ class DabOutputFile : public DabOutput
         int file_;
         EtiFileType type_;
         unsigned long nbFrames_;
+
+        /* Write batching options, set with buffer=, direct= and sync= */
+        size_t bufferFrames_ = 1;  // Number of frames gathered per write
+        bool directIo_ = false;    // Open the file with O_DIRECT
+        size_t syncFrames_ = 0;    // Call fdatasync every syncFrames_ frames, 0 to disable
+        size_t segmentMinutes_ = 0; // Start a new file every segmentMinutes_, 0 to disable
+
+    private:
+        int OpenFile(const std::string& path);
+
+        // Open the recording segment and its index for the given time
+        int OpenSegment(std::chrono::system_clock::time_point now);
+        int WriteIndexEntry(const uint8_t* frame, int size,
+                std::chrono::system_clock::time_point now);
+
+        int WriteBuffered(const uint8_t* buffer, int size);
+
+        /* Write out the gathered frames. Unless final is set, O_DIRECT
+         * requires the unaligned tail to stay in the buffer.
+         * Returns -1 on failure */
+        int Flush(bool final);
+
+        // Update the nbFrames field at the start of a framed file
+        int WriteFrameCount();
+
+        struct AlignedFree { void operator()(uint8_t *p) const { free(p); } };
+        std::unique_ptr<uint8_t, AlignedFree> buffer_;
+        size_t bufferCapacity_ = 0;
+        size_t bufferFill_ = 0;
+        size_t bufferedFrames_ = 0;
+
+        // Number of bytes already written to the file
+        uint64_t fileOffset_ = 0;
+        size_t framesSinceSync_ = 0;
+
+        // O_DIRECT forbids the unaligned write of nbFrames, use a second descriptor
+        int headerFile_ = -1;
+
+        // Position of the next frame in the file, for the index
+        uint64_t recordOffset_ = 0;
+        std::chrono::system_clock::time_point segmentEnd_;
+
+        struct FileClose { void operator()(FILE *fd) const { fclose(fd); } };
+        std::unique_ptr<FILE, FileClose> index_;
+
+        frame_metadata_t md_;
 };
 
 // ---------- FIFO output ------------
@@ -134,12 +189,16 @@ class DabOutputRaw : public DabOutput
             return "raw://" + filename_;
         }
 
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) {}
 
     private:
         std::string filename_;
         int socket_ = -1;
         bool isCyclades_ = false;
+
+        // Bit-reversed frame, padded to 6144 bytes
+        alignas(16) std::array<uint8_t, 6144> buffer_;
+        // Start of the padding in buffer_. Initially there is no padding.
+        size_t dataEnd_ = 6144;
 };
 
 // -------------- UDP ------------------
@@ -155,7 +214,6 @@ class DabOutputUdp : public DabOutput
         std::string get_info() const {
             return "udp://" + uri_;
         }
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) {}
     private:
         // make sure we don't copy this output around
         // the UdpPacket and UdpSocket do not support
@@ -179,7 +237,6 @@ class DabOutputTcp : public DabOutput
         std::string get_info() const {
             return "tcp://" + uri_;
         }
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) {}
     private:
         std::string uri_;
 
@@ -187,6 +244,11 @@ class DabOutputTcp : public DabOutput
 };
 
 // -------------- Simul ------------------
+/* Paces the multiplexer in real time using a FrameClock, for setups that
+ * have no output that blocks, e.g. only ZMQ or EDI outputs.
+ *
+ * Options are given as query, e.g. simul://?clock=tai&spin=200&align=1
+ */
 class DabOutputSimul : public DabOutput
 {
     public:
@@ -197,11 +259,55 @@ class DabOutputSimul : public DabOutput
         std::string get_info() const {
             return "simul://" + name_;
         }
-        virtual void setMetadata(std::shared_ptr<OutputMetadata> &md) {}
+
+        // With align=1, the due time of the frames sets the deadlines
+        virtual bool wantsMetadata() const { return align_; }
+        virtual void setMetadata(const frame_metadata_t& md) {
+            clock_->set_frame_due_time(md.due_time_ms);
+        }
+    private:
+        std::string name_;
+        bool align_ = false;
+        std::unique_ptr<FrameClock> clock_;
+};
+
+#if defined(HAVE_OUTPUT_SHM)
+// -------------- Shared memory ------------------
+/* Publishes the frames and their metadata in a shared memory ring, for
+ * programs running on the same host. See shmEti.h for the format.
+ */
+class DabOutputShm : public DabOutput
+{
+    public:
+        DabOutputShm() {}
+        DabOutputShm(const DabOutputShm& other) = delete;
+        DabOutputShm& operator=(const DabOutputShm& other) = delete;
+        virtual ~DabOutputShm() { Close(); }
+
+        int Open(const char* name);
+        int Write(void* buffer, int size);
+        int Close();
+
+        std::string get_info() const {
+            return "shm://" + name_;
+        }
+
+        virtual bool wantsMetadata() const { return true; }
+        virtual void setMetadata(const frame_metadata_t& md) { md_ = md; }
+
     private:
         std::string name_;
-        std::chrono::steady_clock::time_point startTime_;
+        int fd_ = -1;
+        void *map_ = nullptr;
+        size_t mapSize_ = 0;
+        shm_eti_header_t *header_ = nullptr;
+        shm_eti_slot_t *slots_ = nullptr;
+        uint64_t seq_ = 0;
+
+        // Metadata for the next frame
+        frame_metadata_t md_;
 };
+#endif // defined(HAVE_OUTPUT_SHM)
 
 #if defined(HAVE_OUTPUT_ZEROMQ)
 
@@ -246,13 +352,45 @@ struct zmq_dab_message_t
 
 #define ZMQ_DAB_MESSAGE_HEAD_LENGTH (4 + NUM_FRAMES_PER_ZMQ_MESSAGE*2)
 
+/* Room reserved after the frames for the metadata of one message */
+#define ZMQ_DAB_MESSAGE_MAX_METADATA_LENGTH 1024
+
+/* Buffers for the messages of the ZeroMQ output. Each message is assembled
+ * in a buffer that is then given to zmq_msg_init_data(), and comes back
+ * through release(), which ZeroMQ calls from one of its I/O threads once
+ * the message is sent.
+ */
+class ZMQBufferPool
+{
+    public:
+        explicit ZMQBufferPool(size_t buffer_size) : buffer_size_(buffer_size) {}
+        ZMQBufferPool(const ZMQBufferPool& other) = delete;
+        ZMQBufferPool& operator=(const ZMQBufferPool& other) = delete;
+
+        size_t buffer_size() const { return buffer_size_; }
+
+        uint8_t* acquire();
+
+        // Matches zmq_free_fn, hint is the pool
+        static void release(void *data, void *hint);
+
+    private:
+        const size_t buffer_size_;
+        std::mutex mutex_;
+        std::vector<std::unique_ptr<uint8_t[]> > free_;
+};
+
 // -------------- ZeroMQ message queue ------------------
 class DabOutputZMQ : public DabOutput
 {
     public:
         DabOutputZMQ(const std::string &zmq_proto, bool allow_metadata) :
             endpoint_(""),
-            zmq_proto_(zmq_proto), zmq_context_(1),
+            zmq_proto_(zmq_proto),
+            pool_(ZMQ_DAB_MESSAGE_HEAD_LENGTH +
+                    NUM_FRAMES_PER_ZMQ_MESSAGE*6144 +
+                    ZMQ_DAB_MESSAGE_MAX_METADATA_LENGTH),
+            zmq_context_(1),
             zmq_pub_sock_(zmq_context_, ZMQ_PUB),
             zmq_message_ix(0),
             m_allow_metadata(allow_metadata)
@@ -263,6 +401,9 @@ class DabOutputZMQ : public DabOutput
 
         virtual ~DabOutputZMQ()
         {
+            if (message_) {
+                ZMQBufferPool::release(message_, &pool_);
+            }
             zmq_pub_sock_.close();
         }
 
@@ -273,19 +414,28 @@ class DabOutputZMQ : public DabOutput
         int Open(const char* endpoint);
         int Write(void* buffer, int size);
         int Close();
-        void setMetadata(std::shared_ptr<OutputMetadata> &md);
+
+        bool wantsMetadata() const { return m_allow_metadata; }
+        void setMetadata(const frame_metadata_t& md);
 
     private:
         std::string endpoint_;
         std::string zmq_proto_;
+        // Declared before the context, so that it outlives the messages
+        // still owned by ZeroMQ
+        ZMQBufferPool pool_;
         zmq::context_t zmq_context_; // handle for the zmq context
         zmq::socket_t zmq_pub_sock_; // handle for the zmq publisher socket
 
-        zmq_dab_message_t zmq_message;
+        // Message being assembled, laid out like zmq_dab_message_t
+        uint8_t *message_ = nullptr;
+        size_t message_length_ = 0;
+        int16_t zmq_buflen_[NUM_FRAMES_PER_ZMQ_MESSAGE];
         int zmq_message_ix;
 
         bool m_allow_metadata;
-        std::vector<std::shared_ptr<OutputMetadata> > meta_;
+        // Metadata of the frames in the message being assembled
+        std::array<frame_metadata_t, NUM_FRAMES_PER_ZMQ_MESSAGE> meta_;
 };
 
 #endif
@@ -28,17 +28,207 @@
 #include <string>
 #include <cstdio>
 #include <cstring>
+#include <cerrno>
 #include <fcntl.h>
 #include <limits.h>
+#include <ctime>
+#include <sys/uio.h>
+#include <arpa/inet.h>
 #include "dabOutput.h"
 
+// O_DIRECT requires offsets, lengths and memory to be aligned to the
+// logical block size of the device. 4096 covers all common devices.
+static constexpr size_t DIRECT_IO_ALIGN = 4096;
+
+// Largest record: a frame with its two-byte length
+static constexpr size_t MAX_RECORD_SIZE = 6144 + 2;
+
+static const uint8_t* eti_padding()
+{
+    static const std::vector<uint8_t> padding(6144, 0x55);
+    return padding.data();
+}
+
+// Write all iovecs, even if the kernel does only a partial write
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0) {
+        ssize_t ret = writev(fd, iov, iovcnt);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        while (iovcnt > 0 and (size_t)ret >= iov->iov_len) {
+            ret -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if (iovcnt > 0) {
+            iov->iov_base = (uint8_t*)iov->iov_base + ret;
+            iov->iov_len -= ret;
+        }
+    }
+    return 0;
+}
+
+DabOutputFile::~DabOutputFile()
+{
+    if (file_ != -1) {
+        Close();
+    }
+}
+
 int DabOutputFile::Open(const char* filename)
 {
     filename_ = SetEtiType(filename);
 
-    this->file_ = open(filename_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0666);
+    if (segmentMinutes_ > 0) {
+        return OpenSegment(std::chrono::system_clock::now());
+    }
+
+    return OpenFile(filename_);
+}
+
+int DabOutputFile::OpenFile(const std::string& path)
+{
+    nbFrames_ = 0;
+    recordOffset_ = (this->type_ == ETI_FILE_TYPE_FRAMED) ? 4 : 0;
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+    if (directIo_) {
+#if defined(O_DIRECT)
+        flags |= O_DIRECT;
+#else
+        etiLog.level(error) << "File output " << path << ": direct I/O is not supported";
+        return -1;
+#endif
+    }
+
+    this->file_ = open(path.c_str(), flags, 0666);
     if (this->file_ == -1) {
-        perror(filename_.c_str());
+        perror(path.c_str());
+        return -1;
+    }
+
+    if (bufferFrames_ > 1 or directIo_) {
+        // Leave room for the unaligned tail that O_DIRECT keeps, and for nbFrames
+        bufferCapacity_ = bufferFrames_ * MAX_RECORD_SIZE + 2 * DIRECT_IO_ALIGN;
+        bufferCapacity_ -= bufferCapacity_ % DIRECT_IO_ALIGN;
+
+        void *buf = nullptr;
+        if (posix_memalign(&buf, DIRECT_IO_ALIGN, bufferCapacity_) != 0) {
+            etiLog.level(error) << "File output " << path << ": cannot allocate buffer";
+            return -1;
+        }
+        buffer_.reset(reinterpret_cast<uint8_t*>(buf));
+        bufferFill_ = 0;
+        bufferedFrames_ = 0;
+        fileOffset_ = 0;
+
+        if (this->type_ == ETI_FILE_TYPE_FRAMED) {
+            // Placeholder for nbFrames, updated on each flush
+            memset(buffer_.get(), 0, 4);
+            bufferFill_ = 4;
+
+            if (directIo_) {
+                headerFile_ = open(path.c_str(), O_WRONLY | O_BINARY);
+                if (headerFile_ == -1) {
+                    perror(path.c_str());
+                    return -1;
+                }
+            }
+        }
+    }
+    else if (this->type_ == ETI_FILE_TYPE_FRAMED) {
+        // Frames get appended after nbFrames, which is updated with pwrite()
+        const uint32_t nbFrames = 0;
+        if (write(this->file_, &nbFrames, 4) != 4) {
+            perror(path.c_str());
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* Segments are named after the time of their start, inserted before the
+ * extension: /rec/mux.eti becomes /rec/mux-20240131-120000.eti */
+static std::string segment_filename(const std::string& filename, std::time_t start)
+{
+    struct tm t;
+    gmtime_r(&start, &t);
+    char timestr[32];
+    strftime(timestr, sizeof(timestr), "-%Y%m%d-%H%M%S", &t);
+
+    const size_t slash = filename.rfind('/');
+    const size_t dot = filename.rfind('.');
+    if (dot == std::string::npos or (slash != std::string::npos and dot < slash)) {
+        return filename + timestr;
+    }
+    return filename.substr(0, dot) + timestr + filename.substr(dot);
+}
+
+int DabOutputFile::OpenSegment(std::chrono::system_clock::time_point now)
+{
+    using namespace std::chrono;
+
+    // Align segment boundaries to multiples of the segment duration
+    const auto duration = minutes(segmentMinutes_);
+    const auto since_epoch = duration_cast<seconds>(now.time_since_epoch());
+    const auto start = since_epoch - (since_epoch % duration);
+    segmentEnd_ = system_clock::time_point(start + duration);
+
+    const std::string path = segment_filename(filename_, start.count());
+    if (OpenFile(path) == -1) {
+        return -1;
+    }
+
+    const std::string index_path = path + ".idx";
+    index_.reset(fopen(index_path.c_str(), "wb"));
+    if (not index_) {
+        etiLog.level(error) << "File output: could not create index " <<
+            index_path << ": " << strerror(errno);
+        return -1;
+    }
+
+    eti_index_header header;
+    memcpy(header.magic, ETI_INDEX_MAGIC, sizeof(header.magic));
+    header.file_type = this->type_;
+    header.entry_size = sizeof(eti_index_entry);
+    if (fwrite(&header, sizeof(header), 1, index_.get()) != 1) {
+        etiLog.level(error) << "File output: could not write index " <<
+            index_path << ": " << strerror(errno);
+        return -1;
+    }
+
+    etiLog.level(info) << "File output: recording segment " << path;
+    return 0;
+}
+
+int DabOutputFile::WriteIndexEntry(const uint8_t* frame, int size,
+        std::chrono::system_clock::time_point now)
+{
+    using namespace std::chrono;
+
+    eti_index_entry entry;
+    entry.offset = recordOffset_;
+    entry.wallclock_ms = duration_cast<milliseconds>(now.time_since_epoch()).count();
+    entry.edi_seconds = md_.timestamp_valid ? md_.edi_seconds : 0;
+
+    const eti_FC *fc = reinterpret_cast<const eti_FC*>(frame + 4);
+    entry.dlfc = md_.timestamp_valid ? md_.dlfc : fc->FCT;
+
+    uint32_t tist = 0;
+    memcpy(&tist, frame + size - 4, 4);
+    entry.tist = ntohl(tist) & 0xFFFFFF;
+    entry.rfu = 0;
+
+    if (fwrite(&entry, sizeof(entry), 1, index_.get()) != 1) {
+        etiLog.level(error) << "File output: could not write index: " << strerror(errno);
         return -1;
     }
     return 0;
@@ -46,37 +236,50 @@ int DabOutputFile::Open(const char* filename)
 
 int DabOutputFile::Write(void* buffer, int size)
 {
-    uint8_t padding[6144];
     const uint16_t frame_size = size;
+
+    if (segmentMinutes_ > 0) {
+        const auto now = std::chrono::system_clock::now();
+        if (now >= segmentEnd_) {
+            if (Close() == -1 or OpenSegment(now) == -1) {
+                return -1;
+            }
+        }
+
+        if (WriteIndexEntry(reinterpret_cast<const uint8_t*>(buffer), size, now) == -1) {
+            return -1;
+        }
+    }
+
     ++nbFrames_;
+    recordOffset_ += (this->type_ == ETI_FILE_TYPE_RAW) ? 6144 : 2 + size;
+
+    if (buffer_) {
+        return WriteBuffered(reinterpret_cast<const uint8_t*>(buffer), size);
+    }
+
+    // Without buffering, every frame goes out in a single writev()
+    struct iovec iov[2];
+    int iovcnt = 0;
 
     switch (this->type_) {
     case ETI_FILE_TYPE_FRAMED:
         // Writing nb of frames at beginning of file
-        if (lseek(this->file_, 0, SEEK_SET) == -1) goto FILE_WRITE_ERROR;
-        if (write(this->file_, &this->nbFrames_, 4) == -1) goto FILE_WRITE_ERROR;
-
-        // Writing nb frame length at end of file
-        if (lseek(this->file_, 0, SEEK_END) == -1) goto FILE_WRITE_ERROR;
-        if (write(this->file_, &frame_size, 2) == -1) goto FILE_WRITE_ERROR;
-
-        // Appending data
-        if (write(this->file_, buffer, size) == -1) goto FILE_WRITE_ERROR;
-        break;
+        if (WriteFrameCount() == -1) goto FILE_WRITE_ERROR;
+        [[fallthrough]];
     case ETI_FILE_TYPE_STREAMED:
-        // Writing nb frame length at end of file
-        if (write(this->file_, &frame_size, 2) == -1) goto FILE_WRITE_ERROR;
-
-        // Appending data
-        if (write(this->file_, buffer, size) == -1) goto FILE_WRITE_ERROR;
+        // Writing nb frame length at end of file, and appending data
+        iov[iovcnt].iov_base = (void*)&frame_size;
+        iov[iovcnt++].iov_len = 2;
+        iov[iovcnt].iov_base = buffer;
+        iov[iovcnt++].iov_len = size;
         break;
     case ETI_FILE_TYPE_RAW:
-        // Appending data
-        if (write(this->file_, buffer, size) == -1) goto FILE_WRITE_ERROR;
-
-        // Appending padding
-        memset(padding, 0x55, 6144 - size);
-        if (write(this->file_, padding, 6144 - size) == -1) goto FILE_WRITE_ERROR;
+        // Appending data and padding
+        iov[iovcnt].iov_base = buffer;
+        iov[iovcnt++].iov_len = size;
+        iov[iovcnt].iov_base = (void*)eti_padding();
+        iov[iovcnt++].iov_len = 6144 - size;
         break;
     case ETI_FILE_TYPE_NONE:
     default:
@@ -84,6 +287,8 @@ int DabOutputFile::Write(void* buffer, int size)
         return -1;
     }
 
+    if (writev_all(this->file_, iov, iovcnt) == -1) goto FILE_WRITE_ERROR;
+
     return size;
 
 FILE_WRITE_ERROR:
@@ -91,11 +296,131 @@ FILE_WRITE_ERROR:
     return -1;
 }
 
+int DabOutputFile::WriteBuffered(const uint8_t* buffer, int size)
+{
+    uint8_t *buf = buffer_.get();
+    const uint16_t frame_size = size;
+
+    switch (this->type_) {
+    case ETI_FILE_TYPE_FRAMED:
+    case ETI_FILE_TYPE_STREAMED:
+        memcpy(buf + bufferFill_, &frame_size, 2);
+        memcpy(buf + bufferFill_ + 2, buffer, size);
+        bufferFill_ += 2 + size;
+        break;
+    case ETI_FILE_TYPE_RAW:
+        memcpy(buf + bufferFill_, buffer, size);
+        memset(buf + bufferFill_ + size, 0x55, 6144 - size);
+        bufferFill_ += 6144;
+        break;
+    case ETI_FILE_TYPE_NONE:
+    default:
+        etiLog.log(error, "File type is not supported.\n");
+        return -1;
+    }
+
+    if (++bufferedFrames_ >= bufferFrames_) {
+        if (Flush(false) == -1) {
+            return -1;
+        }
+    }
+
+    return size;
+}
+
+int DabOutputFile::Flush(bool final)
+{
+    uint8_t *buf = buffer_.get();
+
+    if (final and directIo_) {
+#if defined(O_DIRECT)
+        // The tail is not a multiple of the block size
+        int flags = fcntl(this->file_, F_GETFL);
+        if (flags == -1 or fcntl(this->file_, F_SETFL, flags & ~O_DIRECT) == -1) {
+            perror("Error while disabling direct I/O");
+            return -1;
+        }
+#endif
+    }
+
+    size_t len = bufferFill_;
+    if (directIo_ and not final) {
+        len -= len % DIRECT_IO_ALIGN;
+    }
+
+    size_t written = 0;
+    while (written < len) {
+        ssize_t ret = write(this->file_, buf + written, len - written);
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Error while writing to file");
+            return -1;
+        }
+        written += ret;
+    }
+
+    fileOffset_ += len;
+    bufferFill_ -= len;
+    if (bufferFill_ > 0) {
+        memmove(buf, buf + len, bufferFill_);
+    }
+
+    framesSinceSync_ += bufferedFrames_;
+    bufferedFrames_ = 0;
+
+    if (this->type_ == ETI_FILE_TYPE_FRAMED and WriteFrameCount() == -1) {
+        perror("Error while writing to file");
+        return -1;
+    }
+
+    if (syncFrames_ > 0 and (final or framesSinceSync_ >= syncFrames_)) {
+        framesSinceSync_ = 0;
+        if (fdatasync(this->file_) == -1) {
+            perror("Error while syncing file");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int DabOutputFile::WriteFrameCount()
+{
+    const uint32_t nbFrames = this->nbFrames_;
+
+    if (buffer_ and fileOffset_ == 0) {
+        // The header is still in the buffer
+        memcpy(buffer_.get(), &nbFrames, 4);
+        return 0;
+    }
+
+    const int fd = (headerFile_ != -1) ? headerFile_ : this->file_;
+    if (pwrite(fd, &nbFrames, 4, 0) != 4) {
+        return -1;
+    }
+    return 0;
+}
+
 int DabOutputFile::Close()
 {
+    int ret = 0;
+    index_.reset();
+
+    if (buffer_ and this->file_ != -1) {
+        ret = Flush(true);
+        buffer_.reset();
+    }
+
+    if (headerFile_ != -1) {
+        close(headerFile_);
+        headerFile_ = -1;
+    }
+
     if (close(this->file_) == 0) {
         this->file_ = -1;
-        return 0;
+        return ret;
     }
     perror("Can't close file");
     return -1;
@@ -121,7 +446,7 @@ std::string DabOutputFile::SetEtiType(const std::string& filename)
 
             const std::string key = filename.substr(ix_key, ix_eq - ix_key);
 
-            ix = filename.find('&', ix);
+            ix = filename.find('&', ix_eq);
             const size_t len_value = (ix == std::string::npos) ? std::string::npos : ix - ix_val;
 
             if (key == "type") {
@@ -129,19 +454,49 @@ std::string DabOutputFile::SetEtiType(const std::string& filename)
 
                 if (value == "raw") {
                     this->type_ = ETI_FILE_TYPE_RAW;
-                    break;
                 } else if (value == "framed") {
                     this->type_ = ETI_FILE_TYPE_FRAMED;
-                    break;
                 } else if (value == "streamed") {
                     this->type_ = ETI_FILE_TYPE_STREAMED;
-                    break;
                 } else {
                     std::stringstream ss;
                     ss << "File type '" << value << "' is not supported.";
                     throw std::runtime_error(ss.str());
                 }
             }
+            else if (key == "buffer" or key == "sync") {
+                const std::string value = filename.substr(ix_val, len_value);
+                size_t num_frames = 0;
+                try {
+                    num_frames = std::stoul(value);
+                }
+                catch (const std::logic_error&) {
+                    throw std::runtime_error("File output: invalid " + key + " value '" + value + "'");
+                }
+
+                if (key == "buffer") {
+                    if (num_frames == 0 or num_frames > 1000) {
+                        throw std::runtime_error("File output: buffer must be between 1 and 1000 frames");
+                    }
+                    this->bufferFrames_ = num_frames;
+                }
+                else {
+                    this->syncFrames_ = num_frames;
+                }
+            }
+            else if (key == "segment") {
+                const std::string value = filename.substr(ix_val, len_value);
+                try {
+                    this->segmentMinutes_ = std::stoul(value);
+                }
+                catch (const std::logic_error&) {
+                    throw std::runtime_error("File output: invalid segment value '" + value + "'");
+                }
+            }
+            else if (key == "direct") {
+                const std::string value = filename.substr(ix_val, len_value);
+                this->directIo_ = (value == "1" or value == "true");
+            }
 
         }
         while (ix != std::string::npos);
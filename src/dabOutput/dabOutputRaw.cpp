@@ -51,6 +51,14 @@
 #include <cstring>
 #include <map>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#   define HAVE_BIT_REVERSE_SSSE3 1
+#   include <immintrin.h>
+#elif defined(__aarch64__)
+#   define HAVE_BIT_REVERSE_NEON 1
+#   include <arm_neon.h>
+#endif
+
 
 const unsigned char revTable[] = {
     0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0,
@@ -87,6 +95,74 @@ const unsigned char revTable[] = {
     0x1f, 0x9f, 0x5f, 0xdf, 0x3f, 0xbf, 0x7f, 0xff
 };
 
+/* The farsync cards send the bits of each byte LSB first, so every byte
+ * of the frame has to be bit-reversed. */
+static void bit_reverse_scalar(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = revTable[src[i]];
+    }
+}
+
+#if defined(HAVE_BIT_REVERSE_SSSE3)
+/* Reverse both nibbles with a PSHUFB table lookup, and swap them. */
+__attribute__((target("ssse3")))
+static void bit_reverse_ssse3(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    // Reversed low nibble, placed in the high nibble
+    const __m128i lut_lo = _mm_setr_epi8(
+            0x00, (char)0x80, 0x40, (char)0xc0, 0x20, (char)0xa0, 0x60, (char)0xe0,
+            0x10, (char)0x90, 0x50, (char)0xd0, 0x30, (char)0xb0, 0x70, (char)0xf0);
+    // Reversed high nibble, placed in the low nibble
+    const __m128i lut_hi = _mm_setr_epi8(
+            0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
+            0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf);
+    const __m128i nibble_mask = _mm_set1_epi8(0x0f);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        const __m128i lo = _mm_and_si128(v, nibble_mask);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble_mask);
+        const __m128i r = _mm_or_si128(
+                _mm_shuffle_epi8(lut_lo, lo),
+                _mm_shuffle_epi8(lut_hi, hi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+    }
+
+    bit_reverse_scalar(dst + i, src + i, len - i);
+}
+#endif
+
+#if defined(HAVE_BIT_REVERSE_NEON)
+static void bit_reverse_neon(uint8_t *dst, const uint8_t *src, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        vst1q_u8(dst + i, vrbitq_u8(vld1q_u8(src + i)));
+    }
+
+    bit_reverse_scalar(dst + i, src + i, len - i);
+}
+#endif
+
+using bit_reverse_fn = void (*)(uint8_t*, const uint8_t*, size_t);
+
+static bit_reverse_fn select_bit_reverse()
+{
+#if defined(HAVE_BIT_REVERSE_SSSE3)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3")) {
+        return bit_reverse_ssse3;
+    }
+#elif defined(HAVE_BIT_REVERSE_NEON)
+    return bit_reverse_neon;
+#endif
+    return bit_reverse_scalar;
+}
+
+static const bit_reverse_fn bit_reverse = select_bit_reverse();
+
 /* Takes an URI with some parameters in the form
  * proto://something/etc?param1=foo&param2=bar
  * and returns a map of
@@ -392,19 +468,17 @@ int DabOutputRaw::Open(const char* name)
 
 int DabOutputRaw::Write(void* buffer, int size)
 {
-    std::vector<unsigned char> buffer_(6144);
     if ((size_t)size > buffer_.size()) {
         throw std::logic_error("DabOutputRaw::Write size exceeded");
     }
 
-    // Encode data, extend our frame with 0x55 padding
-    int i = 0;
-    for (; i < size; i++) {
-        buffer_[i] = revTable[reinterpret_cast<uint8_t*>(buffer)[i]];
-    }
-    for (; i < 6144; i++) {
-        buffer_[i] = revTable[0x55];
+    // Encode data. Everything after dataEnd_ already contains the encoded
+    // 0x55 padding, only the part the previous frame used needs refilling.
+    bit_reverse(buffer_.data(), reinterpret_cast<const uint8_t*>(buffer), size);
+    if ((size_t)size < dataEnd_) {
+        memset(buffer_.data() + size, revTable[0x55], dataEnd_ - size);
     }
+    dataEnd_ = size;
 
     // Write data
 #ifdef _WIN32
@@ -0,0 +1,163 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Shared memory output, for modulators and monitoring tools running on
+   the same host as the multiplexer.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+   */
+
+#include "dabOutput.h"
+#if defined(HAVE_OUTPUT_SHM)
+
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Log.h"
+
+using namespace std;
+
+constexpr uint32_t DEFAULT_NUM_SLOTS = 64;
+
+int DabOutputShm::Open(const char* name)
+{
+    // Parse name?slots=N
+    const string full(name);
+    const size_t query = full.find('?');
+    name_ = full.substr(0, query);
+
+    uint32_t num_slots = DEFAULT_NUM_SLOTS;
+    if (query != string::npos) {
+        const string params = full.substr(query + 1);
+        if (params.compare(0, 6, "slots=") != 0) {
+            etiLog.level(error) << "Unsupported shm output parameters " << params;
+            return -1;
+        }
+        try {
+            num_slots = stoul(params.substr(6));
+        }
+        catch (const logic_error&) {
+            num_slots = 0;
+        }
+        if (num_slots < 2 or num_slots > 4096) {
+            etiLog.level(error) << "shm output: slots must be between 2 and 4096";
+            return -1;
+        }
+    }
+
+    if (name_.empty() or name_.find('/') != string::npos) {
+        etiLog.level(error) << "Invalid shm output name '" << name_ << "'";
+        return -1;
+    }
+
+    // Readers of a previous instance keep the old segment until they
+    // open the name again.
+    const string path = "/" + name_;
+    shm_unlink(path.c_str());
+
+    fd_ = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd_ == -1) {
+        etiLog.level(error) << "Cannot create shared memory " << name_ << ": " <<
+            strerror(errno);
+        return -1;
+    }
+
+    mapSize_ = shm_eti_segment_size(num_slots);
+    if (ftruncate(fd_, mapSize_) == -1) {
+        etiLog.level(error) << "Cannot resize shared memory " << name_ << ": " <<
+            strerror(errno);
+        Close();
+        return -1;
+    }
+
+    map_ = mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        etiLog.level(error) << "Cannot map shared memory " << name_ << ": " <<
+            strerror(errno);
+        Close();
+        return -1;
+    }
+
+    // ftruncate zero-fills the segment, which is a valid initial state for
+    // all atomics and slots.
+    header_ = reinterpret_cast<shm_eti_header_t*>(map_);
+    slots_ = shm_eti_slots(header_);
+    header_->num_slots = num_slots;
+    header_->slot_size = sizeof(shm_eti_slot_t);
+    seq_ = 0;
+
+    // Readers check the magic, it must be written last
+    atomic_thread_fence(memory_order_release);
+    memcpy(header_->magic, SHM_ETI_MAGIC, sizeof(header_->magic));
+
+    etiLog.level(info) << "shm output " << name_ << " with " << num_slots << " slots";
+    return 0;
+}
+
+int DabOutputShm::Write(void* buffer, int size)
+{
+    if (header_ == nullptr or size < 0 or size > SHM_ETI_MAX_FRAME_SIZE) {
+        return -1;
+    }
+
+    auto& slot = slots_[seq_ % header_->num_slots];
+
+    // Mark the slot as being written before touching the data
+    slot.seq.store(2 * seq_ + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(slot.data, buffer, size);
+    slot.length = size;
+    slot.flags = md_.timestamp_valid ?
+        (SHM_ETI_HAS_UTCO | SHM_ETI_HAS_EDI_TIME | SHM_ETI_HAS_DLFC) : 0;
+    slot.utco = md_.utco;
+    slot.dlfc = md_.dlfc;
+    slot.edi_seconds = md_.edi_seconds;
+
+    slot.seq.store(2 * seq_ + 2, memory_order_release);
+
+    seq_++;
+    header_->write_seq.store(seq_, memory_order_release);
+    header_->futex.fetch_add(1, memory_order_release);
+    shm_eti_wake(header_);
+
+    return size;
+}
+
+int DabOutputShm::Close()
+{
+    if (map_) {
+        munmap(map_, mapSize_);
+        map_ = nullptr;
+        header_ = nullptr;
+        slots_ = nullptr;
+    }
+    if (fd_ != -1) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    return 0;
+}
+
+#endif // defined(HAVE_OUTPUT_SHM)
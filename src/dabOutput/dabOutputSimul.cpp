@@ -26,35 +26,76 @@
    along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
    */
 #include "dabOutput.h"
-#include <cstring>
-#include <cstdio>
-#include <fcntl.h>
-#include <limits.h>
+#include "RemoteControl.h"
+#include <cstdlib>
 #include <chrono>
-#include <thread>
 
 
 int DabOutputSimul::Open(const char* name)
 {
-    startTime_ = std::chrono::steady_clock::now();
-    return 0;
-}
+    const std::string uri(name);
+    size_t ix = uri.find('?');
+    name_ = uri.substr(0, ix);
 
-int DabOutputSimul::Write(void* buffer, int size)
-{
-    auto curTime = std::chrono::steady_clock::now();
+    FrameClock::config_t config;
+
+    while (ix != std::string::npos) {
+        const size_t ix_key = ix + 1;
+        const size_t ix_eq = uri.find('=', ix_key);
+        if (ix_eq == std::string::npos) {
+            break;
+        }
 
-    const auto frameinterval = std::chrono::milliseconds(24);
+        const std::string key = uri.substr(ix_key, ix_eq - ix_key);
 
-    auto diff = curTime - startTime_;
-    auto waiting = frameinterval - diff;
+        ix = uri.find('&', ix_eq);
+        const size_t len_value = (ix == std::string::npos) ?
+            std::string::npos : ix - ix_eq - 1;
+        const std::string value = uri.substr(ix_eq + 1, len_value);
 
-    if (diff < frameinterval) {
-            std::this_thread::sleep_for(waiting);
+        if (key == "clock") {
+            if (value == "monotonic") {
+                config.clock_id = CLOCK_MONOTONIC;
+            }
+            else if (value == "tai") {
+                config.clock_id = CLOCK_TAI;
+            }
+            else {
+                etiLog.level(error) << "Simul output: unknown clock " << value;
+                return -1;
+            }
+        }
+        else if (key == "spin") {
+            const int spin_us = atoi(value.c_str());
+            if (spin_us < 0 or spin_us > 10000) {
+                etiLog.level(error) << "Simul output: invalid spin " << value;
+                return -1;
+            }
+            config.spin = std::chrono::microseconds(spin_us);
+        }
+        else if (key == "align") {
+            config.align = (value == "1");
+        }
+        else {
+            etiLog.level(warn) << "Simul output: unknown option " << key;
+        }
     }
 
-    startTime_ += frameinterval;
+    if (config.align and config.clock_id != CLOCK_TAI) {
+        etiLog.level(error) << "Simul output: align=1 requires clock=tai";
+        return -1;
+    }
 
+    align_ = config.align;
+    clock_ = std::make_unique<FrameClock>(config);
+    rcs.enrol(clock_.get());
+    clock_->start();
+    return 0;
+}
+
+int DabOutputSimul::Write(void* buffer, int size)
+{
+    clock_->wait_next_frame();
     return size;
 }
 
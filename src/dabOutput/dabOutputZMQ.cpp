@@ -66,53 +66,85 @@ int DabOutputZMQ::Open(const char* endpoint)
 }
 
 
-int DabOutputZMQ::Write(void* buffer, int size)
+uint8_t* ZMQBufferPool::acquire()
 {
-    int offset = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (not free_.empty()) {
+            uint8_t *buf = free_.back().release();
+            free_.pop_back();
+            return buf;
+        }
+    }
+    return new uint8_t[buffer_size_];
+}
 
-    // Increment the offset by the accumulated frame offsets
-    for (int i = 0; i < zmq_message_ix; i++) {
-        offset += zmq_message.buflen[i];
+void ZMQBufferPool::release(void *data, void *hint)
+{
+    auto pool = reinterpret_cast<ZMQBufferPool*>(hint);
+    std::unique_ptr<uint8_t[]> buf(reinterpret_cast<uint8_t*>(data));
+
+    std::lock_guard<std::mutex> lock(pool->mutex_);
+    pool->free_.push_back(std::move(buf));
+}
+
+int DabOutputZMQ::Write(void* buffer, int size)
+{
+    if (message_ == nullptr) {
+        message_ = pool_.acquire();
+        message_length_ = ZMQ_DAB_MESSAGE_HEAD_LENGTH;
     }
 
-    if (offset + size > NUM_FRAMES_PER_ZMQ_MESSAGE*6144) {
+    if (message_length_ + size >
+            ZMQ_DAB_MESSAGE_HEAD_LENGTH + NUM_FRAMES_PER_ZMQ_MESSAGE*6144) {
         throw std::runtime_error("FAULT: invalid ETI frame size!");
     }
 
     // Append the new frame to our message
-    memcpy(zmq_message.buf + offset, buffer, size);
-    zmq_message.buflen[zmq_message_ix] = size;
+    memcpy(message_ + message_length_, buffer, size);
+    message_length_ += size;
+    zmq_buflen_[zmq_message_ix] = size;
     zmq_message_ix++;
 
     // As soon as we have NUM_FRAMES_PER_ZMQ_MESSAGE frames, we transmit
     if (zmq_message_ix == NUM_FRAMES_PER_ZMQ_MESSAGE) {
-
-        // Size of the header:
-        size_t full_length = ZMQ_DAB_MESSAGE_HEAD_LENGTH;
-
-        for (int i = 0; i < NUM_FRAMES_PER_ZMQ_MESSAGE; i++) {
-            full_length += zmq_message.buflen[i];
+        // The header has the layout of zmq_dab_message_t, in host byte order
+        const uint32_t version = 1;
+        memcpy(message_, &version, sizeof(version));
+        memcpy(message_ + sizeof(version), zmq_buflen_, sizeof(zmq_buflen_));
+
+        // metadata gets appended at the end. The separator after the
+        // fields of each frame allows the receiver to associate the right
+        // metadata with the right ETI frame.
+        if (m_allow_metadata) {
+            for (const auto& md : meta_) {
+                if (md.timestamp_valid) {
+                    OutputMetadataUTCO utco(md.utco);
+                    message_length_ += utco.write(message_ + message_length_);
+                    OutputMetadataEDITime edi_time(md.edi_seconds);
+                    message_length_ += edi_time.write(message_ + message_length_);
+                    OutputMetadataDLFC dlfc(md.dlfc);
+                    message_length_ += dlfc.write(message_ + message_length_);
+                }
+                OutputMetadataSeparation sep;
+                message_length_ += sep.write(message_ + message_length_);
+            }
         }
 
-        vector<uint8_t> msg(full_length);
-        memcpy(msg.data(), (uint8_t*)&zmq_message, full_length);
-
-        // metadata gets appended at the end
-        for (const auto& md : meta_) {
-            vector<uint8_t> md_data(md->getLength());
-            md->write(md_data.data());
-
-            copy(md_data.begin(), md_data.end(), back_inserter(msg));
-        }
+        // On success, ZeroMQ takes ownership of the buffer and gives it
+        // back to the pool once sent. Otherwise zmq_msg_close releases it.
+        zmq_msg_t msg;
+        zmq_msg_init_data(&msg, message_, message_length_,
+                ZMQBufferPool::release, &pool_);
+        message_ = nullptr;
 
         const int flags = 0;
-        zmq_send(zmq_pub_sock_, msg.data(), msg.size(), flags);
+        if (zmq_msg_send(&msg, zmq_pub_sock_.handle(), flags) == -1) {
+            zmq_msg_close(&msg);
+        }
 
-        meta_.clear();
+        meta_.fill(frame_metadata_t());
         zmq_message_ix = 0;
-        for (int i = 0; i < NUM_FRAMES_PER_ZMQ_MESSAGE; i++) {
-            zmq_message.buflen[i] = -1;
-        }
     }
 
     return size;
@@ -124,11 +156,9 @@ int DabOutputZMQ::Close()
     return zmq_close(zmq_pub_sock_);
 }
 
-void DabOutputZMQ::setMetadata(std::shared_ptr<OutputMetadata> &md)
+void DabOutputZMQ::setMetadata(const frame_metadata_t& md)
 {
-    if (m_allow_metadata) {
-        meta_.push_back(md);
-    }
+    meta_[zmq_message_ix] = md;
 }
 
 #endif
@@ -53,6 +53,21 @@ enum class output_metadata_id_e {
     dlfc = 3,
 };
 
+/* Metadata of one ETI frame, given to the outputs together with the frame.
+ * The timestamp fields are only set when the multiplexer uses the TAI
+ * clock. */
+struct frame_metadata_t {
+    bool timestamp_valid = false;
+    int16_t utco = 0;
+    uint32_t edi_seconds = 0;
+    uint16_t dlfc = 0;
+
+    // When the frame is due, in milliseconds since the UNIX epoch: its time
+    // on the TIST grid, without the tist_offset. Always set.
+    int64_t due_time_ms = 0;
+};
+
+/* Serialisation of the metadata fields, in the format above */
 struct OutputMetadata {
     virtual ~OutputMetadata() {};
 
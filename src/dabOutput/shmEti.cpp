@@ -0,0 +1,183 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shmEti.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace std;
+
+size_t shm_eti_segment_size(uint32_t num_slots)
+{
+    // The slots need the alignment of their data
+    const size_t header_size = (sizeof(shm_eti_header_t) + alignof(shm_eti_slot_t) - 1) /
+        alignof(shm_eti_slot_t) * alignof(shm_eti_slot_t);
+    return header_size + num_slots * sizeof(shm_eti_slot_t);
+}
+
+shm_eti_slot_t* shm_eti_slots(shm_eti_header_t *header)
+{
+    const size_t header_size = shm_eti_segment_size(0);
+    return reinterpret_cast<shm_eti_slot_t*>(reinterpret_cast<uint8_t*>(header) + header_size);
+}
+
+static uint32_t* futex_word(shm_eti_header_t *header)
+{
+    return reinterpret_cast<uint32_t*>(&header->futex);
+}
+
+void shm_eti_wake(shm_eti_header_t *header)
+{
+    if (header->waiters.load() > 0) {
+        syscall(SYS_futex, futex_word(header), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    }
+}
+
+ShmEtiReader::ShmEtiReader(const string& name)
+{
+    // Readers also write to the header, to register as futex waiters
+    const string path = "/" + name;
+    m_fd = shm_open(path.c_str(), O_RDWR, 0);
+    if (m_fd == -1) {
+        throw runtime_error("ShmEtiReader: cannot open " + name + ": " + strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == -1 or (size_t)st.st_size < shm_eti_segment_size(0)) {
+        ::close(m_fd);
+        throw runtime_error("ShmEtiReader: " + name + " is too small");
+    }
+    m_map_size = st.st_size;
+
+    m_map = mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (m_map == MAP_FAILED) {
+        m_map = nullptr;
+        ::close(m_fd);
+        throw runtime_error("ShmEtiReader: cannot map " + name + ": " + strerror(errno));
+    }
+
+    m_header = reinterpret_cast<shm_eti_header_t*>(m_map);
+    m_slots = shm_eti_slots(m_header);
+
+    if (memcmp(m_header->magic, SHM_ETI_MAGIC, sizeof(m_header->magic)) != 0 or
+            m_header->slot_size != sizeof(shm_eti_slot_t) or
+            shm_eti_segment_size(m_header->num_slots) > m_map_size) {
+        munmap(m_map, m_map_size);
+        ::close(m_fd);
+        throw runtime_error("ShmEtiReader: " + name + " has an incompatible format");
+    }
+
+    m_next_seq = m_header->write_seq.load();
+}
+
+ShmEtiReader::~ShmEtiReader()
+{
+    if (m_map) {
+        munmap(m_map, m_map_size);
+    }
+    if (m_fd != -1) {
+        ::close(m_fd);
+    }
+}
+
+bool ShmEtiReader::next(frame_t& frame, int timeout_ms)
+{
+    const uint64_t num_slots = m_header->num_slots;
+    bool waited = false;
+
+    while (true) {
+        // Read the futex before write_seq, so that a frame published in
+        // between makes FUTEX_WAIT return immediately.
+        const uint32_t futex_value = m_header->futex.load();
+        const uint64_t write_seq = m_header->write_seq.load();
+
+        if (write_seq < m_next_seq) {
+            // The writer was restarted
+            m_next_seq = write_seq;
+        }
+
+        if (write_seq > m_next_seq) {
+            if (write_seq - m_next_seq > num_slots) {
+                // Skip to the newest frame, the others are being overwritten
+                m_dropped += write_seq - 1 - m_next_seq;
+                m_next_seq = write_seq - 1;
+            }
+
+            const auto& slot = m_slots[m_next_seq % num_slots];
+            if (slot.seq.load(memory_order_acquire) != 2 * m_next_seq + 2) {
+                // Overwritten since we read write_seq
+                continue;
+            }
+
+            frame.data = slot.data;
+            frame.length = std::min<size_t>(slot.length, SHM_ETI_MAX_FRAME_SIZE);
+            frame.flags = slot.flags;
+            frame.utco = slot.utco;
+            frame.dlfc = slot.dlfc;
+            frame.edi_seconds = slot.edi_seconds;
+            frame.seq = m_next_seq;
+            frame.slot = &slot;
+
+            if (not valid(frame)) {
+                continue;
+            }
+
+            m_next_seq++;
+            return true;
+        }
+
+        if (waited) {
+            return false;
+        }
+
+        struct timespec timeout;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+        m_header->waiters.fetch_add(1);
+        syscall(SYS_futex, futex_word(m_header), FUTEX_WAIT, futex_value,
+                &timeout, nullptr, 0);
+        m_header->waiters.fetch_sub(1);
+
+        // Wakeups are only for new frames, a timeout or a spurious wakeup
+        // give up after the next check.
+        waited = (m_header->futex.load() == futex_value);
+    }
+}
+
+bool ShmEtiReader::valid(const frame_t& frame) const
+{
+    atomic_thread_fence(memory_order_acquire);
+    return frame.slot->seq.load(memory_order_relaxed) == 2 * frame.seq + 2;
+}
+
@@ -0,0 +1,149 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Shared memory ring used by the shm:// output, and reader for programs
+ * running on the same host. This file and shmEti.cpp have no other
+ * dependency, and can be copied into other projects.
+ *
+ * The segment is created with shm_open, and contains a shm_eti_header_t
+ * followed by num_slots shm_eti_slot_t. ODR-DabMux is the only writer, and
+ * writes frame number seq into slot seq % num_slots. Readers never block
+ * the writer: a reader that is more than num_slots frames behind loses
+ * frames.
+ *
+ * Every slot is protected by a sequence lock. While the writer fills in
+ * frame seq, slot.seq is 2*seq+1, and 2*seq+2 once the frame is complete.
+ * A reader accesses the data in place, and has to check with
+ * ShmEtiReader::valid() that the slot wasn't overwritten in the meantime.
+ *
+ * After each frame, the writer increments the futex word in the header, and
+ * wakes the readers that are waiting on it.
+ *
+ * When ODR-DabMux restarts, it replaces the segment with a new one. Readers
+ * still see the old one, and should open the segment again when next()
+ * times out.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define SHM_ETI_MAGIC "ODRETI01"
+#define SHM_ETI_MAX_FRAME_SIZE 6144
+
+// Bits of shm_eti_slot_t::flags, telling which metadata is present
+#define SHM_ETI_HAS_UTCO      0x1
+#define SHM_ETI_HAS_EDI_TIME  0x2
+#define SHM_ETI_HAS_DLFC      0x4
+
+struct shm_eti_header_t {
+    char magic[8];
+    uint32_t num_slots;
+    uint32_t slot_size;
+
+    // Number of frames published since the writer started
+    std::atomic<uint64_t> write_seq;
+
+    // Incremented after every frame, readers wait on it
+    std::atomic<uint32_t> futex;
+
+    // Number of readers waiting on the futex
+    std::atomic<uint32_t> waiters;
+};
+
+struct shm_eti_slot_t {
+    std::atomic<uint64_t> seq;
+    uint32_t length;
+    uint32_t flags;
+
+    // Same meaning as the OutputMetadata of the ZMQ output
+    int16_t utco;
+    uint16_t dlfc;
+    uint32_t edi_seconds;
+
+    alignas(64) uint8_t data[SHM_ETI_MAX_FRAME_SIZE];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free and
+        std::atomic<uint32_t>::is_always_lock_free,
+        "shared memory ring needs lock-free atomics");
+
+/* Size of the segment for the given number of slots */
+size_t shm_eti_segment_size(uint32_t num_slots);
+
+/* The slots follow the header */
+shm_eti_slot_t* shm_eti_slots(shm_eti_header_t *header);
+
+/* Wake all processes waiting on the header futex */
+void shm_eti_wake(shm_eti_header_t *header);
+
+class ShmEtiReader
+{
+    public:
+        struct frame_t {
+            const uint8_t *data = nullptr;
+            size_t length = 0;
+            uint32_t flags = 0;
+            int16_t utco = 0;
+            uint16_t dlfc = 0;
+            uint32_t edi_seconds = 0;
+
+            // Sequence number of the frame, and its slot, used by valid()
+            uint64_t seq = 0;
+            const shm_eti_slot_t *slot = nullptr;
+        };
+
+        /* Open the segment created by the shm:// output with this name.
+         * Reading starts with the next frame the writer publishes.
+         * Throws a runtime_error if the segment cannot be opened. */
+        ShmEtiReader(const std::string& name);
+        ~ShmEtiReader();
+        ShmEtiReader(const ShmEtiReader& other) = delete;
+        ShmEtiReader& operator=(const ShmEtiReader& other) = delete;
+
+        /* Wait until the next frame is available, at most timeout_ms.
+         * Returns false on timeout. frame.data points into the shared
+         * memory, and is only guaranteed to be consistent if valid()
+         * returns true after it was used. */
+        bool next(frame_t& frame, int timeout_ms);
+
+        /* Returns false if the writer overwrote the frame */
+        bool valid(const frame_t& frame) const;
+
+        /* Number of frames that were overwritten before we could read them */
+        uint64_t num_dropped() const { return m_dropped; }
+
+    private:
+        int m_fd = -1;
+        void *m_map = nullptr;
+        size_t m_map_size = 0;
+        shm_eti_header_t *m_header = nullptr;
+        shm_eti_slot_t *m_slots = nullptr;
+
+        uint64_t m_next_seq = 0;
+        uint64_t m_dropped = 0;
+};
+
@@ -0,0 +1,360 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Runs the FIC schedulers on the ensemble of a multiplexer configuration,
+   without inputs and outputs and faster than real time, and reports the
+   repetition rates they achieve.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include "ConfigParser.h"
+#include "MuxElements.h"
+#include "Log.h"
+#include "utils.h"
+#include "fig/FIGCarousel.h"
+#include "fig/FIGCarouselEDF.h"
+#include "fig/FIGCarouselPriority.h"
+#include "fig/FIGSchedulerType.h"
+#include <boost/property_tree/info_parser.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+constexpr int FRAME_DURATION_MS = 24;
+constexpr uint64_t DEFAULT_NUM_FRAMES = 1000000;
+
+static void usage()
+{
+    cerr << "Usage:" << endl;
+    cerr << "odr-fic-sim [-n frames] [-s scheduler[,scheduler...]] <config>" << endl << endl;
+
+    cerr << "Where" << endl;
+    cerr << " <config> is an ODR-DabMux configuration file, .mux or .json." << endl << endl;
+    cerr << " -n frames     Number of ETI frames to simulate (default " << DEFAULT_NUM_FRAMES << ")." << endl;
+    cerr << " -s scheduler  FIC schedulers to run: classic, classic-rate-tuning, priority, edf." << endl;
+    cerr << "               Default: all of them." << endl << endl;
+
+    cerr << "The inputs are not opened, the subchannels use the configured bitrates." << endl;
+    cerr << "For every FIG, the report shows the number of complete cycles, the average" << endl;
+    cerr << "and maximum time between two cycle completions, and how many of these" << endl;
+    cerr << "were longer than the repetition rate of the FIG." << endl;
+    cerr << "The distribution of the unused bytes per FIB shows how much a better" << endl;
+    cerr << "packing of the FIGs into the FIBs could gain." << endl;
+}
+
+/* Statistics for one FIG instance */
+struct fig_stats_t {
+    string name;
+    FIC::FIG_rate rate = FIC::FIG_rate::A;
+    uint64_t bytes = 0;
+    uint64_t cycles = 0;
+    uint64_t late_cycles = 0;
+    uint64_t last_complete_ms = 0;
+    uint64_t total_cycle_ms = 0;
+    uint64_t max_cycle_ms = 0;
+};
+
+static const char* rate_to_string(FIC::FIG_rate rate)
+{
+    switch (rate) {
+        case FIC::FIG_rate::FIG0_0: return "0/0";
+        case FIC::FIG_rate::A: return "A";
+        case FIC::FIG_rate::A_B: return "A_B";
+        case FIC::FIG_rate::B: return "B";
+        case FIC::FIG_rate::C: return "C";
+        case FIC::FIG_rate::D: return "D";
+        case FIC::FIG_rate::E: return "E";
+    }
+    return "?";
+}
+
+/* The subchannel addresses and protection are set up by the multiplexer
+ * when it opens the inputs. The FIGs need them, and we take the configured
+ * bitrates instead. */
+static void prepare_subchannels(shared_ptr<dabEnsemble>& ensemble)
+{
+    for (auto subchannel = ensemble->subchannels.begin();
+            subchannel != ensemble->subchannels.end();
+            ++subchannel) {
+        if (subchannel == ensemble->subchannels.begin()) {
+            (*subchannel)->startAddress = 0;
+        }
+        else {
+            (*subchannel)->startAddress = (*(subchannel - 1))->startAddress +
+                (*(subchannel - 1))->getSizeCu();
+        }
+        (*subchannel)->select_protection_form();
+    }
+}
+
+static void simulate(
+        boost::property_tree::ptree& pt,
+        FIC::FIGSchedulerType scheduler_type,
+        uint64_t num_frames)
+{
+    auto ensemble = make_shared<dabEnsemble>();
+    parse_ptree(pt, ensemble);
+    prepare_subchannels(ensemble);
+
+    const bool fib3_present = (ensemble->transmission_mode == TransmissionMode_e::TM_III);
+    const int num_fibs = fib3_present ? 4 : 3;
+
+    // Simulated time, starting now
+    const time_t start_time = time(nullptr);
+    uint64_t now_ms = 0;
+    auto time_func = [&]() {
+        return FIC::FIGRuntimeInformation::dab_time_t(
+                now_ms % 1000, start_time + now_ms / 1000);
+    };
+
+    map<const FIC::IFIG*, fig_stats_t> stats;
+    auto observer = [&](const FIC::IFIG& fig, const FIC::FillStatus& status) {
+        auto& s = stats[&fig];
+        s.bytes += status.num_bytes_written;
+        if (status.complete_fig_transmitted) {
+            const uint64_t cycle_ms = now_ms - s.last_complete_ms;
+            s.last_complete_ms = now_ms;
+            s.cycles++;
+            s.total_cycle_ms += cycle_ms;
+            s.max_cycle_ms = std::max(s.max_cycle_ms, cycle_ms);
+            if (cycle_ms > (uint64_t)FIC::rate_increment_ms(fig.repetition_rate())) {
+                s.late_cycles++;
+            }
+        }
+        if (s.name.empty()) {
+            s.name = fig.name();
+        }
+        s.rate = fig.repetition_rate();
+    };
+
+    optional<FIC::FIGCarousel> classic;
+    optional<FIC::FIGCarouselPriority> priority;
+    optional<FIC::FIGCarouselEDF> edf;
+
+    switch (scheduler_type) {
+        case FIC::FIGSchedulerType::Classic:
+        case FIC::FIGSchedulerType::ClassicRateTuning:
+            classic.emplace(ensemble, time_func,
+                    scheduler_type == FIC::FIGSchedulerType::ClassicRateTuning);
+            classic->set_rate_correction(pt.get<double>("general.fic-repetition-correction", 1.0));
+            classic->set_fill_observer(observer);
+            break;
+        case FIC::FIGSchedulerType::Priority:
+            priority.emplace(ensemble, time_func);
+            priority->set_fill_observer(observer);
+            break;
+        case FIC::FIGSchedulerType::EDF:
+            edf.emplace(ensemble, time_func);
+            edf->set_fill_observer(observer);
+            break;
+    }
+
+    vector<uint8_t> fibs(32 * num_fibs);
+    uint64_t used_bytes = 0;
+    size_t min_frame_used = FIC::FICFillStats::fib_data_size * num_fibs;
+
+    // Number of FIBs per count of unused bytes
+    vector<uint64_t> padding_histogram(FIC::FICFillStats::fib_data_size + 1);
+
+    chrono::nanoseconds total_duration(0);
+    chrono::nanoseconds max_duration(0);
+
+    for (uint64_t frame = 0; frame < num_frames; frame++) {
+        const auto t0 = chrono::steady_clock::now();
+        FIC::FICFillStats fill;
+        if (classic) {
+            classic->write_fibs(fibs.data(), frame, fib3_present);
+            fill = classic->last_frame_stats();
+        }
+        else if (priority) {
+            priority->write_fibs(fibs.data(), frame, fib3_present);
+            fill = priority->last_frame_stats();
+        }
+        else if (edf) {
+            edf->write_fibs(fibs.data(), frame, fib3_present);
+            fill = edf->last_frame_stats();
+        }
+        const auto duration = chrono::steady_clock::now() - t0;
+
+        total_duration += duration;
+        max_duration = std::max<chrono::nanoseconds>(max_duration, duration);
+        used_bytes += fill.used();
+        min_frame_used = std::min(min_frame_used, fill.used());
+        for (size_t fib = 0; fib < fill.num_fibs; fib++) {
+            padding_histogram[FIC::FICFillStats::fib_data_size - fill.fib_used[fib]]++;
+        }
+        now_ms += FRAME_DURATION_MS;
+    }
+
+    // Sort the FIGs by type and extension
+    vector<const fig_stats_t*> sorted;
+    for (const auto& s : stats) {
+        if (s.second.bytes > 0) {
+            sorted.push_back(&s.second);
+        }
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+            [](const fig_stats_t* a, const fig_stats_t* b) {
+                int at, ae, bt, be;
+                sscanf(a->name.c_str(), "%d/%d", &at, &ae);
+                sscanf(b->name.c_str(), "%d/%d", &bt, &be);
+                return make_pair(at, ae) < make_pair(bt, be);
+            });
+
+    cout << "Scheduler " << FIC::scheduler_type_to_string(scheduler_type) <<
+        ": " << num_frames << " frames, " <<
+        num_frames * FRAME_DURATION_MS / 1000 << " s" << endl;
+    const double capacity = num_frames * num_fibs * FIC::FICFillStats::fib_data_size;
+    cout << "  FIB fill " << fixed << setprecision(1) <<
+        100.0 * used_bytes / capacity << "%" <<
+        " (worst frame " << 100.0 * min_frame_used /
+        (num_fibs * FIC::FICFillStats::fib_data_size) << "%)" <<
+        ", write_fibs " << total_duration.count() / num_frames << " ns/frame" <<
+        " (max " << max_duration.count() << " ns)" << endl;
+
+    cout << "  Unused bytes per FIB:";
+    for (size_t padding = 0; padding < padding_histogram.size(); padding++) {
+        if (padding_histogram[padding] > 0) {
+            cout << " " << padding << ": " <<
+                100.0 * padding_histogram[padding] / (num_frames * num_fibs) << "%";
+        }
+    }
+    cout << endl;
+
+    cout << "  FIG   rate  nominal ms    cycles    avg ms    max ms      late    bytes/s" << endl;
+    for (const auto* s : sorted) {
+        cout << "  " << left << setw(5) << s->name << " " << setw(4) <<
+            rate_to_string(s->rate) << right <<
+            setw(11) << FIC::rate_increment_ms(s->rate) <<
+            setw(10) << s->cycles <<
+            setw(10) << (s->cycles ? s->total_cycle_ms / s->cycles : 0) <<
+            setw(10) << s->max_cycle_ms <<
+            setw(10) << s->late_cycles <<
+            setw(11) << s->bytes * 1000 / (num_frames * FRAME_DURATION_MS) << endl;
+    }
+    cout << endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 and strcmp(argv[1], "--version") == 0) {
+        fprintf(stdout, "%s\n",
+#if defined(GITVERSION)
+                GITVERSION
+#else
+                PACKAGE_VERSION
+#endif
+               );
+        return 0;
+    }
+
+    uint64_t num_frames = DEFAULT_NUM_FRAMES;
+    vector<FIC::FIGSchedulerType> schedulers;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (ch) {
+            case 'n':
+                try {
+                    num_frames = stoull(optarg);
+                }
+                catch (const logic_error&) {
+                    num_frames = 0;
+                }
+                if (num_frames == 0) {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 's':
+                {
+                    stringstream ss(optarg);
+                    string name;
+                    while (getline(ss, name, ',')) {
+                        const auto type = FIC::parse_scheduler_type(name);
+                        if (FIC::scheduler_type_to_string(type) != name) {
+                            cerr << "Unknown scheduler " << name << endl;
+                            return 1;
+                        }
+                        schedulers.push_back(type);
+                    }
+                }
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        usage();
+        return 1;
+    }
+
+    if (schedulers.empty()) {
+        schedulers = {
+            FIC::FIGSchedulerType::Classic,
+            FIC::FIGSchedulerType::ClassicRateTuning,
+            FIC::FIGSchedulerType::Priority,
+            FIC::FIGSchedulerType::EDF };
+    }
+
+    const string conf_file = argv[optind];
+    boost::property_tree::ptree pt;
+
+    try {
+        if (stringEndsWith(conf_file, ".json")) {
+            read_json(conf_file, pt);
+        }
+        else {
+            read_info(conf_file, pt);
+        }
+
+        for (const auto type : schedulers) {
+            simulate(pt, type, num_frames);
+        }
+    }
+    catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
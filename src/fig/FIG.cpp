@@ -29,6 +29,29 @@
 
 namespace FIC {
 
+bool FIGEntryCache::stale(size_t num_elements) const
+{
+    return not m_valid or
+        m_generation != ensemble_config_generation() or
+        size() != num_elements;
+}
+
+void FIGEntryCache::clear()
+{
+    m_generation = ensemble_config_generation();
+    m_valid = true;
+    m_data.clear();
+    m_offsets.resize(1);
+}
+
+uint8_t* FIGEntryCache::add(size_t length)
+{
+    const size_t offset = m_data.size();
+    m_data.resize(offset + length, 0);
+    m_offsets.push_back(offset + length);
+    return m_data.data() + offset;
+}
+
 const std::string IFIG::name() const
 {
     std::stringstream ss;
@@ -30,13 +30,18 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
+#include <vector>
 #include "MuxElements.h"
 
 namespace FIC {
 
 #define PACKED __attribute__ ((packed))
 
+class IFIG;
+struct FillStatus;
+
 class FIGRuntimeInformation {
     public:
 
@@ -55,6 +60,17 @@ class FIGRuntimeInformation {
         unsigned long currentFrame;
         std::shared_ptr<dabEnsemble> ensemble;
         bool factumAnalyzer;
+
+        /* The FIG carousels call notify_fill() after every fill() of a FIG.
+         * odr-fic-sim uses this to measure the repetition rates. */
+        using fill_observer_t = std::function<void(const IFIG&, const FillStatus&)>;
+        fill_observer_t fill_observer;
+
+        void notify_fill(const IFIG& fig, const FillStatus& status) const {
+            if (fill_observer) {
+                fill_observer(fig, status);
+            }
+        }
         
         /* Phase-lock mechanism for FIG 0/2 and FIG 1/1 synchronisation.
          *
@@ -142,6 +158,61 @@ struct FillStatus
     bool   complete_fig_transmitted;
 };
 
+/* How many bytes of the FIBs of one frame the FIC scheduler could fill.
+ * The remaining bytes of each FIB are padding. */
+struct FICFillStats
+{
+    // Space available to FIGs in one FIB
+    static constexpr size_t fib_data_size = 30;
+
+    size_t num_fibs = 0;
+    std::array<size_t, 4> fib_used = {};
+
+    size_t capacity() const { return num_fibs * fib_data_size; }
+
+    size_t used() const {
+        size_t total = 0;
+        for (size_t i = 0; i < num_fibs; i++) {
+            total += fib_used[i];
+        }
+        return total;
+    }
+};
+
+/* Encoded entries of a FIG, kept until the configuration of the ensemble
+ * changes. An entry is the part of a FIG describing one element of the
+ * ensemble (a subchannel, a service and its components, a label), which is
+ * never split over two FIGs. The FIG adds one entry per element, in the
+ * order of the ensemble vector; an empty entry means that the element is
+ * not transmitted. fill() then only has to add the FIG headers and copy the
+ * entries that fit.
+ */
+class FIGEntryCache
+{
+    public:
+        /* True if the entries must be encoded again, because the
+         * configuration changed since clear() was called, or because
+         * the number of elements is different. */
+        bool stale(size_t num_elements) const;
+
+        /* Remove all entries, and remember the configuration generation */
+        void clear();
+
+        /* Append an entry of length bytes, and return the zeroed buffer into
+         * which it must be encoded. It is valid until the next call to add() */
+        uint8_t* add(size_t length);
+
+        size_t size() const { return m_offsets.size() - 1; }
+        size_t length(size_t ix) const { return m_offsets[ix + 1] - m_offsets[ix]; }
+        const uint8_t* data(size_t ix) const { return m_data.data() + m_offsets[ix]; }
+
+    private:
+        std::vector<uint8_t> m_data;
+        std::vector<size_t> m_offsets = {0};
+        bool m_valid = false;
+        uint64_t m_generation = 0;
+};
+
 class IFIG
 {
     public:
@@ -91,6 +91,55 @@ FIG0_1::FIG0_1(FIGRuntimeInformation *rti) :
     m_watermarkPos = 0;
 }
 
+void FIG0_1::encode_entries()
+{
+    const auto& subchannels = m_rti->ensemble->subchannels;
+    m_entries.clear();
+
+    for (const auto& subchannel : subchannels) {
+        const dabProtection& protection = subchannel->protection;
+
+        if (protection.form == UEP) {
+            auto fig0_1subchShort =
+                (FIGtype0_1_SubChannel_ShortF*)m_entries.add(3);
+            fig0_1subchShort->SubChId = subchannel->id;
+
+            fig0_1subchShort->StartAdress_high =
+                subchannel->startAddress / 256;
+            fig0_1subchShort->StartAdress_low =
+                subchannel->startAddress % 256;
+
+            fig0_1subchShort->Short_Long_form = 0;
+            fig0_1subchShort->TableSwitch = 0;
+            fig0_1subchShort->TableIndex =
+                protection.uep.tableIndex;
+        }
+        else if (protection.form == EEP) {
+            auto fig0_1subchLong1 =
+                (FIGtype0_1_SubChannel_LongF*)m_entries.add(4);
+            fig0_1subchLong1->SubChId = subchannel->id;
+
+            fig0_1subchLong1->StartAdress_high =
+                subchannel->startAddress / 256;
+            fig0_1subchLong1->StartAdress_low =
+                subchannel->startAddress % 256;
+
+            fig0_1subchLong1->Short_Long_form = 1;
+            fig0_1subchLong1->Option = protection.eep.GetOption();
+            fig0_1subchLong1->ProtectionLevel =
+                protection.level;
+
+            fig0_1subchLong1->Sub_ChannelSize_high =
+                subchannel->getSizeCu() / 256;
+            fig0_1subchLong1->Sub_ChannelSize_low =
+                subchannel->getSizeCu() % 256;
+        }
+        else {
+            m_entries.add(0);
+        }
+    }
+}
+
 FillStatus FIG0_1::fill(uint8_t *buf, size_t max_size)
 {
 #define FIG0_1_TRACE discard
@@ -101,20 +150,20 @@ FillStatus FIG0_1::fill(uint8_t *buf, size_t max_size)
     etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill initialised=" <<
         (m_initialised ? 1 : 0) << " max_size=" << max_size;
 
-    const int watermark_bit = (m_watermarkData[m_watermarkPos >> 3] >>
-            (7 - (m_watermarkPos & 0x07))) & 1;
-
-    const bool iterate_forward = (watermark_bit == 1);
+    const size_t num_subchannels = m_rti->ensemble->subchannels.size();
 
     if (not m_initialised) {
         m_initialised = true;
 
-        subchannels = m_rti->ensemble->subchannels;
+        const int watermark_bit = (m_watermarkData[m_watermarkPos >> 3] >>
+                (7 - (m_watermarkPos & 0x07))) & 1;
 
-        if (not iterate_forward) {
-            std::reverse(subchannels.begin(), subchannels.end());
+        m_iterate_forward = (watermark_bit == 1);
+        m_position = 0;
+
+        if (m_entries.stale(num_subchannels)) {
+            encode_entries();
         }
-        subchannelFIG0_1 = subchannels.begin();
     }
 
     if (max_size < 6) {
@@ -125,20 +174,16 @@ FillStatus FIG0_1::fill(uint8_t *buf, size_t max_size)
 
     // Rotate through the subchannels until there is no more
     // space in the FIG0/1
-    for (; subchannelFIG0_1 != subchannels.end(); ++subchannelFIG0_1 ) {
-        size_t subch_iter_ix = std::distance(subchannels.begin(), subchannelFIG0_1);
-
-        etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill loop ix=" << subch_iter_ix <<
-            " of " << subchannels.size();
+    for (; m_position < m_entries.size(); ++m_position) {
+        const size_t ix = m_iterate_forward ?
+            m_position : m_entries.size() - 1 - m_position;
+        const size_t entry_length = m_entries.length(ix);
 
-        dabProtection* protection = &(*subchannelFIG0_1)->protection;
+        etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill loop ix=" << ix <<
+            " of " << m_entries.size();
 
         if (figtype0_1 == NULL) {
-            etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill header " <<
-                 (protection->form == UEP ? "UEP " : "EEP ") << remaining;
-
-            if ( (protection->form == UEP && remaining < 2 + 3) ||
-                 (protection->form == EEP && remaining < 2 + 4) ) {
+            if (remaining < 2 + entry_length) {
                 etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill no space for header";
                 break;
             }
@@ -154,72 +199,22 @@ FillStatus FIG0_1::fill(uint8_t *buf, size_t max_size)
             buf += 2;
             remaining -= 2;
         }
-        else if ( (protection->form == UEP && remaining < 3) ||
-             (protection->form == EEP && remaining < 4) ) {
+        else if (remaining < entry_length) {
             etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill no space for fig " <<
-                 (protection->form == UEP ? "UEP " : "EEP ") << remaining;
+                entry_length << " " << remaining;
             break;
         }
 
-        if (protection->form == UEP) {
-            FIGtype0_1_SubChannel_ShortF *fig0_1subchShort =
-                (FIGtype0_1_SubChannel_ShortF*)buf;
-            fig0_1subchShort->SubChId = (*subchannelFIG0_1)->id;
-
-            fig0_1subchShort->StartAdress_high =
-                (*subchannelFIG0_1)->startAddress / 256;
-            fig0_1subchShort->StartAdress_low =
-                (*subchannelFIG0_1)->startAddress % 256;
-
-            fig0_1subchShort->Short_Long_form = 0;
-            fig0_1subchShort->TableSwitch = 0;
-            fig0_1subchShort->TableIndex =
-                protection->uep.tableIndex;
-
-            buf += 3;
-            remaining -= 3;
-            figtype0_1->Length += 3;
-
-            etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill insert UEP id=" <<
-               (int)fig0_1subchShort->SubChId << " rem=" << remaining
-               << " ix=" << subch_iter_ix;
-        }
-        else if (protection->form == EEP) {
-            FIGtype0_1_SubChannel_LongF *fig0_1subchLong1 =
-                (FIGtype0_1_SubChannel_LongF*)buf;
-            fig0_1subchLong1->SubChId = (*subchannelFIG0_1)->id;
-
-            fig0_1subchLong1->StartAdress_high =
-                (*subchannelFIG0_1)->startAddress / 256;
-            fig0_1subchLong1->StartAdress_low =
-                (*subchannelFIG0_1)->startAddress % 256;
-
-            fig0_1subchLong1->Short_Long_form = 1;
-            fig0_1subchLong1->Option = protection->eep.GetOption();
-            fig0_1subchLong1->ProtectionLevel =
-                protection->level;
-
-            fig0_1subchLong1->Sub_ChannelSize_high =
-                (*subchannelFIG0_1)->getSizeCu() / 256;
-            fig0_1subchLong1->Sub_ChannelSize_low =
-                (*subchannelFIG0_1)->getSizeCu() % 256;
-
-            buf += 4;
-            remaining -= 4;
-            figtype0_1->Length += 4;
-
-            etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill insert EEP id=" <<
-               (int)fig0_1subchLong1->SubChId << " rem=" << remaining
-               << " ix=" << subch_iter_ix;
-        }
+        memcpy(buf, m_entries.data(ix), entry_length);
+        buf += entry_length;
+        remaining -= entry_length;
+        figtype0_1->Length += entry_length;
     }
 
-    size_t subch_iter_ix = std::distance(subchannels.begin(), subchannelFIG0_1);
-
     etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill loop out, rem=" << remaining
-        << " ix=" << subch_iter_ix;
+        << " pos=" << m_position;
 
-    if (subchannelFIG0_1 == subchannels.end()) {
+    if (m_position == m_entries.size()) {
         etiLog.level(FIG0_1_TRACE) << "FIG0_1::fill completed, rem=" << remaining;
         m_initialised = false;
         fs.complete_fig_transmitted = true;
@@ -43,10 +43,16 @@ class FIG0_1 : public IFIG
         virtual int figextension() const { return 1; }
 
     private:
+        void encode_entries();
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
-        vec_sp_subchannel           subchannels;
-        vec_sp_subchannel::iterator subchannelFIG0_1;
+
+        // One entry per subchannel. The watermark selects the order in
+        // which they are transmitted.
+        FIGEntryCache m_entries;
+        bool m_iterate_forward = true;
+        size_t m_position = 0;
 
         uint8_t m_watermarkData[128];
         size_t  m_watermarkSize;
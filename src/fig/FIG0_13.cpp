@@ -60,173 +60,188 @@ FIG0_13::FIG0_13(FIGRuntimeInformation *rti) :
 {
 }
 
-FillStatus FIG0_13::fill(uint8_t *buf, size_t max_size)
+void FIG0_13::encode_entries(FIGEntryCache& entries, bool programme)
 {
-    FillStatus fs;
     auto ensemble = m_rti->ensemble;
-    ssize_t remaining = max_size;
-
-    if (not m_initialised) {
-        componentFIG0_13 = m_rti->ensemble->components.end();
-        m_initialised = true;
-    }
-
-    FIGtype0* fig0 = NULL;
-
-    for (; componentFIG0_13 != ensemble->components.end();
-            ++componentFIG0_13) {
+    entries.clear();
 
+    for (const auto& component : ensemble->components) {
         auto subchannel = getSubchannel(ensemble->subchannels,
-                (*componentFIG0_13)->subchId);
+                component->subchId);
 
         if (subchannel == ensemble->subchannels.end()) {
             etiLog.log(error,
                     "Subchannel %i does not exist for component "
                     "of service %i",
-                    (*componentFIG0_13)->subchId,
-                    (*componentFIG0_13)->serviceId);
+                    component->subchId,
+                    component->serviceId);
+            entries.add(0);
             continue;
         }
 
         const auto type = (*subchannel)->type;
-        if (   (m_transmit_programme and
-                (type == subchannel_type_t::DABPlusAudio or type == subchannel_type_t::DABAudio) and
-                (*componentFIG0_13)->audio.uaTypes.size() != 0)
-            or (not m_transmit_programme and
-                (*subchannel)->type == subchannel_type_t::Packet and
-                (*componentFIG0_13)->packet.uaTypes.size() != 0)) {
-
-            const std::vector<userApplication>& uaTypes = m_transmit_programme ?
-                (*componentFIG0_13)->audio.uaTypes : (*componentFIG0_13)->packet.uaTypes;
-
-            const size_t num_apps = uaTypes.size();
-
-            static_assert(sizeof(FIG0_13_shortAppInfo) == 3);
-            static_assert(sizeof(FIG0_13_longAppInfo) == 5);
-            static_assert(sizeof(FIG0_13_app) == 2);
-
-            size_t xpaddata_length = 0;
-            int required_size = 0;
-            if (m_transmit_programme) {
-                required_size += sizeof(FIG0_13_shortAppInfo);
-                xpaddata_length = 2; // CAOrg is always absent
+        if (not (  (programme and
+                    (type == subchannel_type_t::DABPlusAudio or type == subchannel_type_t::DABAudio) and
+                    component->audio.uaTypes.size() != 0)
+                or (not programme and
+                    (*subchannel)->type == subchannel_type_t::Packet and
+                    component->packet.uaTypes.size() != 0))) {
+            entries.add(0);
+            continue;
+        }
+
+        const std::vector<userApplication>& uaTypes = programme ?
+            component->audio.uaTypes : component->packet.uaTypes;
+
+        const size_t num_apps = uaTypes.size();
+
+        static_assert(sizeof(FIG0_13_shortAppInfo) == 3);
+        static_assert(sizeof(FIG0_13_longAppInfo) == 5);
+        static_assert(sizeof(FIG0_13_app) == 2);
+
+        size_t xpaddata_length = 0;
+        size_t required_size = 0;
+        if (programme) {
+            required_size += sizeof(FIG0_13_shortAppInfo);
+            xpaddata_length = 2; // CAOrg is always absent
+        }
+        else {
+            required_size += sizeof(FIG0_13_longAppInfo);
+            xpaddata_length = 0; // X-PAD data field is absent
+        }
+
+        for (const auto& ua : uaTypes) {
+            required_size += sizeof(FIG0_13_app) + xpaddata_length;
+
+            if (ua.uaType == FIG0_13_APPTYPE_SPI) {
+                required_size += 1;
             }
-            else {
-                required_size += sizeof(FIG0_13_longAppInfo);
-                xpaddata_length = 0; // X-PAD data field is absent
+            else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE ||
+                     ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
+                required_size += 2;
             }
+        }
 
-            for (const auto& ua : uaTypes) {
-                required_size += sizeof(FIG0_13_app) + xpaddata_length;
+        uint8_t *buf = entries.add(required_size);
 
-                if (ua.uaType == FIG0_13_APPTYPE_SPI) {
-                    required_size += 1;
-                }
-                else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE ||
-                         ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
-                    required_size += 2;
-                }
+        if (programme) {
+            FIG0_13_shortAppInfo* info = (FIG0_13_shortAppInfo*)buf;
+            info->SId = htonl(component->serviceId) >> 16;
+            info->SCIdS = component->SCIdS;
+            info->No = num_apps;
+            buf += sizeof(FIG0_13_shortAppInfo);
+        }
+        else {
+            FIG0_13_longAppInfo* info = (FIG0_13_longAppInfo*)buf;
+            info->SId = htonl(component->serviceId);
+            info->SCIdS = component->SCIdS;
+            info->No = num_apps;
+            buf += sizeof(FIG0_13_longAppInfo);
+        }
+
+        for (const auto& ua : uaTypes) {
+            FIG0_13_app* app = (FIG0_13_app*)buf;
+            app->setType(ua.uaType);
+            app->length = xpaddata_length;
+            if (ua.uaType == FIG0_13_APPTYPE_SPI) {
+                app->length += 1;
+            }
+            else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE ||
+                     ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
+                app->length += 2;
             }
 
-            if (fig0 == NULL) {
-                if (remaining < 2 + required_size) {
-                    break;
-                }
-                fig0 = (FIGtype0*)buf;
-                fig0->FIGtypeNumber = 0;
-                fig0->Length = 1;
-                fig0->CN = 0;
-                fig0->OE = 0;
-                fig0->PD = m_transmit_programme ? 0 : 1;
-                fig0->Extension = 13;
+            buf += sizeof(FIG0_13_app);
+
+            if (programme) {
+                const uint8_t dscty = 60; // TS 101 756 Table 2b (MOT)
+                const uint16_t xpadapp = htons((ua.xpadAppType << 8) | dscty);
+                /* xpad meaning
+                   CA        = 0
+                   CAOrg     = 0 (CAOrg field absent)
+                   Rfu       = 0
+                   AppTy(5)  = depending on config
+                   DG        = 0 (MSC data groups used)
+                   Rfu       = 0
+                   DSCTy(6)  = 60 (MOT)
+                   */
+
+                memcpy(buf, &xpadapp, 2);
                 buf += 2;
-                remaining -= 2;
-            }
-            else if (remaining < required_size) {
-                break;
             }
 
-            if (m_transmit_programme) {
-                FIG0_13_shortAppInfo* info = (FIG0_13_shortAppInfo*)buf;
-                info->SId = htonl((*componentFIG0_13)->serviceId) >> 16;
-                info->SCIdS = (*componentFIG0_13)->SCIdS;
-                info->No = num_apps;
-                buf += sizeof(FIG0_13_shortAppInfo);
-                remaining -= sizeof(FIG0_13_shortAppInfo);
-                fig0->Length += sizeof(FIG0_13_shortAppInfo);
+            if (ua.uaType == FIG0_13_APPTYPE_SPI) {
+                buf[0] = 0x01; // = basic profile
+                buf += 1;
             }
-            else {
-                FIG0_13_longAppInfo* info = (FIG0_13_longAppInfo*)buf;
-                info->SId = htonl((*componentFIG0_13)->serviceId);
-                info->SCIdS = (*componentFIG0_13)->SCIdS;
-                info->No = num_apps;
-                buf += sizeof(FIG0_13_longAppInfo);
-                remaining -= sizeof(FIG0_13_longAppInfo);
-                fig0->Length += sizeof(FIG0_13_longAppInfo);
+            else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE) {
+                buf[0] = 0x01; // = basic integrated receiver profile
+                buf[1] = 0xFF; // = unrestricted (PC) profile
+                buf += 2;
+            }
+            else if (ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
+                // According to ETSI TS 102 979 Clause 8.1.2
+                buf[0] = 0x00;
+                buf[1] = 0x00;
+                buf += 2;
             }
+        }
+    }
+}
+
+FillStatus FIG0_13::fill(uint8_t *buf, size_t max_size)
+{
+    FillStatus fs;
+    auto ensemble = m_rti->ensemble;
+    ssize_t remaining = max_size;
+
+    const size_t num_components = ensemble->components.size();
 
-            for (const auto& ua : uaTypes) {
-                FIG0_13_app* app = (FIG0_13_app*)buf;
-                app->setType(ua.uaType);
-                app->length = xpaddata_length;
-                if (ua.uaType == FIG0_13_APPTYPE_SPI) {
-                    app->length += 1;
-                }
-                else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE ||
-                         ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
-                    app->length += 2;
-                }
-
-                buf += sizeof(FIG0_13_app);
-                remaining -= sizeof(FIG0_13_app);
-                fig0->Length += sizeof(FIG0_13_app);
-
-                if (m_transmit_programme) {
-                    const uint8_t dscty = 60; // TS 101 756 Table 2b (MOT)
-                    const uint16_t xpadapp = htons((ua.xpadAppType << 8) | dscty);
-                    /* xpad meaning
-                       CA        = 0
-                       CAOrg     = 0 (CAOrg field absent)
-                       Rfu       = 0
-                       AppTy(5)  = depending on config
-                       DG        = 0 (MSC data groups used)
-                       Rfu       = 0
-                       DSCTy(6)  = 60 (MOT)
-                       */
-
-                    memcpy(buf, &xpadapp, 2);
-                    buf += 2;
-                    remaining -= 2;
-                    fig0->Length += 2;
-                }
-
-                if (ua.uaType == FIG0_13_APPTYPE_SPI) {
-                    buf[0] = 0x01; // = basic profile
-                    buf += 1;
-                    remaining -= 1;
-                    fig0->Length += 1;
-                }
-                else if (ua.uaType == FIG0_13_APPTYPE_WEBSITE) {
-                    buf[0] = 0x01; // = basic integrated receiver profile
-                    buf[1] = 0xFF; // = unrestricted (PC) profile
-                    buf += 2;
-                    remaining -= 2;
-                    fig0->Length += 2;
-                }
-                else if (ua.uaType == FIG0_13_APPTYPE_JOURNALINE) {
-                    // According to ETSI TS 102 979 Clause 8.1.2
-                    buf[0] = 0x00;
-                    buf[1] = 0x00;
-                    buf += 2;
-                    remaining -= 2;
-                    fig0->Length += 2;
-                }
+    if (not m_initialised) {
+        m_position = num_components;
+        m_initialised = true;
+    }
+
+    auto& entries = m_transmit_programme ? m_programme_entries : m_data_entries;
+    if (entries.stale(num_components)) {
+        encode_entries(entries, m_transmit_programme);
+        m_position = std::min(m_position, num_components);
+    }
+
+    FIGtype0* fig0 = NULL;
+
+    for (; m_position < num_components; ++m_position) {
+        const ssize_t required_size = entries.length(m_position);
+        if (required_size == 0) {
+            continue;
+        }
+
+        if (fig0 == NULL) {
+            if (remaining < 2 + required_size) {
+                break;
             }
+            fig0 = (FIGtype0*)buf;
+            fig0->FIGtypeNumber = 0;
+            fig0->Length = 1;
+            fig0->CN = 0;
+            fig0->OE = 0;
+            fig0->PD = m_transmit_programme ? 0 : 1;
+            fig0->Extension = 13;
+            buf += 2;
+            remaining -= 2;
+        }
+        else if (remaining < required_size) {
+            break;
         }
+
+        memcpy(buf, entries.data(m_position), required_size);
+        buf += required_size;
+        remaining -= required_size;
+        fig0->Length += required_size;
     }
 
-    if (componentFIG0_13 == ensemble->components.end()) {
-        componentFIG0_13 = ensemble->components.begin();
+    if (m_position == num_components) {
+        m_position = 0;
 
         // The full database is sent every second full loop
         fs.complete_fig_transmitted = m_transmit_programme;
@@ -44,10 +44,16 @@ class FIG0_13 : public IFIG
         virtual int figextension() const { return 13; }
 
     private:
+        void encode_entries(FIGEntryCache& entries, bool programme);
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
         bool m_transmit_programme;
-        vec_sp_component::iterator componentFIG0_13;
+
+        // One entry per component, for PD=0 and PD=1
+        FIGEntryCache m_programme_entries;
+        FIGEntryCache m_data_entries;
+        size_t m_position = 0;
 };
 
 }
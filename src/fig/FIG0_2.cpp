@@ -96,160 +96,70 @@ FIG0_2::FIG0_2(FIGRuntimeInformation *rti) :
 {
 }
 
-FillStatus FIG0_2::fill(uint8_t *buf, size_t max_size)
+void FIG0_2::encode_entries()
 {
-#define FIG0_2_TRACE discard
     using namespace std;
 
-    FillStatus fs;
-    FIGtype0_2 *fig0_2 = NULL;
-    int cur = 0;
-    ssize_t remaining = max_size;
-
     const auto ensemble = m_rti->ensemble;
 
-    etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill init " << (m_initialised ? 1 : 0) <<
-        " ********************************";
-
-    if (not m_initialised) {
-        m_audio_services.clear();
-        copy_if(ensemble->services.begin(),
-                ensemble->services.end(),
-                back_inserter(m_audio_services),
-                [&](shared_ptr<DabService>& s) {
-                    return s->isProgramme(ensemble);
-                } );
-
-        m_data_services.clear();
-        copy_if(ensemble->services.begin(),
-                ensemble->services.end(),
-                back_inserter(m_data_services),
-                [&](shared_ptr<DabService>& s) {
-                    return not s->isProgramme(ensemble);
-                } );
-
-        m_initialised = true;
-        m_inserting_audio_not_data = !m_inserting_audio_not_data;
-
-        if (m_inserting_audio_not_data) {
-            serviceFIG0_2 = m_audio_services.begin();
-        }
-        else {
-            serviceFIG0_2 = m_data_services.begin();
-        }
-
-        etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill we have " <<
-            m_audio_services.size() << " audio and " <<
-            m_data_services.size() << " data services. Inserting " <<
-            (m_inserting_audio_not_data ? "AUDIO" : "DATA");
-    }
-
-    const auto last_service = m_inserting_audio_not_data ?
-            m_audio_services.end() : m_data_services.end();
+    m_entries.clear();
+    m_audio_services.clear();
+    m_data_services.clear();
 
-    // Rotate through the subchannels until there is no more
-    // space
-    for (; serviceFIG0_2 != last_service; ++serviceFIG0_2) {
-        
-        const auto type = (*serviceFIG0_2)->getType(ensemble);
-        const auto isProgramme = (*serviceFIG0_2)->isProgramme(ensemble);
-
-        etiLog.log(FIG0_2_TRACE, "FIG0_2::fill  loop SId=%04x %s/%s",
-                (*serviceFIG0_2)->id,
-                m_inserting_audio_not_data ? "AUDIO" : "DATA",
-                type == subchannel_type_t::DABPlusAudio ? "DABPlusAudio" :
-                type == subchannel_type_t::DABAudio ? "DABAudio" :
-                type == subchannel_type_t::Packet ? "Packet" :
-                type == subchannel_type_t::DataDmb ? "DataDmb" : "?");
+    for (size_t ix = 0; ix < ensemble->services.size(); ix++) {
+        const auto& service = ensemble->services[ix];
 
         // filter out services which have no components
-        if ((*serviceFIG0_2)->nbComponent(ensemble->components) == 0) {
-            etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  no components ";
+        const auto num_components = service->nbComponent(ensemble->components);
+        if (num_components == 0) {
+            m_entries.add(0);
             continue;
         }
 
-        ++cur;
-
-        const int required_size = isProgramme ?
-            3 + 2 * (*serviceFIG0_2)->nbComponent(ensemble->components) :
-            5 + 2 * (*serviceFIG0_2)->nbComponent(ensemble->components);
-
-        if (fig0_2 == NULL) {
-            etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  header";
-            if (remaining < 2 + required_size) {
-                etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  header no place" <<
-                    " rem=" << remaining << " req=" << 2 + required_size;
-                break;
-            }
-            fig0_2 = (FIGtype0_2 *)buf;
+        const auto type = service->getType(ensemble);
+        const bool isProgramme = service->isProgramme(ensemble);
 
-            fig0_2->FIGtypeNumber = 0;
-            fig0_2->Length = 1;
-            fig0_2->CN = 0;
-            fig0_2->OE = 0;
-            fig0_2->PD = isProgramme ? 0 : 1;
-            fig0_2->Extension = 2;
-            buf += 2;
-            remaining -= 2;
+        if (isProgramme) {
+            m_audio_services.push_back(ix);
         }
-        else if (remaining < required_size) {
-            etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  no place" <<
-                " rem=" << remaining << " req=" << required_size;
-            break;
+        else {
+            m_data_services.push_back(ix);
         }
 
+        const size_t service_length = isProgramme ? 3 : 5;
+        vector<uint8_t> entry(service_length + 2 * num_components);
+        uint8_t *buf = entry.data();
+
         if (type == subchannel_type_t::DABPlusAudio or type == subchannel_type_t::DABAudio) {
             auto fig0_2serviceAudio = (FIGtype0_2_Service*)buf;
 
-            fig0_2serviceAudio->SId = htons((*serviceFIG0_2)->id);
+            fig0_2serviceAudio->SId = htons(service->id);
             fig0_2serviceAudio->Local_flag = 0;
             fig0_2serviceAudio->CAId = 0;
-            fig0_2serviceAudio->NbServiceComp =
-                (*serviceFIG0_2)->nbComponent(ensemble->components);
-            buf += 3;
-            fig0_2->Length += 3;
-            remaining -= 3;
-
-            etiLog.log(FIG0_2_TRACE, "FIG0_2::fill  audio SId=%04x",
-               (*serviceFIG0_2)->id);
-               
-            // Phase-lock: notify that we've announced a programme service
-            m_rti->on_fig0_2_service_sent();
+            fig0_2serviceAudio->NbServiceComp = num_components;
         }
         else {
             auto fig0_2serviceData = (FIGtype0_2_Service_data*)buf;
 
-            fig0_2serviceData->SId = htonl((*serviceFIG0_2)->id);
+            fig0_2serviceData->SId = htonl(service->id);
             fig0_2serviceData->Local_flag = 0;
             fig0_2serviceData->CAId = 0;
-            fig0_2serviceData->NbServiceComp =
-                (*serviceFIG0_2)->nbComponent(ensemble->components);
-            buf += 5;
-            fig0_2->Length += 5;
-            remaining -= 5;
-
-            etiLog.log(FIG0_2_TRACE, "FIG0_2::fill  data SId=%04x",
-               (*serviceFIG0_2)->id);
-            
-            // Note: Data services use FIG 1/5 for labels, not FIG 1/1
-            // So we don't increment the phase-lock counter for data services
+            fig0_2serviceData->NbServiceComp = num_components;
         }
+        buf += service_length;
 
         int curCpnt = 0;
         for (auto component = getComponent(
-                    ensemble->components, (*serviceFIG0_2)->id );
+                    ensemble->components, service->id );
                 component != ensemble->components.end();
                 component = getComponent(
                     ensemble->components,
-                    (*serviceFIG0_2)->id,
+                    service->id,
                     component )
             ) {
             auto subchannel = getSubchannel(
                     ensemble->subchannels, (*component)->subchId);
 
-            etiLog.log(FIG0_2_TRACE, "FIG0_2::fill     comp sub=%04x srv=%04x",
-                (*component)->subchId, (*component)->serviceId);
-
             if (subchannel == ensemble->subchannels.end()) {
                 etiLog.log(error,
                         "Subchannel %i does not exist for component "
@@ -260,15 +170,6 @@ FillStatus FIG0_2::fill(uint8_t *buf, size_t max_size)
 
             switch ((*subchannel)->type) {
                 case (subchannel_type_t::DABAudio):
-                    {
-                        auto audio_description = (FIGtype0_2_audio_component*)buf;
-                        audio_description->TMid    = 0;
-                        audio_description->ASCTy   = (*component)->type;
-                        audio_description->SubChId = (*subchannel)->id;
-                        audio_description->PS      = ((curCpnt == 0) ? 1 : 0);
-                        audio_description->CA_flag = 0;
-                    }
-                    break;
                 case (subchannel_type_t::DABPlusAudio):
                     {
                         auto audio_description = (FIGtype0_2_audio_component*)buf;
@@ -302,23 +203,87 @@ FillStatus FIG0_2::fill(uint8_t *buf, size_t max_size)
                     throw logic_error("Component type not supported");
             }
             buf += 2;
-            fig0_2->Length += 2;
-            remaining -= 2;
-            if (remaining < 0) {
-                etiLog.log(error,
-                        "Sorry, no space left in FIG 0/2 to insert "
-                        "component %i of program service %i.",
-                        curCpnt, cur);
-                throw MuxInitException();
-            }
             ++curCpnt;
+        }
+
+        const size_t entry_length = buf - entry.data();
+        memcpy(m_entries.add(entry_length), entry.data(), entry_length);
+    }
+}
+
+FillStatus FIG0_2::fill(uint8_t *buf, size_t max_size)
+{
+#define FIG0_2_TRACE discard
+    using namespace std;
+
+    FillStatus fs;
+    FIGtype0_2 *fig0_2 = NULL;
+    ssize_t remaining = max_size;
+
+    etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill init " << (m_initialised ? 1 : 0) <<
+        " ********************************";
+
+    if (not m_initialised) {
+        if (m_entries.stale(m_rti->ensemble->services.size())) {
+            encode_entries();
+        }
+
+        m_initialised = true;
+        m_inserting_audio_not_data = !m_inserting_audio_not_data;
+        m_position = 0;
+
+        etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill we have " <<
+            m_audio_services.size() << " audio and " <<
+            m_data_services.size() << " data services. Inserting " <<
+            (m_inserting_audio_not_data ? "AUDIO" : "DATA");
+    }
+
+    const auto& services = m_inserting_audio_not_data ?
+            m_audio_services : m_data_services;
+
+    // Rotate through the services until there is no more
+    // space
+    for (; m_position < services.size(); ++m_position) {
+        const size_t ix = services[m_position];
+        const ssize_t required_size = m_entries.length(ix);
+
+        if (fig0_2 == NULL) {
+            etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  header";
+            if (remaining < 2 + required_size) {
+                etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  header no place" <<
+                    " rem=" << remaining << " req=" << 2 + required_size;
+                break;
+            }
+            fig0_2 = (FIGtype0_2 *)buf;
+
+            fig0_2->FIGtypeNumber = 0;
+            fig0_2->Length = 1;
+            fig0_2->CN = 0;
+            fig0_2->OE = 0;
+            fig0_2->PD = m_inserting_audio_not_data ? 0 : 1;
+            fig0_2->Extension = 2;
+            buf += 2;
+            remaining -= 2;
+        }
+        else if (remaining < required_size) {
+            etiLog.level(FIG0_2_TRACE) << "FIG0_2::fill  no place" <<
+                " rem=" << remaining << " req=" << required_size;
+            break;
+        }
 
-            etiLog.log(FIG0_2_TRACE, "FIG0_2::fill     comp length=%d",
-                    fig0_2->Length);
+        memcpy(buf, m_entries.data(ix), required_size);
+        buf += required_size;
+        fig0_2->Length += required_size;
+        remaining -= required_size;
+
+        if (m_inserting_audio_not_data) {
+            // Phase-lock: notify that we've announced a programme service.
+            // Data services use FIG 1/5 for labels, not FIG 1/1
+            m_rti->on_fig0_2_service_sent();
         }
     }
 
-    if (serviceFIG0_2 == last_service) {
+    if (m_position == services.size()) {
         etiLog.log(FIG0_2_TRACE, "FIG0_2::loop reached last");
         m_initialised = false;
         fs.complete_fig_transmitted = !m_inserting_audio_not_data;
@@ -43,12 +43,19 @@ class FIG0_2 : public IFIG
         virtual int figextension() const { return 2; }
 
     private:
+        void encode_entries();
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
         bool m_inserting_audio_not_data;
-        vec_sp_service m_audio_services;
-        vec_sp_service m_data_services;
-        vec_sp_service::iterator serviceFIG0_2;
+
+        // One entry per service, with its components
+        FIGEntryCache m_entries;
+
+        // Index of the programme and data services with components
+        std::vector<size_t> m_audio_services;
+        std::vector<size_t> m_data_services;
+        size_t m_position = 0;
 };
 
 }
@@ -29,6 +29,8 @@
    along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cstring>
 #include "fig/FIG1.h"
 
 namespace FIC {
@@ -78,65 +80,83 @@ FillStatus FIG1_0::fill(uint8_t *buf, size_t max_size)
 
 //=========== FIG 1/1 ===========
 
+void FIG1_1::encode_entries()
+{
+    auto ensemble = m_rti->ensemble;
+    m_entries.clear();
+
+    for (const auto& service : ensemble->services) {
+        if (not (service->isProgramme(ensemble) and service->label.has_fig1_label())) {
+            m_entries.add(0);
+            continue;
+        }
+
+        uint8_t *buf = m_entries.add(4 + 16 + 2);
+        auto fig1_1 = (FIGtype1_1 *)buf;
+
+        fig1_1->FIGtypeNumber = 1;
+        fig1_1->Length = 21;
+        fig1_1->Charset = 0;
+        fig1_1->OE = 0;
+        fig1_1->Extension = 1;
+
+        fig1_1->Sld = htons(service->id);
+        buf += 4;
+
+        service->label.writeLabel(buf);
+        buf += 16;
+
+        buf[0] = service->label.flag() >> 8;
+        buf[1] = service->label.flag() & 0xFF;
+    }
+}
+
 FillStatus FIG1_1::fill(uint8_t *buf, size_t max_size)
 {
     FillStatus fs;
 
     ssize_t remaining = max_size;
-    
-    auto ensemble = m_rti->ensemble;
+
+    const size_t num_services = m_rti->ensemble->services.size();
 
     if (not m_initialised) {
-        service = ensemble->services.begin();
+        m_position = 0;
         m_initialised = true;
         // Reset phase-lock counters at start of new cycle
         // This synchronises 1/1 and 0/2 cycles
         m_rti->on_fig1_1_cycle_start();
+
+        if (m_entries.stale(num_services)) {
+            encode_entries();
+        }
     }
 
     // Rotate through the services until there is no more space
-    for (; service != ensemble->services.end(); ++service) {
+    for (; m_position < num_services; ++m_position) {
         if (remaining < 4 + 16 + 2) {
             break;
         }
 
-        const bool is_programme = (*service)->isProgramme(ensemble);
+        const ssize_t entry_length = m_entries.length(m_position);
 
-        if (is_programme and (*service)->label.has_fig1_label()) {
+        if (entry_length > 0) {
             // Phase-lock: check if 0/2 has announced enough services
             // We cannot send a label until 0/2 has announced the service
             if (!m_rti->can_fig1_1_send()) {
                 // 0/2 hasn't announced enough services yet, wait
                 break;
             }
-            
-            auto fig1_1 = (FIGtype1_1 *)buf;
-
-            fig1_1->FIGtypeNumber = 1;
-            fig1_1->Length = 21;
-            fig1_1->Charset = 0;
-            fig1_1->OE = 0;
-            fig1_1->Extension = 1;
-
-            fig1_1->Sld = htons((*service)->id);
-            buf += 4;
-            remaining -= 4;
-
-            (*service)->label.writeLabel(buf);
-            buf += 16;
-            remaining -= 16;
-
-            buf[0] = (*service)->label.flag() >> 8;
-            buf[1] = (*service)->label.flag() & 0xFF;
-            buf += 2;
-            remaining -= 2;
-            
+
+            memcpy(buf, m_entries.data(m_position), entry_length);
+            buf += entry_length;
+            remaining -= entry_length;
+
             // Phase-lock: notify that we've sent a programme service label
             m_rti->on_fig1_1_label_sent();
         }
     }
 
-    if (service == ensemble->services.end()) {
+    if (m_position == num_services) {
         // Cycle complete - mark uninitialised so next call starts fresh
         m_initialised = false;
         fs.complete_fig_transmitted = true;
@@ -148,86 +168,98 @@ FillStatus FIG1_1::fill(uint8_t *buf, size_t max_size)
 
 //=========== FIG 1/4 ===========
 
+void FIG1_4::encode_entries()
+{
+    auto ensemble = m_rti->ensemble;
+    m_entries.clear();
+
+    for (const auto& component : ensemble->components) {
+        /* We check in the config parser if the primary component has
+         * a label, which is forbidden since V2.1.1 */
+        if (component->label.long_label().empty()) {
+            m_entries.add(0);
+            continue;
+        }
+
+        auto service = getService(component, ensemble->services);
+
+        uint8_t *buf = nullptr;
+        if ((*service)->isProgramme(ensemble)) {
+            // Programme
+            buf = m_entries.add(5 + 16 + 2);
+            auto fig1_4 = (FIGtype1_4_programme*)buf;
+
+            fig1_4->FIGtypeNumber = 1;
+            fig1_4->Length = 22;
+            fig1_4->Charset = 0;
+            fig1_4->OE = 0;
+            fig1_4->Extension = 4;
+            fig1_4->PD = 0;
+            fig1_4->rfa = 0;
+            fig1_4->SCIdS = component->SCIdS;
+
+            fig1_4->SId = htons((*service)->id);
+            buf += 5;
+        }
+        else {    // Data
+            buf = m_entries.add(7 + 16 + 2);
+            auto fig1_4 = (FIGtype1_4_data *)buf;
+            fig1_4->FIGtypeNumber = 1;
+            fig1_4->Length = 24;
+            fig1_4->Charset = 0;
+            fig1_4->OE = 0;
+            fig1_4->Extension = 4;
+            fig1_4->PD = 1;
+            fig1_4->rfa = 0;
+            fig1_4->SCIdS = component->SCIdS;
+
+            fig1_4->SId = htonl((*service)->id);
+            buf += 7;
+        }
+        component->label.writeLabel(buf);
+        buf += 16;
+
+        buf[0] = component->label.flag() >> 8;
+        buf[1] = component->label.flag() & 0xFF;
+    }
+}
+
 FillStatus FIG1_4::fill(uint8_t *buf, size_t max_size)
 {
     FillStatus fs;
 
     ssize_t remaining = max_size;
 
+    const size_t num_components = m_rti->ensemble->components.size();
+
     if (not m_initialised) {
-        component = m_rti->ensemble->components.end();
+        m_position = num_components;
         m_initialised = true;
     }
 
-    auto ensemble = m_rti->ensemble;
+    if (m_entries.stale(num_components)) {
+        encode_entries();
+        m_position = std::min(m_position, num_components);
+    }
 
-    // Rotate through the subchannels until there is no more
+    // Rotate through the components until there is no more
     // space
-    for (; component != ensemble->components.end();
-            ++component) {
-
-        auto service = getService(*component, ensemble->services);
+    for (; m_position < num_components; ++m_position) {
+        const ssize_t entry_length = m_entries.length(m_position);
 
-        /* We check in the config parser if the primary component has
-         * a label, which is forbidden since V2.1.1 */
-
-        if (not (*component)->label.long_label().empty() ) {
-            if ((*service)->isProgramme(ensemble)) {
-
-                if (remaining < 5 + 16 + 2) {
-                    break;
-                }
-
-                // Programme
-                FIGtype1_4_programme *fig1_4;
-                fig1_4 = (FIGtype1_4_programme*)buf;
-
-                fig1_4->FIGtypeNumber = 1;
-                fig1_4->Length = 22;
-                fig1_4->Charset = 0;
-                fig1_4->OE = 0;
-                fig1_4->Extension = 4;
-                fig1_4->PD = 0;
-                fig1_4->rfa = 0;
-                fig1_4->SCIdS = (*component)->SCIdS;
-
-                fig1_4->SId = htons((*service)->id);
-                buf += 5;
-                remaining -= 5;
-            }
-            else {    // Data
-                if (remaining < 7 + 16 + 2) {
-                    break;
-                }
-
-                FIGtype1_4_data *fig1_4;
-                fig1_4 = (FIGtype1_4_data *)buf;
-                fig1_4->FIGtypeNumber = 1;
-                fig1_4->Length = 24;
-                fig1_4->Charset = 0;
-                fig1_4->OE = 0;
-                fig1_4->Extension = 4;
-                fig1_4->PD = 1;
-                fig1_4->rfa = 0;
-                fig1_4->SCIdS = (*component)->SCIdS;
-
-                fig1_4->SId = htonl((*service)->id);
-                buf += 7;
-                remaining -= 7;
+        if (entry_length > 0) {
+            if (remaining < entry_length) {
+                break;
             }
-            (*component)->label.writeLabel(buf);
-            buf += 16;
-            remaining -= 16;
-
-            buf[0] = (*component)->label.flag() >> 8;
-            buf[1] = (*component)->label.flag() & 0xFF;
-            buf += 2;
-            remaining -= 2;
+
+            memcpy(buf, m_entries.data(m_position), entry_length);
+            buf += entry_length;
+            remaining -= entry_length;
         }
     }
 
-    if (component == ensemble->components.end()) {
-        component = ensemble->components.begin();
+    if (m_position == num_components) {
+        m_position = 0;
         fs.complete_fig_transmitted = true;
     }
 
@@ -237,56 +269,72 @@ FillStatus FIG1_4::fill(uint8_t *buf, size_t max_size)
 
 //=========== FIG 1/5 ===========
 
+void FIG1_5::encode_entries()
+{
+    auto ensemble = m_rti->ensemble;
+    m_entries.clear();
+
+    for (const auto& service : ensemble->services) {
+        const auto type = service->getType(ensemble);
+        const bool is_audio = (type == subchannel_type_t::DABAudio or type == subchannel_type_t::DABPlusAudio);
+
+        if (is_audio) {
+            m_entries.add(0);
+            continue;
+        }
+
+        uint8_t *buf = m_entries.add(6 + 16 + 2);
+        auto fig1_5 = (FIGtype1_5 *)buf;
+        fig1_5->FIGtypeNumber = 1;
+        fig1_5->Length = 23;
+        fig1_5->Charset = 0;
+        fig1_5->OE = 0;
+        fig1_5->Extension = 5;
+
+        fig1_5->SId = htonl(service->id);
+        buf += 6;
+
+        service->label.writeLabel(buf);
+        buf += 16;
+
+        buf[0] = service->label.flag() >> 8;
+        buf[1] = service->label.flag() & 0xFF;
+    }
+}
+
 FillStatus FIG1_5::fill(uint8_t *buf, size_t max_size)
 {
     FillStatus fs;
 
     ssize_t remaining = max_size;
 
+    const size_t num_services = m_rti->ensemble->services.size();
+
     if (not m_initialised) {
-        service = m_rti->ensemble->services.end();
+        m_position = num_services;
         m_initialised = true;
     }
 
-    auto ensemble = m_rti->ensemble;
+    if (m_entries.stale(num_services)) {
+        encode_entries();
+        m_position = std::min(m_position, num_services);
+    }
 
-    // Rotate through the subchannels until there is no more
+    // Rotate through the services until there is no more
     // space
-    for (; service != ensemble->services.end();
-            ++service) {
-
+    for (; m_position < num_services; ++m_position) {
         if (remaining < 6 + 16 + 2) {
             break;
         }
 
-        const auto type = (*service)->getType(ensemble);
-        const bool is_audio = (type == subchannel_type_t::DABAudio or type == subchannel_type_t::DABPlusAudio);
-
-        if (not is_audio) {
-            auto fig1_5 = (FIGtype1_5 *)buf;
-            fig1_5->FIGtypeNumber = 1;
-            fig1_5->Length = 23;
-            fig1_5->Charset = 0;
-            fig1_5->OE = 0;
-            fig1_5->Extension = 5;
-
-            fig1_5->SId = htonl((*service)->id);
-            buf += 6;
-            remaining -= 6;
-
-            (*service)->label.writeLabel(buf);
-            buf += 16;
-            remaining -= 16;
-
-            buf[0] = (*service)->label.flag() >> 8;
-            buf[1] = (*service)->label.flag() & 0xFF;
-            buf += 2;
-            remaining -= 2;
-        }
+        const ssize_t entry_length = m_entries.length(m_position);
+        memcpy(buf, m_entries.data(m_position), entry_length);
+        buf += entry_length;
+        remaining -= entry_length;
     }
 
-    if (service == ensemble->services.end()) {
-        service = ensemble->services.begin();
+    if (m_position == num_services) {
+        m_position = 0;
         fs.complete_fig_transmitted = true;
     }
 
@@ -61,9 +61,14 @@ class FIG1_1 : public IFIG
         virtual int figextension() const { return 1; }
 
     private:
+        void encode_entries();
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
-        vec_sp_service::iterator service;
+
+        // One FIG per programme service with a label
+        FIGEntryCache m_entries;
+        size_t m_position = 0;
 };
 
 // FIG type 1/4, service component label
@@ -79,9 +84,14 @@ class FIG1_4 : public IFIG
         virtual int figextension() const { return 4; }
 
     private:
+        void encode_entries();
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
-        vec_sp_component::iterator component;
+
+        // One FIG per component with a label
+        FIGEntryCache m_entries;
+        size_t m_position = 0;
 };
 
 // FIG type 1/5, data service label
@@ -97,9 +107,14 @@ class FIG1_5 : public IFIG
         virtual int figextension() const { return 5; }
 
     private:
+        void encode_entries();
+
         FIGRuntimeInformation *m_rti;
         bool m_initialised;
-        vec_sp_service::iterator service;
+
+        // One FIG per data service
+        FIGEntryCache m_entries;
+        size_t m_position = 0;
 };
 
 struct FIGtype1_0 {
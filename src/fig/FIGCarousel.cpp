@@ -248,10 +248,12 @@ size_t FIGCarousel::write_fibs(
     }
 
     const int fibCount = fib3_present ? 4 : 3;
+    m_frame_stats.num_fibs = fibCount;
 
     for (int fib = 0; fib < fibCount; fib++) {
         memset(buf, 0x00, 30);
         size_t figSize = carousel(fib, buf, 30, current_frame);
+        m_frame_stats.fib_used[fib] = figSize;
 
         if (figSize < 30) {
             buf[figSize] = 0xff; // end marker
@@ -373,6 +375,7 @@ size_t FIGCarousel::carousel(
     if (fig0_0 != sorted_figs.end()) {
         if (framephase == 0) { // TODO check for all TM
             FillStatus status = (*fig0_0)->fig()->fill(pbuf, available_size);
+            m_rti.notify_fill(*(*fig0_0)->fig(), status);
             size_t written = status.num_bytes_written;
 
             if (written > 0) {
@@ -404,6 +407,7 @@ size_t FIGCarousel::carousel(
 
             if (fig0_7 != sorted_figs.end()) {
                 FillStatus status0_7 = (*fig0_7)->fig()->fill(pbuf, available_size);
+                m_rti.notify_fill(*(*fig0_7)->fig(), status0_7);
                 size_t written = status0_7.num_bytes_written;
 
                 if (written > 0) {
@@ -442,6 +446,7 @@ size_t FIGCarousel::carousel(
     while (available_size > 0 and not sorted_figs.empty()) {
         auto fig_el = sorted_figs[0];
         FillStatus status = fig_el->fig()->fill(pbuf, available_size);
+        m_rti.notify_fill(*fig_el->fig(), status);
         size_t written = status.num_bytes_written;
 
         // If exactly two bytes were written, it's because the FIG did
@@ -95,6 +95,14 @@ class FIGCarousel {
         double get_rate_correction() const;
         void set_rate_correction(double factor);
 
+        // See FIGRuntimeInformation::notify_fill()
+        void set_fill_observer(FIGRuntimeInformation::fill_observer_t observer) {
+            m_rti.fill_observer = observer;
+        }
+
+        // FIB usage of the last frame written
+        const FICFillStats& last_frame_stats() const { return m_frame_stats; }
+
     private:
         size_t carousel(int fib, uint8_t *buf, size_t bufsize, uint64_t current_frame);
 
@@ -109,6 +117,8 @@ class FIGCarousel {
 
         FIGRuntimeInformation m_rti;
 
+        FICFillStats m_frame_stats;
+
         // Some FIGs can be mapped to a specific FIB or to FIB_ANY
         std::map<FIBAllocation, std::list<FIGCarouselElement> > m_fibs;
 
@@ -0,0 +1,352 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+   Earliest deadline first FIG scheduler.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fig/FIGCarouselEDF.h"
+#include "ManagementServer.h"
+#include "crc.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace FIC {
+
+// Duration of an ETI frame
+constexpr int FRAME_DURATION_MS = 24;
+
+// Space available to FIGs in one FIB
+constexpr size_t FIB_DATA_SIZE = 30;
+
+// Interval at which missed deadlines are logged, about 6 seconds
+constexpr uint64_t LOG_INTERVAL_FRAMES = 250;
+
+// Above this FIC load, the periods of all FIGs are stretched so that
+// the FIGs share the lack of capacity instead of missing their deadlines
+// one after the other.
+constexpr double MAX_LOAD = 0.9;
+
+FIGCarouselEDF::FIGCarouselEDF(
+        std::shared_ptr<dabEnsemble> ensemble,
+        FIGRuntimeInformation::get_time_func_t getTimeFunc) :
+    m_rti(ensemble, getTimeFunc),
+    m_fig0_0(&m_rti),
+    m_fig0_7(&m_rti),
+    m_fig0_1(&m_rti),
+    m_fig0_2(&m_rti),
+    m_fig0_3(&m_rti),
+    m_fig0_5(&m_rti),
+    m_fig0_6(&m_rti),
+    m_fig0_8_prog(&m_rti, FIG0_8_mode::Programme),
+    m_fig0_8_data(&m_rti, FIG0_8_mode::Data),
+    m_fig0_9(&m_rti),
+    m_fig0_10(&m_rti),
+    m_fig0_13(&m_rti),
+    m_fig0_14(&m_rti),
+    m_fig0_17(&m_rti),
+    m_fig0_18(&m_rti),
+    m_fig0_19(&m_rti),
+    m_fig0_20(&m_rti),
+    m_fig0_21(&m_rti),
+    m_fig0_24(&m_rti),
+    m_fig1_0(&m_rti),
+    m_fig1_1(&m_rti),
+    m_fig1_4(&m_rti),
+    m_fig1_5(&m_rti),
+    m_fig2_0(&m_rti),
+    m_fig2_1(&m_rti, true),
+    m_fig2_5(&m_rti, false),
+    m_fig2_4(&m_rti)
+{
+    // The programme and data halves of FIG 0/8 have different repetition
+    // rates, and get separate deadlines.
+    add_fig(m_fig0_1);
+    add_fig(m_fig0_2);
+    add_fig(m_fig0_3);
+    add_fig(m_fig0_5);
+    add_fig(m_fig0_6);
+    add_fig(m_fig0_8_prog);
+    add_fig(m_fig0_8_data);
+    add_fig(m_fig0_9);
+    add_fig(m_fig0_10);
+    add_fig(m_fig0_13);
+    add_fig(m_fig0_14);
+    add_fig(m_fig0_17);
+    add_fig(m_fig0_18);
+    add_fig(m_fig0_19);
+    add_fig(m_fig0_20);
+    add_fig(m_fig0_21);
+    add_fig(m_fig0_24);
+    add_fig(m_fig1_0);
+    add_fig(m_fig1_1);
+    add_fig(m_fig1_4);
+    add_fig(m_fig1_5);
+    add_fig(m_fig2_0);
+    add_fig(m_fig2_1);
+    add_fig(m_fig2_5);
+    add_fig(m_fig2_4);
+
+    m_order.reserve(m_entries.size());
+    for (auto& entry : m_entries) {
+        m_order.push_back(&entry);
+    }
+}
+
+void FIGCarouselEDF::add_fig(IFIG& fig)
+{
+    FIGEntryEDF entry;
+    entry.fig = &fig;
+    entry.rate = fig.repetition_rate();
+    entry.period_ms = rate_increment_ms(entry.rate);
+    entry.release_ms = 0;
+    entry.deadline_ms = entry.period_ms;
+    m_entries.push_back(entry);
+}
+
+int64_t FIGCarouselEDF::scheduled_period(const FIGEntryEDF& entry) const
+{
+    return entry.period_ms * m_stretch;
+}
+
+void FIGCarouselEDF::report_missed(FIGEntryEDF& entry)
+{
+    entry.missed = true;
+    entry.num_missed++;
+    get_mgmt_server().fig_deadline_missed(
+            std::to_string(entry.fig->figtype()) + "_" +
+            std::to_string(entry.fig->figextension()));
+}
+
+void FIGCarouselEDF::check_deadlines(int fib_count)
+{
+    // Bytes per millisecond the FIGs need at their nominal rates
+    double demand = 0;
+    for (const auto& entry : m_entries) {
+        demand += (double)entry.last_cycle_bytes / entry.period_ms;
+    }
+    const double capacity = (double)(fib_count * FIB_DATA_SIZE) / FRAME_DURATION_MS;
+    m_load = demand / capacity;
+    m_stretch = std::max(1.0, m_load / MAX_LOAD);
+
+    for (auto& entry : m_entries) {
+        // Some FIGs change rate, e.g. FIG 0/19 during announcements
+        const auto rate = entry.fig->repetition_rate();
+        if (rate != entry.rate) {
+            entry.rate = rate;
+            entry.period_ms = rate_increment_ms(rate);
+            entry.release_ms = std::min(entry.release_ms, m_now_ms);
+            entry.deadline_ms = entry.release_ms + scheduled_period(entry);
+        }
+
+        if (not entry.missed and entry.deadline_ms < m_now_ms) {
+            report_missed(entry);
+        }
+    }
+}
+
+void FIGCarouselEDF::log_deadlines(uint64_t current_frame)
+{
+    if ((current_frame % LOG_INTERVAL_FRAMES) != 0) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "FIGCarouselEDF: FIC load " << (int)(100.0 * m_load) << "%";
+
+    if (m_stretch > 1.0) {
+        ss << ", repetition rates stretched by " << m_stretch;
+    }
+
+    bool any_missed = false;
+    for (auto& entry : m_entries) {
+        if (entry.num_missed > 0) {
+            if (not any_missed) {
+                ss << ", missed deadlines for FIGs:";
+                any_missed = true;
+            }
+            ss << " " << entry.fig->name() << "(" << entry.num_missed << ")";
+            entry.num_missed = 0;
+        }
+    }
+
+    if (m_stretch > 1.0 or any_missed) {
+        etiLog.level(warn) << ss.str();
+    }
+}
+
+size_t FIGCarouselEDF::write_fibs(uint8_t* buf, uint64_t current_frame, bool fib3_present)
+{
+    m_rti.currentFrame = current_frame;
+
+    const int fibCount = fib3_present ? 4 : 3;
+    const int framephase = current_frame % 4;
+    const int fib_duration_ms = FRAME_DURATION_MS / fibCount;
+
+    check_deadlines(fibCount);
+    log_deadlines(current_frame);
+    m_frame_stats.num_fibs = fibCount;
+
+    for (int fib = 0; fib < fibCount; fib++) {
+        memset(buf, 0x00, 30);
+        const int64_t fib_time_ms = m_now_ms + fib * fib_duration_ms;
+        size_t figSize = fill_fib(buf, 30, fib, framephase, fib_time_ms, fib_duration_ms);
+        m_frame_stats.fib_used[fib] = figSize;
+
+        if (figSize < 30) {
+            buf[figSize] = 0xff; // End marker
+        }
+        else if (figSize > 30) {
+            std::stringstream ss;
+            ss << "FIB" << fib << " overload (" << figSize << " > 30)";
+            throw std::runtime_error(ss.str());
+        }
+
+        uint16_t crc = 0xffff;
+        crc = crc16(crc, buf, 30);
+        crc ^= 0xffff;
+
+        buf += 30;
+        *(buf++) = (crc >> 8) & 0xFF;
+        *(buf++) = crc & 0xFF;
+    }
+
+    m_now_ms += FRAME_DURATION_MS;
+
+    return 32 * fibCount;
+}
+
+size_t FIGCarouselEDF::fill_fib(uint8_t* buf, size_t max_size, int fib_index,
+        int framephase, int64_t fib_time_ms, int fib_duration_ms)
+{
+    size_t written = 0;
+
+    // EN 300 401 Clause 6.4.1: FIG 0/0 is the first FIG of the first FIB
+    // of the first CIF of each FIC, and FIG 0/7 directly follows it.
+    if (fib_index == 0 and framephase == 0) {
+        FillStatus status = m_fig0_0.fill(buf, max_size);
+        m_rti.notify_fill(m_fig0_0, status);
+        if (status.num_bytes_written == 0) {
+            throw std::logic_error("Failed to write FIG 0/0");
+        }
+        written += status.num_bytes_written;
+
+        status = m_fig0_7.fill(buf + written, max_size - written);
+        m_rti.notify_fill(m_fig0_7, status);
+        written += status.num_bytes_written;
+    }
+
+    for (auto& entry : m_entries) {
+        entry.released = entry.release_ms <= fib_time_ms;
+        if (entry.released) {
+            const int64_t fibs_needed =
+                (entry.remaining_bytes() + FIB_DATA_SIZE - 1) / FIB_DATA_SIZE;
+            entry.sort_key = entry.deadline_ms - fibs_needed * fib_duration_ms;
+        }
+        else {
+            entry.sort_key = entry.release_ms;
+        }
+    }
+
+    // Ties go to the FIG with the shorter period, whose next deadline
+    // comes sooner.
+    std::sort(m_order.begin(), m_order.end(),
+            [](const FIGEntryEDF* left, const FIGEntryEDF* right) {
+                if (left->released != right->released) {
+                    return left->released;
+                }
+                if (left->sort_key != right->sort_key) {
+                    return left->sort_key < right->sort_key;
+                }
+                return left->period_ms < right->period_ms;
+            });
+
+    for (auto* entry : m_order) {
+        // No FIG fits in less than three bytes
+        if (max_size - written < 3) {
+            break;
+        }
+
+        // A FIG that does not fit writes nothing, and the space goes to the
+        // next one. A FIG that has more to send gets filled again.
+        bool cycle_completed = false;
+        do {
+            const size_t bytes = try_send_fig(*entry, buf + written,
+                    max_size - written, fib_time_ms, cycle_completed);
+            if (bytes == 0) {
+                break;
+            }
+            written += bytes;
+        } while (not cycle_completed and max_size - written >= 3);
+    }
+
+    return written;
+}
+
+size_t FIGCarouselEDF::try_send_fig(FIGEntryEDF& entry, uint8_t* buf,
+        size_t max_size, int64_t fib_time_ms, bool& cycle_completed)
+{
+    FillStatus status = entry.fig->fill(buf, max_size);
+    m_rti.notify_fill(*entry.fig, status);
+    const size_t written = status.num_bytes_written;
+
+    if (written == 1 or written == 2) {
+        std::stringstream ss;
+        ss << "Assertion error: FIG " << entry.fig->name()
+           << " wrote only " << written << " bytes (minimum is 3)";
+        throw std::logic_error(ss.str());
+    }
+    else if (written > max_size) {
+        std::stringstream ss;
+        ss << "Assertion error: FIG " << entry.fig->name()
+           << " wrote " << written << " bytes but only "
+           << max_size << " available";
+        throw std::logic_error(ss.str());
+    }
+
+    cycle_completed = status.complete_fig_transmitted;
+
+    entry.cycle_bytes += written;
+
+    if (cycle_completed) {
+        entry.num_cycles++;
+        entry.last_cycle_bytes = entry.cycle_bytes;
+        entry.cycle_bytes = 0;
+        entry.missed = false;
+
+        // Stay on the release grid, unless the cycle was so late that
+        // the next deadline has already passed. FIGs used as filler before
+        // their release complete cycles early, which must not push the
+        // release further into the future.
+        const int64_t period = scheduled_period(entry);
+        entry.release_ms = std::min(entry.release_ms + period, fib_time_ms + period);
+        if (entry.release_ms + period <= fib_time_ms) {
+            entry.release_ms = fib_time_ms;
+        }
+        entry.deadline_ms = entry.release_ms + period;
+    }
+
+    return written;
+}
+
+} // namespace FIC
@@ -0,0 +1,183 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+   Earliest deadline first FIG scheduler.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "fig/FIG.h"
+#include "fig/FIG0.h"
+#include "fig/FIG1.h"
+#include "fig/FIG2.h"
+#include "fig/FIGCarouselPriority.h"
+#include "MuxElements.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FIC {
+
+/* Scheduling state of one FIG.
+ *
+ * Cycles of the FIG are released every rate_increment_ms() of the FIG
+ * repetition rate, and have to complete before the next one is released.
+ * period_ms is this nominal period.
+ * The number of bytes the previous cycle needed is an estimate of how much
+ * the current cycle still has to send. */
+struct FIGEntryEDF {
+    IFIG* fig = nullptr;
+
+    FIG_rate rate = FIG_rate::A;
+    int period_ms = 0;
+
+    // Release time and deadline of the current cycle
+    int64_t release_ms = 0;
+    int64_t deadline_ms = 0;
+
+    // The current cycle missed its deadline, and it was reported
+    bool missed = false;
+    uint64_t num_missed = 0;
+
+    uint64_t num_cycles = 0;
+    size_t cycle_bytes = 0;
+    size_t last_cycle_bytes = 0;
+
+    // Updated before every FIB: released entries come first, ordered by
+    // their deadline minus the time needed to send the remaining bytes.
+    // The others follow in the order of their release.
+    bool released = false;
+    int64_t sort_key = 0;
+
+    size_t remaining_bytes() const {
+        return last_cycle_bytes > cycle_bytes ? last_cycle_bytes - cycle_bytes : 0;
+    }
+};
+
+/* FIGCarouselEDF - Earliest deadline first FIG scheduler
+ *
+ * Every FIB is filled with the released FIGs whose cycle has the earliest
+ * deadline, corrected by the time the FIG still needs given its remaining
+ * bytes. A FIG is filled several times into the same FIB as long as it
+ * writes data and has not completed its cycle, and FIGs that do not fit in
+ * the remaining space are skipped in favour of later ones, so that the FIBs
+ * are packed as tightly as possible.
+ *
+ * Only released cycles are needed to respect the repetition rates, and
+ * their load is what is logged as the FIC load. Space they leave free is
+ * given to the other FIGs, which then complete their next cycle ahead of
+ * time.
+ *
+ * The deadlines are the nominal repetition rates, without any correction.
+ * If the FIC cannot carry all FIGs at these rates, all periods are
+ * stretched by the same factor, like the fic-repetition-correction of the
+ * classic scheduler does, and deadlines are missed against the stretched
+ * periods only. The stretch factor is logged together with the load.
+ * FIG 0/0 and 0/7 are sent at the start of FIB 0 at framephase 0.
+ */
+class FIGCarouselEDF {
+    public:
+        FIGCarouselEDF(
+                std::shared_ptr<dabEnsemble> ensemble,
+                FIGRuntimeInformation::get_time_func_t getTimeFunc);
+
+        // Write all FIBs to buffer, returns bytes written
+        size_t write_fibs(uint8_t* buf, uint64_t current_frame, bool fib3_present);
+
+        // See FIGRuntimeInformation::notify_fill()
+        void set_fill_observer(FIGRuntimeInformation::fill_observer_t observer) {
+            m_rti.fill_observer = observer;
+        }
+
+        // FIB usage of the last frame written
+        const FICFillStats& last_frame_stats() const { return m_frame_stats; }
+
+    private:
+        void add_fig(IFIG& fig);
+
+        // Update the FIC load and the rates, and report deadlines that passed
+        void check_deadlines(int fib_count);
+
+        // Count the miss, and tell the management server
+        void report_missed(FIGEntryEDF& entry);
+
+        // Log the missed deadlines and the FIC load periodically
+        void log_deadlines(uint64_t current_frame);
+
+        // Period used to release the cycles of the FIG
+        int64_t scheduled_period(const FIGEntryEDF& entry) const;
+
+        size_t fill_fib(uint8_t* buf, size_t max_size, int fib_index,
+                int framephase, int64_t fib_time_ms, int fib_duration_ms);
+
+        // Fill a FIG, and account for the bytes and the cycle completion
+        size_t try_send_fig(FIGEntryEDF& entry, uint8_t* buf, size_t max_size,
+                int64_t fib_time_ms, bool& cycle_completed);
+
+        FIGRuntimeInformation m_rti;
+
+        // Time of the current frame, advances by 24ms every frame
+        int64_t m_now_ms = 0;
+
+        // Share of the FIC the FIGs need to respect their nominal rates,
+        // and the factor applied to the periods if that is too much.
+        double m_load = 0;
+        double m_stretch = 1.0;
+
+        std::vector<FIGEntryEDF> m_entries;
+
+        // Order of the entries for the FIB being filled
+        std::vector<FIGEntryEDF*> m_order;
+
+        FICFillStats m_frame_stats;
+
+        // FIG 0/0 and 0/7 are not part of m_entries
+        FIG0_0 m_fig0_0;
+        FIG0_7 m_fig0_7;
+
+        FIG0_1 m_fig0_1;
+        FIG0_2 m_fig0_2;
+        FIG0_3 m_fig0_3;
+        FIG0_5 m_fig0_5;
+        FIG0_6 m_fig0_6;
+        FIG0_8 m_fig0_8_prog;
+        FIG0_8 m_fig0_8_data;
+        FIG0_9 m_fig0_9;
+        FIG0_10 m_fig0_10;
+        FIG0_13 m_fig0_13;
+        FIG0_14 m_fig0_14;
+        FIG0_17 m_fig0_17;
+        FIG0_18 m_fig0_18;
+        FIG0_19 m_fig0_19;
+        FIG0_20 m_fig0_20;
+        FIG0_21 m_fig0_21;
+        FIG0_24 m_fig0_24;
+        FIG1_0 m_fig1_0;
+        FIG1_1 m_fig1_1;
+        FIG1_4 m_fig1_4;
+        FIG1_5 m_fig1_5;
+        FIG2_0 m_fig2_0;
+        FIG2_1_and_5 m_fig2_1;
+        FIG2_1_and_5 m_fig2_5;
+        FIG2_4 m_fig2_4;
+};
+
+} // namespace FIC
@@ -36,9 +36,45 @@ namespace FIC {
 
 /**************** PriorityLevel ****************/
 
+void PriorityLevel::push_back(FIGEntryPriority* entry)
+{
+    entry->prev = back;
+    entry->next = nullptr;
+    if (back) {
+        back->next = entry;
+    }
+    else {
+        front = entry;
+    }
+    back = entry;
+    size++;
+}
+
+void PriorityLevel::unlink(FIGEntryPriority* entry)
+{
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    }
+    else {
+        front = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    }
+    else {
+        back = entry->prev;
+    }
+    entry->prev = nullptr;
+    entry->next = nullptr;
+    size--;
+}
+
 FIGEntryPriority* PriorityLevel::find_must_send()
 {
-    for (auto* entry : carousel) {
+    if (num_must_send == 0) {
+        return nullptr;
+    }
+    for (auto* entry = front; entry; entry = entry->next) {
         if (entry->must_send) {
             return entry;
         }
@@ -50,31 +86,16 @@ FIGEntryPriority* PriorityLevel::find_can_send()
 {
     // Return front of carousel if non-empty
     // Any FIG can potentially send - it will return 0 bytes if nothing to send
-    if (!carousel.empty()) {
-        return carousel.front();
-    }
-    return nullptr;
+    return front;
 }
 
 void PriorityLevel::move_to_back(FIGEntryPriority* entry)
 {
-    carousel.remove(entry);
-    carousel.push_back(entry);
-}
-
-bool PriorityLevel::has_must_send() const
-{
-    for (const auto* entry : carousel) {
-        if (entry->must_send) {
-            return true;
-        }
+    if (entry == back) {
+        return;
     }
-    return false;
-}
-
-bool PriorityLevel::has_can_send() const
-{
-    return !carousel.empty();
+    unlink(entry);
+    push_back(entry);
 }
 
 /**************** FIGCarouselPriority ****************/
@@ -130,12 +151,12 @@ FIGCarouselPriority::FIGCarouselPriority(
             case 8: m_priorities[i].poll_reset_value = 128; break; // Rate E
             default: m_priorities[i].poll_reset_value = 256; break;
         }
-        m_priorities[i].poll_counter = m_priorities[i].poll_reset_value;
+        m_priorities[i].poll_due = m_priorities[i].poll_reset_value;
     }
     
     // Initialize priority stack (all priorities except 0)
     for (int i = 1; i < NUM_PRIORITIES; i++) {
-        m_priority_stack.push_back(i);
+        m_priority_stack[i - 1] = i;
     }
     
     // Assign FIGs to priorities
@@ -234,17 +255,78 @@ void FIGCarouselPriority::add_fig_to_priority(IFIG& fig, int priority)
     FIGEntryPriority* entry_ptr = entry.get();
     m_all_entries.push_back(std::move(entry));
     
-    m_priorities[priority].carousel.push_back(entry_ptr);
+    m_priorities[priority].push_back(entry_ptr);
+    
+    // init_deadline() set must_send
+    entry_ptr->must_send = false;
+    set_must_send(entry_ptr, true);
 }
 
-void FIGCarouselPriority::tick_all_deadlines(int elapsed_ms)
+void FIGCarouselPriority::set_must_send(FIGEntryPriority* entry, bool must_send)
 {
-    for (auto& entry : m_all_entries) {
-        bool start_new = entry->tick_deadline(elapsed_ms);
+    if (entry->must_send == must_send) {
+        return;
+    }
+    entry->must_send = must_send;
+    
+    auto& level = m_priorities[entry->assigned_priority];
+    if (must_send) {
+        entry->must_send_since_ms = m_now_ms;
+        level.num_must_send++;
+        m_must_send_levels |= (1u << level.priority);
+    }
+    else {
+        level.num_must_send--;
+        if (level.num_must_send == 0) {
+            m_must_send_levels &= ~(1u << level.priority);
+        }
+    }
+}
+
+void FIGCarouselPriority::on_cycle_complete(FIGEntryPriority* entry)
+{
+    if (entry->missed_deadline(m_now_ms, m_last_violation_check_ms)) {
+        entry->deadline_violated = true;
+    }
+    
+    entry->on_cycle_complete(m_now_ms);
+    set_must_send(entry, false);
+    queue_timer(entry);
+}
+
+void FIGCarouselPriority::queue_timer(FIGEntryPriority* entry)
+{
+    if (entry->timer_queued) {
+        return;
+    }
+    entry->timer_queued = true;
+    m_timers.emplace_back(entry->deadline_ms, entry);
+    std::push_heap(m_timers.begin(), m_timers.end(), std::greater<timer_t>());
+}
+
+void FIGCarouselPriority::advance_clock(int elapsed_ms)
+{
+    m_now_ms += elapsed_ms;
+    
+    while (not m_timers.empty() and m_timers.front().first <= m_now_ms) {
+        std::pop_heap(m_timers.begin(), m_timers.end(), std::greater<timer_t>());
+        FIGEntryPriority* entry = m_timers.back().second;
+        m_timers.pop_back();
+        entry->timer_queued = false;
         
-        // Check if a new cycle should start
-        if (start_new) {
-            entry->start_new_cycle();
+        if (entry->must_send) {
+            continue;
+        }
+        
+        if (entry->deadline_ms > m_now_ms) {
+            // The cycle completed again while queued
+            queue_timer(entry);
+        }
+        else {
+            // Deadline passed and cycle is complete - start new cycle
+            // Note: We do NOT move deadline_ms here, it keeps track of
+            // how late the cycle is.
+            set_must_send(entry, true);
         }
     }
 }
@@ -266,6 +348,11 @@ void FIGCarouselPriority::check_and_log_deadlines(uint64_t current_frame)
     ManagementServer& mgmt_server = get_mgmt_server();
     
     for (auto& entry : m_all_entries) {
+        // Cycles that are still in progress
+        if (entry->missed_deadline(m_now_ms, m_last_violation_check_ms)) {
+            entry->deadline_violated = true;
+        }
+        
         if (entry->deadline_violated && entry->cycle_count > 0) {
             // Check how severe the violation is based on average cycle time
             uint64_t avg = entry->avg_cycle_time_ms();
@@ -288,6 +375,7 @@ void FIGCarouselPriority::check_and_log_deadlines(uint64_t current_frame)
             entry->deadline_violated = false;
         }
     }
+    m_last_violation_check_ms = m_now_ms;
     
     // Log critical issues first (these violate WorldDAB guidance)
     if (any_critical) {
@@ -360,8 +448,8 @@ size_t FIGCarouselPriority::write_fibs(uint8_t* buf, uint64_t current_frame, boo
 {
     m_rti.currentFrame = current_frame;
     
-    // Tick all deadline monitors (24ms per frame)
-    tick_all_deadlines(24);
+    // Advance the deadline monitors (24ms per frame)
+    advance_clock(24);
     
     // Periodically log missed deadlines
     check_and_log_deadlines(current_frame);
@@ -371,10 +459,12 @@ size_t FIGCarouselPriority::write_fibs(uint8_t* buf, uint64_t current_frame, boo
     
     const int fibCount = fib3_present ? 4 : 3;
     const int framephase = current_frame % 4;
+    m_frame_stats.num_fibs = fibCount;
     
     for (int fib = 0; fib < fibCount; fib++) {
         memset(buf, 0x00, 30);
         size_t figSize = fill_fib(buf, 30, fib, framephase);
+        m_frame_stats.fib_used[fib] = figSize;
         
         if (figSize < 30) {
             buf[figSize] = 0xff; // End marker
@@ -413,8 +503,9 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
     size_t remaining = max_size - written;
     uint8_t* pbuf = buf + written;
     
-    // Track which FIGs we've tried this pass to avoid infinite loops
-    std::unordered_set<FIGEntryPriority*> tried_this_fib;
+    // Track which FIGs we've tried this pass to avoid infinite loops:
+    // an entry was tried in this FIB if its stamp equals the FIB number.
+    const uint64_t fib_number = ++m_fib_count;
     
     // Step 2: Must-send pass - clear all urgent FIGs using cascading priority
     // We iterate through priorities and try each must_send FIG.
@@ -437,12 +528,12 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
                 prio = 1 + (prio - NUM_PRIORITIES); // Wrap around, skip 0
             }
             
-            if (!m_priorities[prio].has_must_send()) {
+            if (!(m_must_send_levels & (1u << prio))) {
                 continue;
             }
             
             // Try all must_send FIGs in this priority
-            size_t carousel_size = m_priorities[prio].carousel.size();
+            size_t carousel_size = m_priorities[prio].size;
             for (size_t fig_attempt = 0; fig_attempt < carousel_size && remaining > 2; fig_attempt++) {
                 FIGEntryPriority* entry = m_priorities[prio].find_must_send();
                 if (!entry) {
@@ -450,11 +541,11 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
                 }
                 
                 // Skip if we've already tried this FIG this FIB
-                if (tried_this_fib.count(entry)) {
+                if (entry->tried_must_send == fib_number) {
                     m_priorities[prio].move_to_back(entry);
                     continue;
                 }
-                tried_this_fib.insert(entry);
+                entry->tried_must_send = fib_number;
                 
                 // A structured FIG (e.g. 0/8) traverses its component list
                 // across successive fills, reporting completion only when the
@@ -512,15 +603,13 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
     // NOTE: We do NOT update the priority counters here. The counter system
     // is for bandwidth allocation in must_send. In can_send, we just fill space.
     
-    tried_this_fib.clear();
-    
     // Pass 1: FIGs that are past 50% of their deadline (need bandwidth more urgently)
     for (int prio = 1; prio < NUM_PRIORITIES && remaining > 2; prio++) {
-        if (m_priorities[prio].carousel.empty()) {
+        if (!m_priorities[prio].has_can_send()) {
             continue;
         }
         
-        size_t carousel_size = m_priorities[prio].carousel.size();
+        size_t carousel_size = m_priorities[prio].size;
         for (size_t fig_attempt = 0; fig_attempt < carousel_size && remaining > 2; fig_attempt++) {
             FIGEntryPriority* entry = m_priorities[prio].find_can_send();
             if (!entry) {
@@ -528,19 +617,19 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
             }
             
             // Skip if we've already tried this FIG this FIB
-            if (tried_this_fib.count(entry)) {
+            if (entry->tried_can_send == fib_number) {
                 m_priorities[prio].move_to_back(entry);
                 continue;
             }
             
             // Pass 1: Only try FIGs past 50% of their deadline
-            if (!entry->past_deadline_percent(50)) {
-                tried_this_fib.insert(entry);
+            if (!entry->past_deadline_percent(50, m_now_ms)) {
+                entry->tried_can_send = fib_number;
                 m_priorities[prio].move_to_back(entry);
                 continue;
             }
             
-            tried_this_fib.insert(entry);
+            entry->tried_can_send = fib_number;
             
             size_t bytes = try_send_fig(entry, pbuf, remaining);
             if (bytes > 0) {
@@ -556,15 +645,14 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
     }
     
     // Pass 2: Any remaining FIGs that can send (to fill unused space)
-    // Reset tried set - we want to try everything again, but only those we skipped
-    std::unordered_set<FIGEntryPriority*> tried_pass1 = tried_this_fib;
+    // We want to try everything again, but only those we skipped in pass 1
     
     for (int prio = 1; prio < NUM_PRIORITIES && remaining > 2; prio++) {
-        if (m_priorities[prio].carousel.empty()) {
+        if (!m_priorities[prio].has_can_send()) {
             continue;
         }
         
-        size_t carousel_size = m_priorities[prio].carousel.size();
+        size_t carousel_size = m_priorities[prio].size;
         for (size_t fig_attempt = 0; fig_attempt < carousel_size && remaining > 2; fig_attempt++) {
             FIGEntryPriority* entry = m_priorities[prio].find_can_send();
             if (!entry) {
@@ -572,18 +660,16 @@ size_t FIGCarouselPriority::fill_fib(uint8_t* buf, size_t max_size, int fib_inde
             }
             
             // Skip if already sent in pass 1
-            if (tried_pass1.count(entry) && tried_this_fib.count(entry)) {
+            if (entry->tried_can_send == fib_number) {
                 // Check if it was actually sent (not just tried and skipped)
                 // If it was skipped due to not being urgent, we can try it now
-                if (entry->past_deadline_percent(50)) {
+                if (entry->past_deadline_percent(50, m_now_ms)) {
                     // Was tried and is urgent - was actually attempted, skip
                     m_priorities[prio].move_to_back(entry);
                     continue;
                 }
             }
             
-            tried_this_fib.insert(entry);
-            
             size_t bytes = try_send_fig(entry, pbuf, remaining);
             if (bytes > 0) {
 #if PRIORITY_CAROUSEL_DEBUG
@@ -623,20 +709,21 @@ size_t FIGCarouselPriority::send_priority_zero(uint8_t* buf, size_t max_size, in
 #endif
     
     // Find and send FIG 0/0
-    for (auto* entry : m_priorities[0].carousel) {
+    for (auto* entry = m_priorities[0].front; entry; entry = entry->next) {
         if (entry->fig->figtype() == 0 && entry->fig->figextension() == 0) {
             FillStatus status = entry->fig->fill(buf + written, max_size - written);
+            m_rti.notify_fill(*entry->fig, status);
 #if PRIORITY_CAROUSEL_DEBUG
             etiLog.level(info) << "  FIG 0/0: wrote " << status.num_bytes_written 
                                << " bytes, complete=" << status.complete_fig_transmitted
-                               << ", deadline was " << entry->deadline_ms << "ms";
+                               << ", deadline was " << entry->deadline_ms - m_now_ms << "ms";
 #endif
             if (status.num_bytes_written > 0) {
                 written += status.num_bytes_written;
             }
             // Mark cycle complete if the FIG says so
             if (status.complete_fig_transmitted) {
-                entry->on_cycle_complete();
+                on_cycle_complete(entry);
             }
             if (status.num_bytes_written == 0) {
                 throw std::logic_error("Failed to write FIG 0/0");
@@ -646,14 +733,15 @@ size_t FIGCarouselPriority::send_priority_zero(uint8_t* buf, size_t max_size, in
     }
     
     // FIG 0/7 must directly follow FIG 0/0
-    for (auto* entry : m_priorities[0].carousel) {
+    for (auto* entry = m_priorities[0].front; entry; entry = entry->next) {
         if (entry->fig->figtype() == 0 && entry->fig->figextension() == 7) {
 #if PRIORITY_CAROUSEL_DEBUG
-            etiLog.level(info) << "  FIG 0/7: deadline=" << entry->deadline_ms 
+            etiLog.level(info) << "  FIG 0/7: deadline=" << entry->deadline_ms - m_now_ms
                                << "ms, must_send=" << entry->must_send
                                << ", violated=" << entry->deadline_violated;
 #endif
             FillStatus status = entry->fig->fill(buf + written, max_size - written);
+            m_rti.notify_fill(*entry->fig, status);
 #if PRIORITY_CAROUSEL_DEBUG
             etiLog.level(info) << "  FIG 0/7: wrote " << status.num_bytes_written 
                                << " bytes, complete=" << status.complete_fig_transmitted;
@@ -663,9 +751,9 @@ size_t FIGCarouselPriority::send_priority_zero(uint8_t* buf, size_t max_size, in
             }
             // Mark cycle complete if the FIG says so
             if (status.complete_fig_transmitted) {
-                entry->on_cycle_complete();
+                on_cycle_complete(entry);
 #if PRIORITY_CAROUSEL_DEBUG
-                etiLog.level(info) << "  FIG 0/7: cycle complete, new deadline=" << entry->deadline_ms;
+                etiLog.level(info) << "  FIG 0/7: cycle complete, new deadline=" << entry->deadline_ms - m_now_ms;
 #endif
             }
             break;
@@ -677,13 +765,9 @@ size_t FIGCarouselPriority::send_priority_zero(uint8_t* buf, size_t max_size, in
 
 int FIGCarouselPriority::select_priority()
 {
-    if (m_priority_stack.empty()) {
-        return -1;
-    }
-    
     // First: find any priority with counter == 0, highest in stack (front)
     for (int prio : m_priority_stack) {
-        if (m_priorities[prio].poll_counter == 0) {
+        if (m_priorities[prio].poll_counter(m_send_count) == 0) {
             return prio;
         }
     }
@@ -697,7 +781,7 @@ int FIGCarouselPriority::select_priority()
     int position = 1;
     
     for (int prio : m_priority_stack) {
-        int score = m_priorities[prio].poll_counter * position;
+        int score = m_priorities[prio].poll_counter(m_send_count) * position;
         if (score < best_score) {
             best_score = score;
             best_prio = prio;
@@ -745,30 +829,21 @@ int FIGCarouselPriority::cascade_find_priority(int start, bool must_send_only)
 void FIGCarouselPriority::on_fig_sent(int priority)
 {
     // Decrement all counters
-    decrement_all_counters();
+    m_send_count++;
     
     // Reset the priority that sent
-    m_priorities[priority].poll_counter = m_priorities[priority].poll_reset_value;
+    m_priorities[priority].poll_due = m_send_count + m_priorities[priority].poll_reset_value;
     
     // Move to bottom of priority stack
-    m_priority_stack.remove(priority);
-    m_priority_stack.push_back(priority);
-}
-
-void FIGCarouselPriority::decrement_all_counters()
-{
-    for (int i = 1; i < NUM_PRIORITIES; i++) { // Skip priority 0
-        if (m_priorities[i].poll_counter > 0) {
-            m_priorities[i].poll_counter--;
-        }
-        // Clamp at 0 (don't go negative)
-    }
+    auto it = std::find(m_priority_stack.begin(), m_priority_stack.end(), priority);
+    std::rotate(it, it + 1, m_priority_stack.end());
 }
 
 size_t FIGCarouselPriority::try_send_fig(FIGEntryPriority* entry, uint8_t* buf,
         size_t max_size, bool* cycle_completed)
 {
     FillStatus status = entry->fig->fill(buf, max_size);
+    m_rti.notify_fill(*entry->fig, status);
     size_t written = status.num_bytes_written;
 
     if (cycle_completed) {
@@ -797,7 +872,7 @@ size_t FIGCarouselPriority::try_send_fig(FIGEntryPriority* entry, uint8_t* buf,
     // 0 bytes if there's no data, but the cycle is still complete.
     // We always record the cycle completion to track end-to-end timing.
     if (status.complete_fig_transmitted) {
-        entry->on_cycle_complete();
+        on_cycle_complete(entry);
     }
     
     return written;
@@ -35,13 +35,13 @@
 #include "MuxElements.h"
 #include "Log.h"
 
-#include <list>
+#include <algorithm>
 #include <vector>
 #include <array>
 #include <map>
-#include <unordered_set>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace FIC {
 
@@ -80,29 +80,33 @@ inline int rate_increment_ms(FIG_rate rate)
  *
  * Deadline/Cycle Model:
  * ---------------------
- * - deadline_ms: Countdown timer, reset ONLY when cycle completes
+ * All times are on the carousel clock, which advances by 24ms every frame.
+ * - deadline_ms: Time at which the current cycle is due, set ONLY when a cycle completes
  * - must_send: Flag indicating a cycle is in progress and not yet complete
  * - rate_ms: The required repetition rate from the FIG's specification
  *
  * Lifecycle:
- * 1. Counter starts at rate_ms, must_send = true (cycle in progress)
- * 2. Counter ticks down every 24ms
- * 3. When FIG completes its cycle (complete_fig_transmitted = true):
+ * 1. Deadline starts at rate_ms, must_send = true (cycle in progress)
+ * 2. When FIG completes its cycle (complete_fig_transmitted = true):
  *    - must_send = false
- *    - deadline_ms = rate_ms (reset for next cycle)
- * 4. When deadline_ms reaches 0:
+ *    - deadline_ms = now + rate_ms, and the entry waits in the timer queue
+ * 3. When the clock reaches deadline_ms:
  *    - If must_send == true: VIOLATION (cycle didn't complete in time)
  *    - If must_send == false: Start new cycle (must_send = true)
- *      Note: DON'T reset deadline_ms here - it continues counting to track lateness
+ *      Note: deadline_ms is NOT moved here - it stays in the past to track lateness
+ *
+ * Nothing is done for an entry on frames where its deadline does not pass, so
+ * the cost of advancing the clock does not depend on the number of FIGs.
+ * Violations are evaluated when the cycle completes and when they are logged.
  *
  * In a lightly loaded mux:
  * - can_send completes cycles well before deadline
- * - deadline_ms gets reset early, must_send is briefly true then false
- * - When deadline_ms hits 0, must_send is false, so we just start new cycle
+ * - deadline_ms gets pushed back early, must_send is briefly true then false
+ * - When the deadline passes, must_send is false, so we just start new cycle
  *
  * In a heavily loaded mux:
  * - must_send stays true longer as cycle takes time to complete
- * - If deadline_ms hits 0 while must_send is true, violation is logged
+ * - If the deadline passes while must_send is true, violation is logged
  *
  * Repetition rate tracking (for debug/verification):
  * - last_cycle_complete_ms: Timestamp when last cycle completed
@@ -115,23 +119,33 @@ struct FIGEntryPriority {
     
     // Scheduling state
     bool must_send = false;         // Cycle is in progress, not yet complete
+    int64_t must_send_since_ms = 0; // Time at which must_send was set
     
     // Deadline monitoring
-    int deadline_ms = 0;            // Countdown timer - ONLY reset on cycle complete
+    int64_t deadline_ms = 0;        // Time the cycle is due - ONLY set on cycle complete
     int rate_ms = 0;                // Required repetition rate (from FIG_rate)
     bool deadline_violated = false; // Set if deadline expires before cycle completes
+    bool timer_queued = false;      // Entry is in the timer queue of the carousel
     
     // For future dynamic priority adjustment
     int assigned_priority = 0;      // Current priority assignment
     int base_priority = 0;          // Original priority assignment
     
+    // Links in the carousel of the priority level, front = least recently sent
+    FIGEntryPriority* prev = nullptr;
+    FIGEntryPriority* next = nullptr;
+    
+    // Number of the last FIB in which the must-send and can-send passes
+    // tried this FIG
+    uint64_t tried_must_send = 0;
+    uint64_t tried_can_send = 0;
+    
     // Repetition rate statistics (for verification)
     uint64_t last_cycle_complete_ms = 0;  // Timestamp of last completion
     uint64_t cycle_count = 0;             // Number of completed cycles
     uint64_t total_cycle_time_ms = 0;     // For calculating average
     uint64_t min_cycle_time_ms = UINT64_MAX;
     uint64_t max_cycle_time_ms = 0;
-    uint64_t current_time_ms = 0;         // Updated each frame
     
     std::string name() const {
         if (fig) {
@@ -142,59 +156,41 @@ struct FIGEntryPriority {
     
     // Returns true if this FIG has used more than the given percentage of its deadline
     // Used to prioritize FIGs that actually need bandwidth over those running ahead
-    bool past_deadline_percent(int percent) const {
-        // deadline_ms counts down from rate_ms
-        // If deadline_ms < rate_ms * (100 - percent) / 100, we're past that percent
-        // e.g., for 50%: if deadline_ms < rate_ms/2, we're past 50%
-        int threshold = rate_ms * (100 - percent) / 100;
-        return deadline_ms < threshold;
+    bool past_deadline_percent(int percent, int64_t now_ms) const {
+        // The time left until the deadline goes down from rate_ms
+        // If it is < rate_ms * (100 - percent) / 100, we're past that percent
+        // e.g., for 50%: if less than rate_ms/2 is left, we're past 50%
+        int64_t threshold = rate_ms * (100 - percent) / 100;
+        return deadline_ms - now_ms < threshold;
+    }
+    
+    // FIG 0/7 has special timing - only sent at framephase 0
+    // Give it an extra frame margin to avoid false violation warnings
+    int deadline_margin_ms() const {
+        return (fig->figtype() == 0 && fig->figextension() == 7) ? 24 : 0;
     }
     
     void init_deadline() {
         rate_ms = rate_increment_ms(fig->repetition_rate());
-        // FIG 0/7 has special timing - only sent at framephase 0
-        // Give it an extra frame margin to avoid false violation warnings
-        if (fig->figtype() == 0 && fig->figextension() == 7) {
-            deadline_ms = rate_ms + 24; // Extra frame margin
-        } else {
-            deadline_ms = rate_ms;
-        }
+        deadline_ms = rate_ms + deadline_margin_ms();
         must_send = true;  // Start with cycle due
     }
     
-    // Called every frame (24ms). Returns true if a new cycle should start.
-    bool tick_deadline(int elapsed_ms) {
-        current_time_ms += elapsed_ms;
-        deadline_ms -= elapsed_ms;
-        
-        if (deadline_ms <= 0) {
-            if (must_send) {
-                // Deadline expired but cycle not complete - VIOLATION
-                if (!deadline_violated) {
-                    deadline_violated = true;
-                }
-                // Don't start new cycle - current one isn't done yet
-                // Let deadline go negative to track how late we are
-                return false;
-            } else {
-                // Deadline expired and cycle is complete - start new cycle
-                // Note: We do NOT reset deadline_ms here. It was already reset
-                // when the cycle completed. If we're here, it means the cycle
-                // completed exactly on time or the counter wrapped.
-                // Actually, if must_send is false and deadline <= 0, the cycle
-                // completed and deadline was reset, then counted down again.
-                // So we should start a new cycle.
-                return true;
-            }
-        }
-        return false;
+    // True if the clock passed the deadline while must_send was set, at a frame
+    // later than since_ms. now_ms is the time of the current frame.
+    bool missed_deadline(int64_t now_ms, int64_t since_ms) const {
+        return must_send &&
+            now_ms > std::max(must_send_since_ms, since_ms) &&
+            now_ms >= deadline_ms;
     }
     
-    void on_cycle_complete() {
+    // Record the statistics and set the deadline of the next cycle.
+    // Does not change must_send, the carousel takes care of that.
+    void on_cycle_complete(int64_t now_ms) {
         // Track repetition rate statistics
         // Measures end-to-end cycle time (from one completion to the next)
         if (last_cycle_complete_ms > 0) {
-            uint64_t cycle_time = current_time_ms - last_cycle_complete_ms;
+            uint64_t cycle_time = now_ms - last_cycle_complete_ms;
             // Only count if meaningful time has passed (avoid artifacts from
             // multiple completions in same frame due to timing granularity)
             if (cycle_time > 0) {
@@ -204,27 +200,15 @@ struct FIGEntryPriority {
                 if (cycle_time > max_cycle_time_ms) max_cycle_time_ms = cycle_time;
             }
         }
-        last_cycle_complete_ms = current_time_ms;
+        last_cycle_complete_ms = now_ms;
         
-        // Reset deadline for next cycle
+        // Set deadline for next cycle
         // FIG 0/7 needs extra margin for framephase timing
-        if (fig->figtype() == 0 && fig->figextension() == 7) {
-            deadline_ms = rate_ms + 24;
-        } else {
-            deadline_ms = rate_ms;
-        }
-        must_send = false;
+        deadline_ms = now_ms + rate_ms + deadline_margin_ms();
         // Note: deadline_violated is NOT cleared here
         // It will be logged and cleared by the monitoring system
     }
     
-    void start_new_cycle() {
-        must_send = true;
-        // Note: Do NOT reset deadline_ms here!
-        // The deadline was reset when the previous cycle completed.
-        // If we reset here, we lose track of timing.
-    }
-    
     // Get average cycle time in ms (0 if no data)
     uint64_t avg_cycle_time_ms() const {
         return (cycle_count > 0) ? (total_cycle_time_ms / cycle_count) : 0;
@@ -244,15 +228,29 @@ struct FIGEntryPriority {
  * PriorityLevel - A priority class containing multiple FIGs
  *
  * Each priority has:
- * - poll_counter: Decrements on each FIG send, determines when this priority is due
- * - poll_reset_value: Value to reset counter to (2^priority for priorities 1+)
- * - carousel: Round-robin list of FIGs, front = least recently sent
+ * - poll_due: Value of the send counter of the carousel at which this priority is due
+ * - poll_reset_value: Number of sends until due again (2^priority for priorities 1+)
+ * - carousel: Round-robin list of FIGs, front = least recently sent. It is linked
+ *   through the entries themselves, so that moving a FIG is O(1).
  */
 struct PriorityLevel {
     int priority = 0;
-    int poll_counter = 0;
+    uint64_t poll_due = 0;
     int poll_reset_value = 1;
-    std::list<FIGEntryPriority*> carousel;
+    
+    FIGEntryPriority* front = nullptr;
+    FIGEntryPriority* back = nullptr;
+    size_t size = 0;
+    
+    // Number of FIGs in the carousel with must_send set
+    size_t num_must_send = 0;
+    
+    // Poll counter: how many sends until this priority is due, 0 if it is due
+    int poll_counter(uint64_t send_count) const {
+        return poll_due > send_count ? (int)(poll_due - send_count) : 0;
+    }
+    
+    void push_back(FIGEntryPriority* entry);
     
     // Find first FIG with must_send set
     FIGEntryPriority* find_must_send();
@@ -264,10 +262,13 @@ struct PriorityLevel {
     void move_to_back(FIGEntryPriority* entry);
     
     // Check if any FIG in this priority has must_send
-    bool has_must_send() const;
+    bool has_must_send() const { return num_must_send > 0; }
     
     // Check if carousel is non-empty
-    bool has_can_send() const;
+    bool has_can_send() const { return front != nullptr; }
+    
+private:
+    void unlink(FIGEntryPriority* entry);
 };
 
 /*
@@ -292,7 +293,8 @@ struct PriorityLevel {
  *    - Continue until FIB full or all FIGs tried
  *
  * Counter mechanism:
- * - All counters decrement when ANY FIG successfully sends
+ * - All counters decrement when ANY FIG successfully sends. The carousel counts
+ *   the sends, and each priority stores the count at which it is due.
  * - When a priority sends, its counter resets to poll_reset_value
  * - Priority with counter=0 (or lowest weighted score) is selected
  *
@@ -309,6 +311,14 @@ public:
     
     // Write all FIBs to buffer, returns bytes written
     size_t write_fibs(uint8_t* buf, uint64_t current_frame, bool fib3_present);
+
+    // See FIGRuntimeInformation::notify_fill()
+    void set_fill_observer(FIGRuntimeInformation::fill_observer_t observer) {
+        m_rti.fill_observer = observer;
+    }
+    
+    // FIB usage of the last frame written
+    const FICFillStats& last_frame_stats() const { return m_frame_stats; }
     
 private:
     // Fill a single FIB with FIG data
@@ -330,11 +340,17 @@ private:
     // Called after a FIG successfully sends from a priority
     void on_fig_sent(int priority);
     
-    // Decrement all poll counters (called on each successful FIG send)
-    void decrement_all_counters();
+    // Advance the clock by one frame, and start the cycles that are due
+    void advance_clock(int elapsed_ms);
+    
+    // Set or clear must_send, keeping the per-priority state up to date
+    void set_must_send(FIGEntryPriority* entry, bool must_send);
     
-    // Tick all deadline monitors (called each frame)
-    void tick_all_deadlines(int elapsed_ms);
+    // Called when a FIG completes its cycle
+    void on_cycle_complete(FIGEntryPriority* entry);
+    
+    // Put an entry whose cycle is complete in the timer queue
+    void queue_timer(FIGEntryPriority* entry);
     
     // Check and log any deadline violations
     void check_and_log_deadlines(uint64_t current_frame);
@@ -361,14 +377,34 @@ private:
     // Priority levels array
     std::array<PriorityLevel, NUM_PRIORITIES> m_priorities;
     
+    // Bit i is set if priority i has a FIG with must_send
+    uint32_t m_must_send_levels = 0;
+    
+    // Number of FIGs sent from priorities 1+, drives the poll counters
+    uint64_t m_send_count = 0;
+    
     // Priority stack: front = least recently sent from
-    std::list<int> m_priority_stack;
+    std::array<int, NUM_PRIORITIES - 1> m_priority_stack;
     
     // All FIG entries (owns the FIGEntryPriority objects)
     std::vector<std::unique_ptr<FIGEntryPriority>> m_all_entries;
     
-    // Track missed deadlines for periodic logging
-    std::unordered_set<std::string> m_missed_deadlines;
+    // Carousel clock, advances by 24ms every frame
+    int64_t m_now_ms = 0;
+    
+    // Entries waiting for their deadline to start a new cycle, as a min-heap
+    // on the deadline. The deadline of an entry can move later while it is
+    // queued, it then gets queued again when its old deadline passes.
+    using timer_t = std::pair<int64_t, FIGEntryPriority*>;
+    std::vector<timer_t> m_timers;
+    
+    // Time at which deadline violations were last logged
+    int64_t m_last_violation_check_ms = 0;
+    
+    // Number of the FIB being filled
+    uint64_t m_fib_count = 0;
+    
+    FICFillStats m_frame_stats;
     
     // Frame counter for rate statistics logging interval
     uint64_t m_stats_log_counter = 0;
@@ -38,6 +38,9 @@ FIGSchedulerType parse_scheduler_type(const std::string& type_str)
     if (lower == "priority") {
         return FIGSchedulerType::Priority;
     }
+    else if (lower == "edf") {
+        return FIGSchedulerType::EDF;
+    }
     else if (lower == "classic-rate-tuning") {
         return FIGSchedulerType::ClassicRateTuning;
     }
@@ -60,6 +63,8 @@ std::string scheduler_type_to_string(FIGSchedulerType type)
             return "classic-rate-tuning";
         case FIGSchedulerType::Priority:
             return "priority";
+        case FIGSchedulerType::EDF:
+            return "edf";
         default:
             return "unknown";
     }
@@ -37,11 +37,14 @@ namespace FIC {
  * ClassicRateTuning: Original ODR-DabMux deadline-based scheduler,
  *                    plus per-fig correction factors.
  * Priority: New priority-based scheduler with weighted round-robin
+ * EDF: Earliest deadline first on the nominal repetition rates, taking
+ *      into account the remaining bytes of every FIG
  */
 enum class FIGSchedulerType {
     Classic,
     ClassicRateTuning,
-    Priority
+    Priority,
+    EDF
 };
 
 // Parse scheduler type from config string
@@ -25,6 +25,7 @@
    */
 
 #include "input/Edi.h"
+#include "FrameTrace.h"
 
 #include <regex>
 #include <chrono>
@@ -53,7 +54,8 @@ Edi::Edi(const std::string& name, const dab_input_edi_config_t& config) :
     m_max_frames_overrun(config.buffer_size),
     m_num_frames_prebuffering(config.prebuffering),
     m_name(name),
-    m_stats(name)
+    m_stats(name),
+    m_trace_source(get_frame_trace().register_source(name))
 {
     constexpr bool VERBOSE = false;
     m_sti_decoder.set_verbose(VERBOSE);
@@ -433,7 +435,8 @@ void Edi::m_new_sti_frame_callback(EdiDecoder::sti_frame_t&& sti) {
         // We should not wait here, because we want the complete input buffering
         // happening inside m_frames. Using the blocking function is only a protection
         // against runaway memory usage if something goes wrong in the consumer.
-        m_frames.push_wait_if_full(std::move(sti), m_max_frames_overrun * 2);
+        const size_t queue_size = m_frames.push_wait_if_full(std::move(sti), m_max_frames_overrun * 2);
+        get_frame_trace().record(frametrace::event_type_t::InputReceived, m_trace_source, queue_size);
     }
 }
 
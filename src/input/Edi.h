@@ -124,6 +124,9 @@ class Edi : public InputBase, public RemoteControllable {
 
         std::string m_name;
         InputStat m_stats;
+
+        // Identifies the input in the frame trace, see FrameTrace.h
+        uint16_t m_trace_source;
 };
 
 };
@@ -28,7 +28,11 @@
 #include <cstdio>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include "input/File.h"
+#include "Eti.h"
 #include "mpeg.h"
 #include "ReedSolomon.h"
 
@@ -170,7 +174,8 @@ ssize_t FileBase::load_entire_file()
     } while (r > 0);
 
     close();
-    if (old_file_contents != m_file_contents) {
+    m_file_contents_changed = (old_file_contents != m_file_contents);
+    if (m_file_contents_changed) {
         etiLog.level(info) << "Loaded " << m_file_contents.size() << " bytes from " << m_filename;
     }
     m_file_open_alert_shown = false;
@@ -288,7 +293,358 @@ ssize_t FileBase::readFromFile(uint8_t *buffer, size_t size)
     return size;
 }
 
+/* Find all MPEG frames in the data, the same way readMpegHeader() and
+ * readMpegFrame() would when reading the file from start to end. */
+static MPEGFile::FrameIndex scan_mpeg_frames(const uint8_t *data, size_t len)
+{
+    MPEGFile::FrameIndex index;
+
+    size_t offset = 0;
+    while (offset + 4 <= len) {
+        const uint8_t *p = data + offset;
+        if (p[0] != 0xff or (p[1] & 0xe0) != 0xe0) {
+            offset++;
+            index.skipped_bytes++;
+            continue;
+        }
+
+        // mpegHeader uses unsigned long bitfields, don't let it read
+        // beyond the four header bytes
+        unsigned long header = 0;
+        memcpy(&header, p, 4);
+
+        const int framelength = getMpegFrameLength((mpegHeader*)&header);
+        if (framelength < 4 or framelength > UINT16_MAX) {
+            offset++;
+            index.skipped_bytes++;
+            continue;
+        }
+
+        if (offset + framelength > len) {
+            // Truncated frame at the end of the file
+            break;
+        }
+
+        MPEGFile::FrameIndexEntry entry;
+        entry.offset = offset;
+        memcpy(entry.header, p, 4);
+        entry.length = framelength;
+        entry.check = checkDabMpegFrame(&header);
+        index.frames.push_back(entry);
+
+        offset += framelength;
+    }
+
+    index.skipped_bytes += len - offset;
+    return index;
+}
+
+static int frame_frequency(const MPEGFile::FrameIndexEntry& frame)
+{
+    unsigned long header = 0;
+    memcpy(&header, frame.header, 4);
+    return getMpegFrequency(&header);
+}
+
+static MPEGFile::FrameIndex index_mpeg_file(int fd, const std::string& filename)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        throw runtime_error("Could not stat input file " + filename + ": " +
+                strerror(errno));
+    }
+
+    MPEGFile::FrameIndex index;
+    if (st.st_size > 0) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            throw runtime_error("Could not map input file " + filename + ": " +
+                    strerror(errno));
+        }
+        madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+        index = scan_mpeg_frames(reinterpret_cast<const uint8_t*>(map), st.st_size);
+        munmap(map, st.st_size);
+    }
+
+    index.file_size = st.st_size;
+    index.file_mtime = st.st_mtim;
+    return index;
+}
+
+void MPEGFile::open(const std::string& name)
+{
+    FileBase::open(name);
+
+    m_parity = false;
+    m_index.reset();
+    m_index_pos = 0;
+
+    // Pipes cannot be indexed, their frames are parsed as they come
+    if (m_nonblock) {
+        return;
+    }
+
+    if (m_load_entire_file) {
+        m_index = scan_mpeg_frames(m_file_contents.data(), m_file_contents.size());
+        reportIndex();
+        return;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == -1 or not S_ISREG(st.st_mode)) {
+        return;
+    }
+
+    if (m_background_indexing) {
+        // The thread gets its own descriptor, so that it doesn't
+        // depend on m_fd still being open
+        const int fd = dup(m_fd);
+        if (fd == -1) {
+            throw runtime_error("Could not dup input file descriptor: " +
+                    string(strerror(errno)));
+        }
+        m_index_future = std::async(std::launch::async,
+                [fd, name]() {
+                    try {
+                        auto index = index_mpeg_file(fd, name);
+                        ::close(fd);
+                        return index;
+                    }
+                    catch (...) {
+                        ::close(fd);
+                        throw;
+                    }
+                });
+    }
+    else {
+        m_index = index_mpeg_file(m_fd, name);
+        reportIndex();
+    }
+}
+
+void MPEGFile::close()
+{
+    // The index is kept, because load_entire_file() also closes the file
+    if (m_index_future.valid()) {
+        m_index_future.wait();
+        m_index_future = {};
+    }
+    FileBase::close();
+}
+
+void MPEGFile::setBackgroundIndexing(bool background_indexing)
+{
+    m_background_indexing = background_indexing;
+}
+
+void MPEGFile::reportIndex() const
+{
+    if (not m_index) {
+        return;
+    }
+
+    const auto& frames = m_index->frames;
+
+    if (frames.empty()) {
+        etiLog.level(error) << "MPEG file " << m_filename <<
+            " contains no valid MPEG frame";
+        return;
+    }
+
+    etiLog.level(info) << "Indexed " << frames.size() << " MPEG frames in " <<
+        m_filename;
+
+    if (m_index->skipped_bytes > 0) {
+        etiLog.level(warn) << "MPEG file " << m_filename << " contains " <<
+            m_index->skipped_bytes << " bytes outside of valid MPEG frames";
+    }
+
+    size_t num_frequency = 0, num_padding = 0, num_emphasis = 0, num_invalid = 0;
+    for (const auto& frame : frames) {
+        switch (frame.check) {
+            case 0:
+            case MPEG_COPYRIGHT:
+            case MPEG_ORIGINAL:
+                break;
+            case MPEG_FREQUENCY: num_frequency++; break;
+            case MPEG_PADDING: num_padding++; break;
+            case MPEG_EMPHASIS: num_emphasis++; break;
+            default: num_invalid++; break;
+        }
+    }
+
+    if (num_frequency) {
+        etiLog.level(error) << "MPEG file " << m_filename << " has " <<
+            num_frequency << " frames with an invalid frequency, should be 48000 or 24000";
+    }
+    if (num_padding) {
+        etiLog.level(warn) << "MPEG file " << m_filename << " has " <<
+            num_padding << " frames with padding bit set";
+    }
+    if (num_emphasis) {
+        etiLog.level(warn) << "MPEG file " << m_filename << " has " <<
+            num_emphasis << " frames with emphasis bits set";
+    }
+    if (num_invalid) {
+        etiLog.level(error) << "MPEG file " << m_filename << " has " <<
+            num_invalid << " invalid DAB mpeg frames";
+    }
+}
+
+bool MPEGFile::collectBackgroundIndex(bool wait)
+{
+    if (not m_index_future.valid()) {
+        return m_index.has_value();
+    }
+
+    if (not wait and
+            m_index_future.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return false;
+    }
+
+    try {
+        m_index = m_index_future.get();
+        reportIndex();
+    }
+    catch (const runtime_error& e) {
+        etiLog.level(error) << "Could not index MPEG file " << m_filename <<
+            ", frames will be parsed while reading: " << e.what();
+        return false;
+    }
+
+    // Continue with the first frame following what was already read
+    const off_t pos = ::lseek(m_fd, 0, SEEK_CUR);
+    const auto& frames = m_index->frames;
+    const auto it = std::lower_bound(frames.cbegin(), frames.cend(), pos,
+            [](const FrameIndexEntry& e, off_t o) { return (off_t)e.offset < o; });
+    m_index_pos = std::distance(frames.cbegin(), it);
+
+    return true;
+}
+
+bool MPEGFile::copyFromFile(uint64_t offset, uint8_t *buffer, size_t len)
+{
+    if (m_load_entire_file) {
+        if (offset + len > m_file_contents.size()) {
+            return false;
+        }
+        copy(m_file_contents.cbegin() + offset,
+                m_file_contents.cbegin() + offset + len, buffer);
+        return true;
+    }
+
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t ret = pread(m_fd, buffer + done, len - done, offset + done);
+        if (ret == -1 and errno == EINTR) {
+            continue;
+        }
+        else if (ret <= 0) {
+            return false;
+        }
+        done += ret;
+    }
+    return true;
+}
+
+void MPEGFile::refreshIndex()
+{
+    if (m_load_entire_file) {
+        // Reload the file, this allows the user to replace its contents
+        if (load_entire_file() == -1) {
+            m_index->frames.clear();
+        }
+        else if (m_file_contents_changed) {
+            m_index = scan_mpeg_frames(m_file_contents.data(), m_file_contents.size());
+            reportIndex();
+        }
+        return;
+    }
+
+    struct stat st;
+    if (fstat(m_fd, &st) == -1) {
+        etiLog.level(error) << "Could not stat input file " << m_filename <<
+            ": " << strerror(errno);
+        return;
+    }
+
+    if (st.st_size != m_index->file_size or
+            st.st_mtim.tv_sec != m_index->file_mtime.tv_sec or
+            st.st_mtim.tv_nsec != m_index->file_mtime.tv_nsec) {
+        etiLog.level(info) << "MPEG file " << m_filename <<
+            " was modified, rebuilding its index";
+        try {
+            m_index = index_mpeg_file(m_fd, m_filename);
+            reportIndex();
+        }
+        catch (const runtime_error& e) {
+            etiLog.level(error) << e.what();
+            m_index->frames.clear();
+        }
+    }
+}
+
 size_t MPEGFile::readFrame(uint8_t *buffer, size_t size)
+{
+    // Never switch to the index in the middle of a 24kHz frame
+    if (m_index or (not m_parity and collectBackgroundIndex(false))) {
+        return readFrameFromIndex(buffer, size);
+    }
+    return readFrameFromStream(buffer, size);
+}
+
+size_t MPEGFile::readFrameFromIndex(uint8_t *buffer, size_t size)
+{
+    if (m_index_pos >= m_index->frames.size()) {
+        m_index_pos = 0;
+        refreshIndex();
+    }
+
+    const auto& frames = m_index->frames;
+    if (frames.empty()) {
+        memset(buffer, 0, size);
+        return 0;
+    }
+
+    const auto& frame = frames[m_index_pos];
+
+    // At 24kHz, a frame lasts 48ms and is spread over two ETI frames
+    const bool half_rate = frame.length > size and
+        frame_frequency(frame) == 24000;
+
+    if (frame.length > size and not half_rate) {
+        // Reported in setBitrate()
+        m_index_pos++;
+        memset(buffer, 0, size);
+        return 0;
+    }
+
+    const size_t start = m_parity ? size : 0;
+    const size_t len = std::min<size_t>(frame.length - std::min<size_t>(start, frame.length), size);
+
+    if (half_rate and not m_parity) {
+        m_parity = true;
+    }
+    else {
+        m_parity = false;
+        m_index_pos++;
+    }
+
+    if (not copyFromFile(frame.offset + start, buffer, len)) {
+        etiLog.level(error) << "Can't read MPEG frame from file " << m_filename;
+        memset(buffer, 0, size);
+        return 0;
+    }
+
+    if (len < size) {
+        memset(buffer + len, 0, size - len);
+    }
+
+    return size;
+}
+
+size_t MPEGFile::readFrameFromStream(uint8_t *buffer, size_t size)
 {
     int result;
     bool do_rewind = false;
@@ -392,10 +748,52 @@ int MPEGFile::setBitrate(int bitrate)
     if (bitrate < 0) {
         throw invalid_argument("Invalid bitrate " + to_string(bitrate));
     }
+
+    if (collectBackgroundIndex(bitrate == 0)) {
+        const auto& frames = m_index->frames;
+        if (frames.empty()) {
+            return bitrate == 0 ? -1 : bitrate;
+        }
+
+        if (bitrate == 0) {
+            unsigned long header = 0;
+            memcpy(&header, frames[0].header, 4);
+            bitrate = getMpegBitrate(&header);
+        }
+
+        // Report the frames that don't fit the subchannel once, instead
+        // of every time they are read.
+        const size_t size = bitrate * 3;
+        size_t num_too_long = 0, num_too_short = 0;
+        for (const auto& frame : frames) {
+            const size_t expected_length =
+                frame_frequency(frame) == 24000 ? 2 * size : size;
+
+            if (frame.length > expected_length) {
+                num_too_long++;
+            }
+            else if (frame.length < expected_length) {
+                num_too_short++;
+            }
+        }
+
+        if (num_too_long) {
+            etiLog.level(warn) << "MPEG file " << m_filename << " has " <<
+                num_too_long << " frames with a bitrate higher than " <<
+                bitrate << " kbps, they will be muted";
+        }
+        if (num_too_short) {
+            etiLog.level(warn) << "MPEG file " << m_filename << " has " <<
+                num_too_short << " frames with a bitrate lower than " <<
+                bitrate << " kbps, they will be padded";
+        }
+
+        return bitrate;
+    }
     else if (bitrate == 0) {
         uint8_t buffer[4];
 
-        if (readFrame(buffer, 4) == 0) {
+        if (readFrameFromStream(buffer, 4) == 0) {
             bitrate = getMpegBitrate(buffer);
         }
         else {
@@ -411,6 +809,207 @@ size_t RawFile::readFrame(uint8_t *buffer, size_t size)
     return readFromFile(buffer, size);
 }
 
+EtiRecordingFile::EtiRecordingFile(uint8_t subchannel_id, std::time_t start_time) :
+    m_subchannel_id(subchannel_id),
+    m_start_time(start_time),
+    m_frame(6144)
+{ }
+
+void EtiRecordingFile::setNonblocking(bool nonblock)
+{
+    if (nonblock) {
+        throw runtime_error("ETI recording input does not support nonblock");
+    }
+}
+
+void EtiRecordingFile::setLoadEntireFile(bool load_entire_file)
+{
+    if (load_entire_file) {
+        throw runtime_error("ETI recording input does not support load_entire_file");
+    }
+}
+
+void EtiRecordingFile::open(const std::string& name)
+{
+    FileBase::open(name);
+
+    const string index_name = name + ".idx";
+    int index_fd = ::open(index_name.c_str(), O_RDONLY);
+    if (index_fd == -1) {
+        throw runtime_error("Could not open recording index " + index_name +
+                ": " + strerror(errno));
+    }
+
+    eti_index_header header;
+    if (pread(index_fd, &header, sizeof(header), 0) != sizeof(header) or
+            memcmp(header.magic, ETI_INDEX_MAGIC, sizeof(header.magic)) != 0 or
+            header.entry_size != sizeof(eti_index_entry)) {
+        ::close(index_fd);
+        throw runtime_error("Recording index " + index_name + " is invalid");
+    }
+    m_file_type = header.file_type;
+
+    struct stat st;
+    if (fstat(index_fd, &st) == -1) {
+        ::close(index_fd);
+        throw runtime_error("Could not stat recording index " + index_name +
+                ": " + strerror(errno));
+    }
+    const size_t num_entries = (st.st_size - sizeof(header)) / sizeof(eti_index_entry);
+
+    auto read_entry = [&](size_t i) {
+        eti_index_entry entry;
+        const off_t pos = sizeof(header) + i * sizeof(eti_index_entry);
+        if (pread(index_fd, &entry, sizeof(entry), pos) != sizeof(entry)) {
+            ::close(index_fd);
+            throw runtime_error("Could not read recording index " + index_name);
+        }
+        return entry;
+    };
+
+    m_start_offset = (m_file_type == ETI_FILE_TYPE_FRAMED) ? 4 : 0;
+
+    if (m_start_time != 0 and num_entries > 0) {
+        // Binary search for the first frame written at or after the start time
+        const int64_t start_ms = (int64_t)m_start_time * 1000;
+        size_t lo = 0;
+        size_t hi = num_entries;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (read_entry(mid).wallclock_ms < start_ms) {
+                lo = mid + 1;
+            }
+            else {
+                hi = mid;
+            }
+        }
+
+        if (lo == num_entries) {
+            etiLog.level(warn) << "Recording " << name <<
+                " ends before the start time, replaying from the beginning";
+        }
+        else {
+            m_start_offset = read_entry(lo).offset;
+            etiLog.level(info) << "Replaying " << name << " from frame " << lo <<
+                " at offset " << m_start_offset;
+        }
+    }
+    ::close(index_fd);
+
+    if (rewind() == -1) {
+        throw runtime_error("Could not seek in recording " + name + ": " +
+                strerror(errno));
+    }
+}
+
+ssize_t EtiRecordingFile::rewind()
+{
+    return ::lseek(m_fd, m_start_offset, SEEK_SET);
+}
+
+ssize_t EtiRecordingFile::readEtiFrame(size_t& subchannel_length)
+{
+    size_t frame_size = 6144;
+    if (m_file_type == ETI_FILE_TYPE_STREAMED or m_file_type == ETI_FILE_TYPE_FRAMED) {
+        uint16_t len = 0;
+        if (readFromFile(reinterpret_cast<uint8_t*>(&len), 2) != 2 or len > 6144) {
+            throw runtime_error("Invalid frame length");
+        }
+        frame_size = len;
+    }
+    else if (m_file_type != ETI_FILE_TYPE_RAW) {
+        throw runtime_error("Unsupported recording type");
+    }
+
+    if (frame_size < 12 or readFromFile(m_frame.data(), frame_size) != (ssize_t)frame_size) {
+        throw runtime_error("Could not read frame");
+    }
+
+    const eti_SYNC *sync = reinterpret_cast<const eti_SYNC*>(m_frame.data());
+    if (sync->FSYNC != 0x49C5F8 and sync->FSYNC != (0x49C5F8 ^ 0xFFFFFF)) {
+        throw runtime_error("Frame has invalid FSYNC");
+    }
+
+    eti_FC *fc = reinterpret_cast<eti_FC*>(m_frame.data() + 4);
+    const size_t ficl = fc->FICF ? (fc->MID == 3 ? 128 : 96) : 0;
+
+    // MST follows FC, the STC of each subchannel and EOH
+    size_t position = 8 + 4 * fc->NST + 4 + ficl;
+    for (size_t i = 0; i < fc->NST; i++) {
+        eti_STC *stc = reinterpret_cast<eti_STC*>(m_frame.data() + 8 + 4 * i);
+        const size_t length = stc->getSTL() * 8;
+        if (stc->SCID == m_subchannel_id) {
+            if (position + length > frame_size) {
+                throw runtime_error("Frame is truncated");
+            }
+            subchannel_length = length;
+            return position;
+        }
+        position += length;
+    }
+    return -1;
+}
+
+size_t EtiRecordingFile::readFrame(uint8_t *buffer, size_t size)
+{
+    size_t length = 0;
+    ssize_t position = -1;
+    try {
+        position = readEtiFrame(length);
+    }
+    catch (const runtime_error& e) {
+        etiLog.level(error) << "ETI recording " << m_filename << ": " <<
+            e.what() << " -> rewinding";
+        rewind();
+        memset(buffer, 0, size);
+        return 0;
+    }
+
+    if (position == -1) {
+        if (not m_subchannel_missing_shown) {
+            etiLog.level(warn) << "ETI recording " << m_filename <<
+                " has frames without subchannel " << (int)m_subchannel_id <<
+                " -> frame muted";
+            m_subchannel_missing_shown = true;
+        }
+        memset(buffer, 0, size);
+        return 0;
+    }
+    m_subchannel_missing_shown = false;
+
+    const size_t len = std::min(length, size);
+    copy(m_frame.cbegin() + position, m_frame.cbegin() + position + len, buffer);
+    if (len < size) {
+        memset(buffer + len, 0, size - len);
+    }
+    return size;
+}
+
+int EtiRecordingFile::setBitrate(int bitrate)
+{
+    if (bitrate < 0) {
+        throw invalid_argument("Invalid bitrate " + to_string(bitrate));
+    }
+    else if (bitrate == 0) {
+        // Take the bitrate from the subchannel size in the first frame
+        size_t length = 0;
+        try {
+            if (readEtiFrame(length) != -1) {
+                bitrate = length / 3;
+            }
+        }
+        catch (const runtime_error& e) {
+            etiLog.level(error) << "ETI recording " << m_filename << ": " << e.what();
+        }
+        rewind();
+
+        if (bitrate == 0) {
+            bitrate = -1;
+        }
+    }
+    return bitrate;
+}
+
 PacketFile::PacketFile(bool enhancedPacketMode)
 {
     m_enhancedPacketEnabled = enhancedPacketMode;
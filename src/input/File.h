@@ -29,6 +29,9 @@
 #include <array>
 #include <string>
 #include <cstdint>
+#include <future>
+#include <optional>
+#include <ctime>
 #include "input/inputs.h"
 #include "ManagementServer.h"
 
@@ -68,16 +71,69 @@ class FileBase : public InputBase {
 
         size_t m_file_contents_offset = 0;
         std::vector<uint8_t> m_file_contents;
+        // Set by load_entire_file() when the new contents differ from the previous ones
+        bool m_file_contents_changed = false;
         bool m_file_open_alert_shown = false;
 };
 
 class MPEGFile : public FileBase {
     public:
+        virtual void open(const std::string& name);
         virtual size_t readFrame(uint8_t *buffer, size_t size);
         virtual int setBitrate(int bitrate);
+        virtual void close();
+
+        /* Scan the file for the frame index in a separate thread, so that
+         * open() doesn't have to wait for it. Until the index is ready,
+         * frames are parsed from the file as they are read. */
+        void setBackgroundIndexing(bool background_indexing);
+
+        /* The file gets scanned once when it is opened, and every
+         * MPEG frame found is recorded in the index. readFrame then
+         * only needs to copy the frame from the position given in the
+         * index, and every loop of the file reuses the same index.
+         */
+        struct FrameIndexEntry {
+            uint64_t offset = 0;
+            uint8_t header[4] = {};
+            uint16_t length = 0;
+            // Result of checkDabMpegFrame()
+            int16_t check = 0;
+        };
+
+        struct FrameIndex {
+            std::vector<FrameIndexEntry> frames;
+            // Number of bytes that are not part of a valid MPEG frame
+            size_t skipped_bytes = 0;
+
+            // Used to detect if the file was modified since it was indexed
+            off_t file_size = 0;
+            struct timespec file_mtime = {};
+        };
 
     private:
+        size_t readFrameFromIndex(uint8_t *buffer, size_t size);
+        size_t readFrameFromStream(uint8_t *buffer, size_t size);
+
+        /* Copy len bytes at offset from the file or the loaded contents.
+         * Returns false on failure. */
+        bool copyFromFile(uint64_t offset, uint8_t *buffer, size_t len);
+
+        /* Take over the index built in the background once it is
+         * available. Returns true if an index is available. */
+        bool collectBackgroundIndex(bool wait);
+
+        // Called when the file loops, rebuilds the index if the file changed
+        void refreshIndex();
+
+        void reportIndex() const;
+
         bool m_parity = false;
+        bool m_background_indexing = false;
+
+        std::optional<FrameIndex> m_index;
+        std::future<FrameIndex> m_index_future;
+        size_t m_index_pos = 0;
 };
 
 class RawFile : public FileBase {
@@ -85,6 +141,40 @@ class RawFile : public FileBase {
         virtual size_t readFrame(uint8_t *buffer, size_t size);
 };
 
+/* Replays one subchannel from an ETI recording made by a segmented file
+ * output. The sidecar index is used to seek to the frame written at
+ * start_time, and the replay loops back to that frame at the end of the file.
+ */
+class EtiRecordingFile : public FileBase {
+    public:
+        /* start_time is a UNIX timestamp, 0 to start at the beginning */
+        EtiRecordingFile(uint8_t subchannel_id, std::time_t start_time);
+
+        virtual void open(const std::string& name);
+        virtual size_t readFrame(uint8_t *buffer, size_t size);
+        virtual int setBitrate(int bitrate);
+
+        virtual void setNonblocking(bool nonblock);
+        virtual void setLoadEntireFile(bool load_entire_file);
+
+    protected:
+        virtual ssize_t rewind();
+
+    private:
+        /* Read the next ETI frame into m_frame, and return the
+         * position of the subchannel data in it, or -1 if the subchannel
+         * is not present. Throws on read errors.
+         */
+        ssize_t readEtiFrame(size_t& subchannel_length);
+
+        uint8_t m_subchannel_id;
+        std::time_t m_start_time;
+        uint32_t m_file_type = 0;
+        off_t m_start_offset = 0;
+        std::vector<uint8_t> m_frame;
+        bool m_subchannel_missing_shown = false;
+};
+
 class PacketFile : public FileBase {
     public:
         PacketFile(bool enhancedPacketMode);
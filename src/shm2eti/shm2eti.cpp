@@ -0,0 +1,178 @@
+/*
+   Copyright (C) 2025
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Reads the ETI frames from the shm:// output of ODR-DabMux and writes
+   them to stdout. Also serves as example for the shmEti reader.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include "dabOutput/shmEti.h"
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+constexpr int READ_TIMEOUT_MS = 1000;
+
+static void usage()
+{
+    using namespace std;
+
+    cerr << "Usage:" << endl;
+    cerr << "odr-shm2eti [-t raw|streamed] [-v] <name>" << endl << endl;
+
+    cerr << "Where" << endl;
+    cerr << " <name> is the name of an ODR-DabMux shm:// output." << endl << endl;
+    cerr << " -t raw       Write 6144 byte frames, padded with 0x55 (default)." << endl;
+    cerr << " -t streamed  Write every frame preceded by its length (2 bytes, little endian)." << endl;
+    cerr << " -v           Print the metadata of every frame to stderr." << endl << endl;
+
+    cerr << "The ETI frames are written to stdout. The shared memory is opened again" << endl;
+    cerr << "if no frame is received for " << READ_TIMEOUT_MS << "ms, e.g. when ODR-DabMux restarts." << endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 and strcmp(argv[1], "--version") == 0) {
+        fprintf(stdout, "%s\n",
+#if defined(GITVERSION)
+                GITVERSION
+#else
+                PACKAGE_VERSION
+#endif
+               );
+        return 0;
+    }
+
+    bool streamed = false;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "t:vh")) != -1) {
+        switch (ch) {
+            case 't':
+                if (strcmp(optarg, "raw") == 0) {
+                    streamed = false;
+                }
+                else if (strcmp(optarg, "streamed") == 0) {
+                    streamed = true;
+                }
+                else {
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        usage();
+        return 1;
+    }
+
+    const std::string name = argv[optind];
+
+    // Frames are copied out of the shared memory before they are written,
+    // so that a slow stdout does not block the ring.
+    std::array<uint8_t, 2 + SHM_ETI_MAX_FRAME_SIZE> buf;
+    uint64_t last_dropped = 0;
+
+    while (true) {
+        std::unique_ptr<ShmEtiReader> reader;
+        try {
+            reader = std::make_unique<ShmEtiReader>(name);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            continue;
+        }
+        last_dropped = 0;
+
+        ShmEtiReader::frame_t frame;
+        while (reader->next(frame, READ_TIMEOUT_MS)) {
+            uint8_t *data = streamed ? buf.data() + 2 : buf.data();
+            memcpy(data, frame.data, frame.length);
+
+            if (not reader->valid(frame)) {
+                std::cerr << "Frame " << frame.seq << " overwritten while reading" << std::endl;
+                continue;
+            }
+
+            if (reader->num_dropped() != last_dropped) {
+                std::cerr << "Dropped " << reader->num_dropped() - last_dropped <<
+                    " frames" << std::endl;
+                last_dropped = reader->num_dropped();
+            }
+
+            if (verbose) {
+                std::cerr << "Frame " << frame.seq << " length " << frame.length;
+                if (frame.flags & SHM_ETI_HAS_UTCO) {
+                    std::cerr << " utco " << frame.utco;
+                }
+                if (frame.flags & SHM_ETI_HAS_EDI_TIME) {
+                    std::cerr << " edi_time " << frame.edi_seconds;
+                }
+                if (frame.flags & SHM_ETI_HAS_DLFC) {
+                    std::cerr << " dlfc " << frame.dlfc;
+                }
+                std::cerr << std::endl;
+            }
+
+            size_t len = frame.length;
+            if (streamed) {
+                buf[0] = len & 0xFF;
+                buf[1] = (len >> 8) & 0xFF;
+                len += 2;
+            }
+            else {
+                memset(data + len, 0x55, SHM_ETI_MAX_FRAME_SIZE - len);
+                len = SHM_ETI_MAX_FRAME_SIZE;
+            }
+
+            if (fwrite(buf.data(), len, 1, stdout) != 1) {
+                perror("write failed");
+                return 1;
+            }
+            fflush(stdout);
+        }
+
+        std::cerr << "No frame received, opening " << name << " again" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+   Copyright (C) 2026
+   Matthias P. Braendli, matthias.braendli@mpb.li
+
+    http://www.opendigitalradio.org
+
+   Prints the frame trace files that ODR-DabMux writes when asked to
+   dump its trace.
+   */
+/*
+   This file is part of ODR-DabMux.
+
+   ODR-DabMux is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as
+   published by the Free Software Foundation, either version 3 of the
+   License, or (at your option) any later version.
+
+   ODR-DabMux is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with ODR-DabMux.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef HAVE_CONFIG_H
+#   include "config.h"
+#endif
+
+#include "FrameTraceFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+static void usage()
+{
+    using namespace std;
+
+    cerr << "Usage:" << endl;
+    cerr << "odr-trace2txt [-s source] <file>" << endl << endl;
+
+    cerr << "Where" << endl;
+    cerr << " <file> is a trace written by ODR-DabMux, on SIGUSR1 or through" << endl;
+    cerr << "        the dump parameter of the trace remote control." << endl;
+    cerr << " -s source  Only print the events of the given input or output," << endl;
+    cerr << "            and the start of the frames." << endl << endl;
+
+    cerr << "Prints one event per line, with its UTC time and frame number." << endl;
+}
+
+static std::string format_time(uint64_t time_ns)
+{
+    const time_t seconds = time_ns / 1000000000;
+    struct tm t;
+    gmtime_r(&seconds, &t);
+
+    char buf[64];
+    const size_t len = strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &t);
+    snprintf(buf + len, sizeof(buf) - len, ".%06luZ",
+            (unsigned long)(time_ns % 1000000000) / 1000);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 2 and strcmp(argv[1], "--version") == 0) {
+        fprintf(stdout, "%s\n",
+#if defined(GITVERSION)
+                GITVERSION
+#else
+                PACKAGE_VERSION
+#endif
+               );
+        return 0;
+    }
+
+    std::string source_filter;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "s:h")) != -1) {
+        switch (ch) {
+            case 's':
+                source_filter = optarg;
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 1) {
+        usage();
+        return 1;
+    }
+
+    frametrace::trace_file_t trace;
+    try {
+        trace = frametrace::read_trace_file(argv[optind]);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // The events of different threads can be slightly out of order
+    std::stable_sort(trace.events.begin(), trace.events.end(),
+            [](const frametrace::event_t& a, const frametrace::event_t& b) {
+                return a.time_ns < b.time_ns;
+            });
+
+    size_t source_index = trace.sources.size();
+    if (not source_filter.empty()) {
+        const auto it = std::find(trace.sources.begin(), trace.sources.end(), source_filter);
+        if (it == trace.sources.end()) {
+            std::cerr << "Source " << source_filter << " not in the trace. Sources:" << std::endl;
+            for (const auto& source : trace.sources) {
+                std::cerr << " " << source << std::endl;
+            }
+            return 1;
+        }
+        source_index = it - trace.sources.begin();
+    }
+
+    for (const auto& event : trace.events) {
+        if (not source_filter.empty()) {
+            switch (event.type) {
+                case frametrace::event_type_t::FrameBegin:
+                    break;
+                case frametrace::event_type_t::Fib:
+                case frametrace::event_type_t::EdiWrite:
+                    continue;
+                default:
+                    if (event.source != source_index) {
+                        continue;
+                    }
+                    break;
+            }
+        }
+
+        std::cout << format_time(event.time_ns) << " " << event.frame << " " <<
+            frametrace::describe_event(event, trace.sources) << "\n";
+    }
+
+    return 0;
+}
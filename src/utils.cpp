@@ -103,6 +103,9 @@ void header_message()
 #endif
 #if defined(HAVE_OUTPUT_SIMUL)
     " simul" <<
+#endif
+#if defined(HAVE_OUTPUT_SHM)
+    " shm" <<
 #endif
     " edi zmq\n\n";
 
@@ -26,28 +26,206 @@
 */
 
 #include "dabOutput/dabOutput.h"
+#include "FrameClock.h"
 #include "Log.h"
 #include "zmq.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <thread>
 #include <vector>
+#include <unistd.h>
 
 constexpr size_t MAX_ERROR_COUNT = 10;
 constexpr size_t MAX_NUM_RESETS = 180;
 constexpr long ZMQ_TIMEOUT_MS = 1000;
 
+constexpr size_t DEFAULT_PREFILL = 8;
+constexpr size_t DEFAULT_RING_SIZE = 64;
+
+// Writer statistics are printed every 10 seconds
+constexpr size_t STATS_INTERVAL_FRAMES = 10000 / 24;
+
+/* Frames received from ZMQ wait in this ring until the writer thread gives
+ * them to the card. All slots are allocated up front. There is exactly one
+ * producer (the receive thread) and one consumer (the writer thread).
+ */
+class FrameRing
+{
+    public:
+        struct slot_t {
+            std::array<uint8_t, 6144> data;
+            size_t len = 0;
+        };
+
+        FrameRing(size_t capacity) : m_slots(capacity + 1) {}
+
+        size_t capacity() const { return m_slots.size() - 1; }
+
+        size_t fill() const {
+            const size_t head = m_head.load(std::memory_order_acquire);
+            const size_t tail = m_tail.load(std::memory_order_acquire);
+            return (head + m_slots.size() - tail) % m_slots.size();
+        }
+
+        /* Copy a frame into the ring. Returns false if the ring is full. */
+        bool push(const uint8_t *data, size_t len) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            const size_t next = (head + 1) % m_slots.size();
+            if (next == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            memcpy(m_slots[head].data.data(), data, len);
+            m_slots[head].len = len;
+            m_head.store(next, std::memory_order_release);
+            return true;
+        }
+
+        /* Returns the oldest frame, or nullptr if the ring is empty. The slot
+         * stays valid until pop() is called. */
+        const slot_t* front() const {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire)) {
+                return nullptr;
+            }
+            return &m_slots[tail];
+        }
+
+        void pop() {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            m_tail.store((tail + 1) % m_slots.size(), std::memory_order_release);
+        }
+
+    private:
+        std::vector<slot_t> m_slots;
+        std::atomic<size_t> m_head = ATOMIC_VAR_INIT(0);
+        std::atomic<size_t> m_tail = ATOMIC_VAR_INIT(0);
+};
+
+/* Gives the frames from the ring to the card, one every 24ms. It waits
+ * until the ring contains prefill frames before it starts, and again after
+ * every underrun.
+ */
+class FrameWriter
+{
+    public:
+        FrameWriter(DabOutputRaw& output, FrameRing& ring, size_t prefill) :
+            m_output(output), m_ring(ring), m_prefill(prefill),
+            m_clock(FrameClock::config_t()) {}
+
+        FrameWriter(const FrameWriter&) = delete;
+        FrameWriter& operator=(const FrameWriter&) = delete;
+
+        ~FrameWriter() {
+            m_running = false;
+            if (m_thread.joinable()) {
+                m_thread.join();
+            }
+        }
+
+        void start() {
+            m_running = true;
+            m_thread = std::thread(&FrameWriter::process, this);
+        }
+
+        /* Called by the receive thread for every frame pushed into the ring */
+        void frame_received() { m_received_since_tick++; }
+
+        void overrun() { m_overruns++; }
+
+    private:
+        void wait_for_prefill() {
+            while (m_running and m_ring.fill() < m_prefill) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            }
+            m_received_since_tick = 0;
+            m_clock.start();
+        }
+
+        void process() {
+            size_t frame_count = 0;
+            size_t underruns = 0;
+            size_t write_errors = 0;
+            size_t max_burst = 0;
+            size_t min_fill = m_ring.capacity();
+            size_t max_fill = 0;
+
+            wait_for_prefill();
+
+            while (m_running) {
+                m_clock.wait_next_frame();
+
+                // Frames received during one frame interval
+                max_burst = std::max(max_burst, m_received_since_tick.exchange(0));
+
+                const size_t fill = m_ring.fill();
+                min_fill = std::min(min_fill, fill);
+                max_fill = std::max(max_fill, fill);
+
+                const auto *slot = m_ring.front();
+                if (slot == nullptr) {
+                    underruns++;
+                    etiLog.level(warn) << "Buffer underrun, prefilling " <<
+                        m_prefill << " frames";
+                    wait_for_prefill();
+                    continue;
+                }
+
+                if (m_output.Write((void*)slot->data.data(), slot->len) == -1) {
+                    write_errors++;
+                }
+                m_ring.pop();
+                frame_count++;
+
+                if (frame_count % STATS_INTERVAL_FRAMES == 0) {
+                    etiLog.level(info) << "Transmitted " << frame_count <<
+                        " ETI frames, buffer fill " << min_fill << "-" <<
+                        max_fill << "/" << m_ring.capacity() <<
+                        ", underruns " << underruns <<
+                        ", overruns " << m_overruns.load() <<
+                        ", max burst " << max_burst <<
+                        ", max lateness " <<
+                        m_clock.get_parameter("max_lateness") << "us" <<
+                        ", write errors " << write_errors;
+                    min_fill = m_ring.capacity();
+                    max_fill = 0;
+                    max_burst = 0;
+                }
+            }
+        }
+
+        DabOutputRaw& m_output;
+        FrameRing& m_ring;
+        const size_t m_prefill;
+        FrameClock m_clock;
+
+        std::atomic<bool> m_running = ATOMIC_VAR_INIT(false);
+        std::atomic<size_t> m_received_since_tick = ATOMIC_VAR_INIT(0);
+        std::atomic<size_t> m_overruns = ATOMIC_VAR_INIT(0);
+        std::thread m_thread;
+};
+
 static void usage()
 {
     using namespace std;
 
     cerr << "Usage:" << endl;
-    cerr << "odr-zmq2farsync <source> <destination>" << endl << endl;
+    cerr << "odr-zmq2farsync [-p prefill] [-b buffer] <source> <destination>" << endl << endl;
 
     cerr << "Where" << endl;
     cerr << " <source> is a ZMQ URL that points to a ODR-DabMux ZMQ output." << endl;
     cerr << " <destination> is the device information for the FarSync card." << endl << endl;
     cerr << " The syntax is the same as for ODR-DabMux" << endl << endl;
+    cerr << " -p prefill  Number of frames to buffer before starting to write to the card (default " <<
+        DEFAULT_PREFILL << ")." << endl;
+    cerr << " -b buffer   Number of frames the buffer can hold (default " <<
+        DEFAULT_RING_SIZE << ")." << endl << endl;
+
+    cerr << "Frames are written to the card one every 24ms, independently of the" << endl;
+    cerr << "arrival of the ZMQ messages. The buffer absorbs the network jitter." << endl << endl;
 
     cerr << "The input socket will be reset if no data is received for " <<
         (int)(MAX_ERROR_COUNT * ZMQ_TIMEOUT_MS / 1000.0) << " seconds." << endl;
@@ -78,13 +256,37 @@ int main(int argc, char **argv)
 #endif
         " starting up";
 
-    if (argc != 3) {
+    size_t prefill = DEFAULT_PREFILL;
+    size_t ring_size = DEFAULT_RING_SIZE;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "p:b:h")) != -1) {
+        switch (ch) {
+            case 'p':
+                prefill = std::stoul(optarg);
+                break;
+            case 'b':
+                ring_size = std::stoul(optarg);
+                break;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (argc - optind != 2) {
         usage();
         return 1;
     }
 
-    const char* source_url = argv[1];
-    const char* destination_device = argv[2];
+    if (prefill == 0 or prefill + NUM_FRAMES_PER_ZMQ_MESSAGE > ring_size) {
+        etiLog.level(error) << "The buffer must be larger than prefill + " <<
+            NUM_FRAMES_PER_ZMQ_MESSAGE << " frames, and prefill cannot be 0";
+        return 1;
+    }
+
+    const char* source_url = argv[optind];
+    const char* destination_device = argv[optind + 1];
 
     etiLog.level(info) << "Opening FarSync card: " << destination_device;
     DabOutputRaw output;
@@ -94,10 +296,12 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    FrameRing ring(ring_size);
+    FrameWriter writer(output, ring, prefill);
+    writer.start();
+
     etiLog.level(info) << "Opening ZMQ input: " << source_url;
     zmq::context_t zmq_ctx(1);
-    size_t frame_count = 0;
-    size_t loop_counter = 0;
     size_t num_consecutive_resets = 0;
     while (num_consecutive_resets < MAX_NUM_RESETS) {
         zmq::socket_t zmq_sock(zmq_ctx, ZMQ_SUB);
@@ -136,30 +340,19 @@ int main(int argc, char **argv)
                         error_count++;
                     }
                     else {
-                        std::vector<uint8_t> buf(6144, 0x55);
-
                         const int framesize = dab_msg->buflen[i];
 
-                        memcpy(&buf.front(),
-                                ((uint8_t*)incoming.data()) + offset,
-                                framesize);
-
+                        const uint8_t *frame = ((uint8_t*)incoming.data()) + offset;
                         offset += framesize;
 
-                        if (output.Write(&buf.front(), buf.size()) == -1) {
-                            etiLog.level(error) << "Cannot write to output!";
-                            error_count++;
+                        if (ring.push(frame, framesize)) {
+                            writer.frame_received();
+                        }
+                        else {
+                            writer.overrun();
                         }
-
-                        frame_count++;
                     }
                 }
-
-                loop_counter++;
-                if (loop_counter > 250) {
-                    etiLog.level(info) << "Transmitted " << frame_count << " ETI frames";
-                    loop_counter = 0;
-                }
             }
         }
 